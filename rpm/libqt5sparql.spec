@@ -17,6 +17,7 @@ BuildRequires: pkgconfig(Qt5Test)
 BuildRequires: pkgconfig(Qt5Gui)
 BuildRequires: pkgconfig(Qt5Widgets)
 BuildRequires: tracker-devel
+BuildRequires: pkgconfig(zlib)
 
 %description
 Library for accessing RDF stores.
@@ -9,6 +9,7 @@ Source0: %{name}-%{version}.tar.gz
 BuildRequires: doxygen
 BuildRequires: pkgconfig(QtCore)
 BuildRequires: tracker-devel
+BuildRequires: pkgconfig(zlib)
 
 %description
 Library for accessing RDF stores.
@@ -5,13 +5,12 @@ SOURCES		= main.cpp \
 		  ../../../sparql/drivers/endpoint/qsparql_endpoint.cpp
 
 unix: {
-    LIBS *= $$QT_LFLAGS_ENDPOINT
+    LIBS *= $$QT_LFLAGS_ENDPOINT -lz
     QMAKE_CXXFLAGS *= $$QT_CFLAGS_ENDPOINT
 }
 
 include(../qsparqldriverbase.pri)
 
-QT += xml
 QT += network
 
 coverage {
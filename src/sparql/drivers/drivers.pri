@@ -49,4 +49,6 @@ contains(sparql-drivers, endpoint) {
     HEADERS +=      drivers/endpoint/qsparql_endpoint_p.h
     SOURCES +=      drivers/endpoint/qsparql_endpoint.cpp
     DEFINES += QT_SPARQL_ENDPOINT
+
+    unix:LIBS *= -lz
 }
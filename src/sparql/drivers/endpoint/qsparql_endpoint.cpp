@@ -48,11 +48,23 @@
 #include <qsparqlqueryoptions.h>
 #include <qsparqlresultrow.h>
 #include <private/qsparqlntriples_p.h>
+#include <private/qsparqlxmlresultsreader_p.h>
 
 #include <qstringlist.h>
 #include <qtextcodec.h>
+#include <qalgorithms.h>
 #include <qvector.h>
+#include <QtCore/qelapsedtimer.h>
 #include <QtCore/qeventloop.h>
+#include <QtCore/qiodevice.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qtimer.h>
+#include <QtCore/qwaitcondition.h>
 #include <QtCore/qstringlist.h>
 #include <QtCore/qurl.h>
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
@@ -60,30 +72,100 @@
 #endif
 
 #include <QtNetwork/qnetworkaccessmanager.h>
+#include <QtNetwork/qnetworkdiskcache.h>
 #include <QtNetwork/qnetworkrequest.h>
 #include <QtNetwork/qnetworkreply.h>
 #include <QtNetwork/qnetworkproxy.h>
 #include <QtNetwork/qauthenticator.h>
+#include <QtNetwork/qabstractsocket.h>
+#ifndef QT_NO_LOCALSOCKET
+#include <QtNetwork/qlocalsocket.h>
+#endif
 
-#include <QtXml/QDomNode>
-#include <QtXml/QDomDocument>
-#include <QtXml/QDomElement>
-#include <QtXml/QXmlDefaultHandler>
-#include <QtXml/QXmlInputSource>
+#include <limits.h>
+#include <string.h>
+#include <zlib.h>
 
 #include <qdebug.h>
 
 QT_BEGIN_NAMESPACE
 
-class XmlResultsParser;
+class JsonResultsParser;
+class EndpointInflater;
+class EndpointResultPrivate;
+class EndpointNetworkThread;
+
+// A query or an upload waiting in the scheduler for a free slot of its host
+class EndpointRequest
+{
+public:
+    virtual ~EndpointRequest() {}
+    // Sends the request, which then holds the slot until requestDone()
+    virtual void start() = 0;
+    // A request which has finished while waiting isn't sent
+    virtual bool isDone() const = 0;
+};
+
+// Sends the requests of the driver so that at most maxInFlight of them are
+// in flight to each host. The rest wait in the queue of their priority.
+class EndpointScheduler
+{
+public:
+    EndpointScheduler() : maxInFlight(6) {}
+
+    static QString hostKey(const QUrl &url);
+    void enqueue(EndpointRequest *request, QObject *object, const QString &host, int priority);
+    bool tryAcquire(const QString &host);
+    void requestDone(const QString &host);
+    void clear();
+    QVariantMap statistics() const;
+
+    int maxInFlight;
+
+private:
+    struct Request {
+        EndpointRequest *request;
+        QPointer<QObject> object;   // 0 when the request has been deleted
+        QElapsedTimer queueTimer;
+    };
+
+    struct Host {
+        Host() : inFlight(0), started(0), totalQueueTime(0), maxQueueTime(0) {}
+        int inFlight;
+        QMap<int, QQueue<Request> > queues; // the highest priority first
+        qint64 started;
+        qint64 totalQueueTime;
+        qint64 maxQueueTime;
+    };
+
+    void startRequests(Host &host);
+    static QVariantMap hostStatistics(const Host &host);
+
+    QHash<QString, Host> hosts;
+};
 
 struct EndpointDriverPrivate {
     EndpointDriverPrivate()
-        : manager(0), managerOwned(false)
+        : postThreshold(2048), updateOverPost(true), compression(true),
+          manager(0), managerOwned(false), cacheHits(0), cacheMisses(0),
+          syncBufferRows(1000), useNetworkThread(false), networkThread(0),
+          hedging(false), hedgePercentile(95), hedgeDelay(50), nextLatency(0),
+          hedgedRequests(0), hedgeWins(0)
     {
     }
+
+    void createDiskCache();
+    QVariantMap statistics() const;
+    int pickReplica(int exclude = -1) const;
+    void releaseReplica(int replica);
+    int currentHedgeDelay() const;
+    void addLatency(qint64 ms);
+
     QSparqlConnectionOptions options;
     QUrl url;
+    int postThreshold;      // queries longer than this are POSTed, -1: never
+    bool updateOverPost;    // send updates with a SPARQL 1.1 Update POST
+    bool compression;       // ask for gzip or deflate encoded replies
     QString user;
     QString password;
 #ifndef QT_NO_NETWORKPROXY
@@ -91,64 +173,149 @@ struct EndpointDriverPrivate {
 #endif
     QNetworkAccessManager *manager;
     bool managerOwned;
+    EndpointScheduler scheduler;
+    qint64 cacheHits;       // replies served from the cache, also after a 304
+    qint64 cacheMisses;     // cacheable replies which came from the network
+    int syncBufferRows;     // rows a forward only result reads ahead
+    bool useNetworkThread;  // run the asynchronous queries in networkThread
+    EndpointNetworkThread *networkThread;   // runs the synchronous queries
+    QList<QUrl> replicas;   // the endpoints; the first one gets the updates
+    QVector<int> outstanding;   // requests sent to each replica, not finished
+    bool hedging;           // send slow reads again to a second replica
+    int hedgePercentile;
+    int hedgeDelay;         // ms, until there are enough latency samples
+    QVector<qint64> latencies;  // the recent times to the first byte
+    int nextLatency;
+    qint64 hedgedRequests;
+    qint64 hedgeWins;       // hedged requests answered first by the hedge
 };
 
-// This class is only needed for debugging reasons
-class XmlInputSource : public QXmlInputSource
+// Decompresses a gzip or deflate encoded reply chunk by chunk, so that the
+// results can be parsed while the rest of the reply is still coming.
+class EndpointInflater
 {
 public:
-    XmlInputSource(QIODevice * dev) : QXmlInputSource(dev) {}
+    EndpointInflater(bool deflate);
+    ~EndpointInflater();
 
-    void fetchData()
-    {
-        QXmlInputSource::fetchData();
-        // qDebug() << "data" << data();
-    }
+    bool decompress(const QByteArray &in, QByteArray &out);
+    bool isFinished() const { return finished; }
+
+private:
+    z_stream stream;
+    bool deflate;
+    bool initialized;
+    bool finished;
+    QByteArray header;
 };
 
-class XmlResultsParser : public QXmlDefaultHandler
+// Incremental parser for the SPARQL 1.1 Query Results JSON Format. The
+// reply is fed to parse() in the chunks it arrives in; tokens split across
+// chunks are kept in the parser state, and the rows are added to the
+// result as soon as their closing brace has been seen.
+class JsonResultsParser
 {
 public:
-    XmlResultsParser(EndpointResultPrivate * res) : d(res)
-    {
-    }
+    JsonResultsParser(EndpointResultPrivate * res);
+
+    bool parse(const char *data, int len);
+    bool isComplete() const;
+    QString errorString() const;
+
+private:
+    enum Container { Object, Array };
+    enum State {
+        ExpectValue,
+        ExpectValueOrEnd,
+        ExpectKey,
+        ExpectKeyOrEnd,
+        ExpectColon,
+        ExpectCommaOrEnd,
+        InString,
+        InEscape,
+        InUnicodeEscape,
+        InLiteral,
+        Complete
+    };
+
+    bool setError(const char *message);
+    void valueDone();
+    void startContainer(Container container);
+    bool endContainer(Container container);
+    bool endString();
+    bool endLiteral();
+    void scalar(const QString &value);
+    QString valueKey() const;
+
+    State state;
+    bool stringIsKey;
+    QVector<Container> containers;
+    QStringList path;       // key of each open container
+    QString currentKey;
+    QByteArray text;        // UTF-8 of the string or literal being read
+    uint unicode;
+    int unicodeDigits;
+    uint highSurrogate;
+    QString errorStr;
 
-    bool startElement(  const QString & namespaceURI,
-                        const QString & localName,
-                        const QString &qName,
-                        const QXmlAttributes &attributes);
+    // Current RDF term
+    QString termType;
+    QString termValue;
+    QString termDatatype;
+    QString termLang;
+
+    QSparqlResultRow resultRow;
+    // The bindings of the previous row; the rows with the same ones share it
+    QSparqlResultRowSchema schema;
+    EndpointResultPrivate * d;
+};
 
-    bool endElement(    const QString & namespaceURI,
-                        const QString & localName,
-                        const QString &qName);
+// Parser for the SPARQL 1.1 Query Results TSV Format. The reply is fed to
+// parse() in the chunks it arrives in, and the rows are added to the result
+// line by line. The RDF terms are in their Turtle form, with the short forms
+// of numbers and booleans; an empty field is an unbound variable.
+class TsvResultsParser
+{
+public:
+    TsvResultsParser(EndpointResultPrivate * res);
 
-    bool characters(const QString &str);
-    bool fatalError(const QXmlParseException &exception);
+    bool parse(const QByteArray &data);
+    bool finish();
     QString errorString() const;
 
 private:
-    QString currentText;
+    bool setError(const char *message);
+    bool parseLine(const char *p, const char *end);
+    bool parseTerm(const char *p, const char *end, QSparqlBinding &binding);
+    bool parseLiteral(const char *p, const char *end, QSparqlBinding &binding);
+
+    QByteArray partialLine;
+    QStringList variables;
+    QSparqlResultRowSchema schema;
+    bool headerRead;
     QString errorStr;
-    QXmlAttributes lattrs;
-    QSparqlBinding binding;
-    QSparqlResultRow resultRow;
     EndpointResultPrivate * d;
 };
 
-class EndpointResultPrivate  : public QObject {
+class EndpointResultPrivate  : public QObject, public EndpointRequest {
     Q_OBJECT
 public:
     EndpointResultPrivate(EndpointResult *result, EndpointDriverPrivate *dpp)
-    : reply(0), xml(0), parser(0), reader(0),
+    : reply(0), post(false), holdsSlot(false), replica(-1), hedgeReply(0), hedgeReplica(-1),
+        holdsHedgeSlot(false),
+        hedged(false), firstByte(false), readBufferSize(0), paused(false), finishPending(false),
+        inflater(0), encodingChecked(false), ntriples(0), xmlReader(0), jsonParser(0), tsvParser(0),
         isFinished(false), noResults(false), loop(0), q(result), driverPrivate(dpp)
     {
     }
 
     ~EndpointResultPrivate()
     {
-        delete xml;
-        delete parser;
-        delete reader;
+        delete inflater;
+        delete ntriples;
+        delete xmlReader;
+        delete jsonParser;
+        delete tsvParser;
     }
 
     void setBoolValue(bool v)
@@ -157,10 +324,32 @@ public:
     }
 
     QNetworkReply *reply;
-    QByteArray buffer;
-    XmlInputSource *xml;
-    XmlResultsParser *parser;
-    QXmlSimpleReader *reader;
+    // The request waiting for its turn in the scheduler
+    QNetworkRequest request;
+    QByteArray body;
+    bool post;
+    QString host;
+    bool holdsSlot;
+    int replica;
+    // The same request sent to another replica when the first one is slow
+    QNetworkReply *hedgeReply;
+    int hedgeReplica;
+    // The hedge takes a scheduler slot of the host of its replica
+    bool holdsHedgeSlot;
+    QString hedgeHost;
+    bool hedged;
+    bool firstByte;
+    QElapsedTimer requestTimer;
+    QElapsedTimer hedgeTimer;
+    qint64 readBufferSize;
+    bool paused;
+    bool finishPending;
+    EndpointInflater *inflater;
+    bool encodingChecked;
+    QSparqlNTriples *ntriples;
+    QSparqlXmlResultsReader *xmlReader;
+    JsonResultsParser *jsonParser;
+    TsvResultsParser *tsvParser;
     QVector<QSparqlResultRow> results;
     bool isFinished;
     bool noResults;
@@ -168,364 +357,2009 @@ public:
     EndpointResult *q;
     EndpointDriverPrivate *driverPrivate;
 
+    void start();
+    bool isDone() const { return isFinished; }
+    void releaseSlot();
+    void releaseReplicas();
+    void dropHedge();
+    bool isJsonReply() const;
+    bool isTsvReply() const;
+    bool isXmlResultsReply() const;
+    bool readBody(QByteArray &data);
+    void readJsonData(const QByteArray &data);
+    void readTsvData(const QByteArray &data);
+
 public Q_SLOTS:
     void authenticate(QNetworkReply * reply, QAuthenticator * authenticator);
     void readData();
     void handleError(QNetworkReply::NetworkError code);
     void terminate();
     void parseResults();
+    void hedge();
+    void hedgeReplyReady();
 };
 
 
-bool XmlResultsParser::startElement(const QString & namespaceURI,
-                            const QString & localName,
-                            const QString &qName,
-                            const QXmlAttributes &attributes)
-{
-    Q_UNUSED(namespaceURI);
-    Q_UNUSED(localName);
-
-    currentText = QString();
-
-    if (qName == QLatin1String("sparql")) {
-    } else if (qName == QLatin1String("head")) {
-    } else if (qName == QLatin1String("variable")) {
-    } else if (qName == QLatin1String("results")) {
-    } else if (qName == QLatin1String("result")) {
-        resultRow = QSparqlResultRow();
-    } else if (qName == QLatin1String("binding")) {
-        binding = QSparqlBinding();
-        binding.setName(attributes.value(QString::fromLatin1("name")));
-    } else if (qName == QLatin1String("bnode")) {
-    } else if (qName == QLatin1String("uri")) {
-    } else if (qName == QLatin1String("literal")) {
-        lattrs = attributes;
-    } else {
-    }
-
-    return true;
+// The slots are shared by the requests to the same host and port, with the
+// default port of the scheme when the url has none
+QString EndpointScheduler::hostKey(const QUrl &url)
+{
+    const int defaultPort = url.scheme().toLower() == QLatin1String("https") ? 443 : 80;
+    return url.host() + QLatin1Char(':') + QString::number(url.port(defaultPort));
 }
 
-bool XmlResultsParser::endElement(const QString & namespaceURI,
-                            const QString & localName,
-                            const QString &qName)
+void EndpointScheduler::enqueue(EndpointRequest *endpointRequest, QObject *object,
+                                const QString &hostName, int priority)
 {
-    Q_UNUSED(namespaceURI);
-    Q_UNUSED(localName);
-
-    if (!d->noResults) {
-        if (qName == QLatin1String("sparql")) {
-        } else if (qName == QLatin1String("head")) {
-        } else if (qName == QLatin1String("variable")) {
-        } else if (qName == QLatin1String("results")) {
-        } else if (qName == QLatin1String("result")) {
-            d->results.append(resultRow);
-        } else if (qName == QLatin1String("binding")) {
-            resultRow.append(binding);
-        } else if (qName == QLatin1String("boolean")) {
-            bool boolValue = currentText.toLower() == QLatin1String("true");
-            d->setBoolValue(boolValue);
-            binding.setValue(QVariant(boolValue));
-            resultRow.append(binding);
-            d->results.append(resultRow);
-        } else if (qName == QLatin1String("bnode")) {
-            currentText.replace(QRegExp(QString::fromLatin1("^nodeID://")), QString::fromLatin1(""));
-            currentText.replace(QRegExp(QString::fromLatin1("^_:")), QString::fromLatin1(""));
-            binding.setBlankNodeLabel(currentText);
-        } else if (qName == QLatin1String("uri")) {
-            QUrl url(currentText);
-            binding.setValue(QVariant(url));
-        } else if (qName == QLatin1String("literal")) {
-            if (lattrs.index(QString::fromLatin1("datatype")) != -1) {
-                if (lattrs.index(QString::fromLatin1("xsi:type")) != -1) {
-                    // TODO: How should we treat xsi:types here?
-                    binding.setValue(currentText, QUrl(lattrs.value(QString::fromLatin1("datatype"))));
-                } else {
-                    binding.setValue(currentText, QUrl(lattrs.value(QString::fromLatin1("datatype"))));
-                }
-            } else if (lattrs.index(QString::fromLatin1("xml:lang")) != -1) {
-                binding.setValue(QVariant(currentText));
-                binding.setLanguageTag(lattrs.value(QString::fromLatin1("xml:lang")));
-            } else {
-                binding.setValue(QVariant(currentText));
-            }
-        } else {
-        }
-    }
+    Request request;
+    request.request = endpointRequest;
+    request.object = object;
+    request.queueTimer.start();
+    Host &host = hosts[hostName];
+    host.queues[priority].enqueue(request);
+    startRequests(host);
+}
 
+// A slot for a request which is only worth sending now, like a hedge;
+// false if the host has no free slot or has requests waiting for one
+bool EndpointScheduler::tryAcquire(const QString &hostName)
+{
+    Host &host = hosts[hostName];
+    if (host.inFlight >= maxInFlight || !host.queues.isEmpty())
+        return false;
+    ++host.inFlight;
     return true;
 }
 
-bool XmlResultsParser::characters(const QString &str)
+void EndpointScheduler::requestDone(const QString &hostName)
 {
-    currentText += str;
-    return true;
+    QHash<QString, Host>::iterator it = hosts.find(hostName);
+    if (it == hosts.end())
+        return;
+    --it->inFlight;
+    startRequests(*it);
 }
 
-bool XmlResultsParser::fatalError(const QXmlParseException &exception)
+void EndpointScheduler::startRequests(Host &host)
 {
-    Q_UNUSED(exception);
-    return false;
+    while (host.inFlight < maxInFlight && !host.queues.isEmpty()) {
+        QMap<int, QQueue<Request> >::iterator queue = host.queues.begin();
+        Request request = queue->dequeue();
+        if (queue->isEmpty())
+            host.queues.erase(queue);
+
+        // The result may have been deleted or finished while it was waiting
+        if (!request.object || request.request->isDone())
+            continue;
+
+        const qint64 queueTime = request.queueTimer.elapsed();
+        ++host.started;
+        host.totalQueueTime += queueTime;
+        host.maxQueueTime = qMax(host.maxQueueTime, queueTime);
+        ++host.inFlight;
+        request.request->start();
+    }
 }
 
-QString XmlResultsParser::errorString() const
+void EndpointScheduler::clear()
 {
-    return errorStr;
+    QHash<QString, Host>::iterator it;
+    for (it = hosts.begin(); it != hosts.end(); ++it)
+        it->queues.clear();
 }
 
-void EndpointResultPrivate::authenticate(QNetworkReply * reply, QAuthenticator * authenticator)
+QVariantMap EndpointScheduler::hostStatistics(const Host &host)
 {
-    Q_UNUSED(reply);
-    authenticator->setUser(driverPrivate->user);
-    authenticator->setPassword(driverPrivate->password);
+    int queued = 0;
+    QMap<int, QQueue<Request> >::const_iterator queue;
+    for (queue = host.queues.constBegin(); queue != host.queues.constEnd(); ++queue)
+        queued += queue->count();
+
+    QVariantMap stats;
+    stats.insert(QString::fromLatin1("queuedRequests"), queued);
+    stats.insert(QString::fromLatin1("inFlightRequests"), host.inFlight);
+    stats.insert(QString::fromLatin1("startedRequests"), host.started);
+    stats.insert(QString::fromLatin1("totalQueueTime"), host.totalQueueTime);
+    stats.insert(QString::fromLatin1("maxQueueTime"), host.maxQueueTime);
+    return stats;
 }
 
-void EndpointResultPrivate::handleError(QNetworkReply::NetworkError code)
+QVariantMap EndpointScheduler::statistics() const
 {
-    if (code != QNetworkReply::UnknownContentError) {
-        q->setLastError(QSparqlError(reply->errorString(), QSparqlError::ConnectionError, code));
-        terminate();
-        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+    Host total;
+    QVariantMap perHost;
+    QHash<QString, Host>::const_iterator it;
+    for (it = hosts.constBegin(); it != hosts.constEnd(); ++it) {
+        QMap<int, QQueue<Request> >::const_iterator queue;
+        for (queue = it->queues.constBegin(); queue != it->queues.constEnd(); ++queue)
+            total.queues[queue.key()] += *queue;
+        total.inFlight += it->inFlight;
+        total.started += it->started;
+        total.totalQueueTime += it->totalQueueTime;
+        total.maxQueueTime = qMax(total.maxQueueTime, it->maxQueueTime);
+        perHost.insert(it.key(), hostStatistics(*it));
     }
-    terminate();
+
+    QVariantMap stats = hostStatistics(total);
+    stats.insert(QString::fromLatin1("hosts"), perHost);
+    return stats;
 }
 
-void EndpointResultPrivate::terminate()
+EndpointInflater::EndpointInflater(bool d)
+    : deflate(d), initialized(false), finished(false)
 {
-    if (isFinished)
-        return;
+    memset(&stream, 0, sizeof(stream));
+}
 
-    isFinished = true;
-    q->Q_EMIT finished();
-    
-    if (loop != 0)
-        loop->exit();
+EndpointInflater::~EndpointInflater()
+{
+    if (initialized)
+        inflateEnd(&stream);
 }
 
-void EndpointResultPrivate::readData()
+bool EndpointInflater::decompress(const QByteArray &in, QByteArray &out)
 {
-    if (isFinished) {
-        reply->readAll();
-        return;
-    }
+    out.clear();
+    if (finished)
+        return true;
 
-    if (q->isGraph()) {
-        buffer += reply->readAll();
-        return;
+    QByteArray data = in;
+    if (!initialized) {
+        int windowBits = MAX_WBITS + 16; // gzip
+        if (deflate) {
+            // "deflate" is meant to be zlib wrapped, but some servers send
+            // raw deflate data. The zlib header is recognized by its first
+            // two bytes being a multiple of 31.
+            header += in;
+            if (header.size() < 2)
+                return true;
+            data = header;
+            header.clear();
+            const uint cmf = uchar(data[0]);
+            const uint flg = uchar(data[1]);
+            const bool zlibWrapped = (cmf & 0x0f) == Z_DEFLATED && ((cmf << 8) | flg) % 31 == 0;
+            windowBits = zlibWrapped ? MAX_WBITS : -MAX_WBITS;
+        }
+        if (inflateInit2(&stream, windowBits) != Z_OK)
+            return false;
+        initialized = true;
     }
 
-    if (reader == 0) {
-        parser = new XmlResultsParser(this);
-        reader = new QXmlSimpleReader();
-        reader->setContentHandler(parser);
-        reader->setErrorHandler(parser);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = data.size();
+    const int chunk = qMax(data.size() * 4, 16384);
 
-        if (!reader->parse(xml, true)) {
-            q->setLastError(QSparqlError(xml->data(), QSparqlError::StatementError));
-            terminate();
-            qWarning() << "QEndpoint:" << q->lastError() << q->query();
-            return;
-        }
-    }
+    while (true) {
+        const int oldSize = out.size();
+        out.resize(oldSize + chunk);
+        stream.next_out = reinterpret_cast<Bytef *>(out.data() + oldSize);
+        stream.avail_out = chunk;
 
-    while (reply->bytesAvailable() > 0) {
-        if (!reader->parseContinue()) {
-            q->setLastError(QSparqlError(xml->data(), QSparqlError::StatementError));
-            terminate();
-            qWarning() << "QEndpoint:" << q->lastError() << q->query();
-            return;
+        const int ret = ::inflate(&stream, Z_NO_FLUSH);
+        out.resize(oldSize + chunk - stream.avail_out);
+
+        if (ret == Z_STREAM_END) {
+            // Anything after the end of the stream is ignored
+            finished = true;
+            return true;
         }
+        if (ret == Z_BUF_ERROR)
+            return true; // needs more input
+        if (ret != Z_OK)
+            return false;
+        if (stream.avail_in == 0 && stream.avail_out != 0)
+            return true;
     }
-
-    q->Q_EMIT dataReady(results.count());
 }
 
-void EndpointResultPrivate::parseResults()
-{ 
-    if (isFinished)
-        return;
-
-    if (q->isGraph()) {
-        QSparqlNTriples parser(buffer);
-        results = parser.parse();
-    }
+JsonResultsParser::JsonResultsParser(EndpointResultPrivate * res)
+    : state(ExpectValue), stringIsKey(false), unicode(0), unicodeDigits(0),
+      highSurrogate(0), d(res)
+{
+}
 
-    terminate();    
-    return;
+bool JsonResultsParser::isComplete() const
+{
+    return state == Complete;
 }
 
-EndpointResult::EndpointResult(EndpointDriverPrivate* p)
+QString JsonResultsParser::errorString() const
 {
-    d = new EndpointResultPrivate(this, p);
+    return errorStr;
 }
 
-EndpointResult::~EndpointResult()
+bool JsonResultsParser::setError(const char *message)
 {
-    cleanup();
-    delete d;
+    errorStr = QString::fromLatin1(message);
+    return false;
 }
 
-QVariant EndpointResult::handle() const
+QString JsonResultsParser::valueKey() const
 {
-    return QVariant();
+    if (!containers.isEmpty() && containers.last() == Array)
+        return QString::fromLatin1("[]");
+    return currentKey;
 }
 
-void EndpointResult::cleanup()
+void JsonResultsParser::valueDone()
 {
-    // if we still have a network manager,
-    // delete the previous result here
-    if (d->driverPrivate)
-        delete d->reply;
-    d->reply = 0;
+    state = containers.isEmpty() ? Complete : ExpectCommaOrEnd;
 }
 
-QSparqlBinding EndpointResult::binding(int field) const
+void JsonResultsParser::startContainer(Container container)
 {
-    if (!isValid()) {
-        return QSparqlBinding();
+    const QString key = valueKey();
+    containers.append(container);
+    path.append(key);
+    state = container == Object ? ExpectKeyOrEnd : ExpectValueOrEnd;
+
+    // path is ("", "results", "bindings", "[]") for a result row, and has
+    // the variable name appended for the RDF terms in it
+    if (container != Object || path.count() < 4 || path[1] != QLatin1String("results")
+        || path[2] != QLatin1String("bindings") || path[3] != QLatin1String("[]"))
+        return;
+
+    if (path.count() == 4) {
+        resultRow = QSparqlResultRow(schema);
+    } else if (path.count() == 5) {
+        termType.clear();
+        termValue.clear();
+        termDatatype.clear();
+        termLang.clear();
     }
+}
 
-    if (field >= d->results[pos()].count() || field < 0) {
-        qWarning() << "EndpointResult::data[" << pos() << "]: column" << field << "out of range";
-        return QSparqlBinding();
+bool JsonResultsParser::endContainer(Container container)
+{
+    if (containers.isEmpty() || containers.last() != container)
+        return setError("Mismatched bracket in JSON results");
+
+    const bool inBindings = path.count() >= 4 && path[1] == QLatin1String("results")
+        && path[2] == QLatin1String("bindings") && path[3] == QLatin1String("[]");
+
+    if (container == Object && inBindings && path.count() == 5) {
+        QSparqlBinding binding;
+        binding.setName(path[4]);
+        if (termType == QLatin1String("uri")) {
+            binding.setValue(QVariant(QUrl(termValue)));
+        } else if (termType == QLatin1String("bnode")) {
+            QString label = termValue;
+            if (label.startsWith(QLatin1String("nodeID://")))
+                label.remove(0, 9);
+            else if (label.startsWith(QLatin1String("_:")))
+                label.remove(0, 2);
+            binding.setBlankNodeLabel(label);
+        } else if (!termDatatype.isEmpty()) {
+            // "literal", or "typed-literal" from SPARQL 1.0 era endpoints
+            binding.setValue(termValue, QUrl(termDatatype));
+        } else {
+            binding.setValue(QVariant(termValue));
+            if (!termLang.isEmpty())
+                binding.setLanguageTag(termLang);
+        }
+        resultRow.append(binding);
+    } else if (container == Object && inBindings && path.count() == 4) {
+        if (resultRow.count() >= schema.count())
+            schema = resultRow.schema();
+        if (!d->noResults)
+            d->results.append(resultRow);
     }
 
-    return d->results[pos()].binding(field);
+    containers.pop_back();
+    path.removeLast();
+    valueDone();
+    return true;
 }
 
-QVariant EndpointResult::value(int field) const
+void JsonResultsParser::scalar(const QString &value)
 {
-    if (!isValid()) {
-        return QVariant();
+    if (path.count() == 5) {
+        if (currentKey == QLatin1String("type"))
+            termType = value;
+        else if (currentKey == QLatin1String("value"))
+            termValue = value;
+        else if (currentKey == QLatin1String("datatype"))
+            termDatatype = value;
+        else if (currentKey == QLatin1String("xml:lang"))
+            termLang = value;
+    } else if (path.count() == 1 && currentKey == QLatin1String("boolean")) {
+        if (!d->noResults) {
+            bool boolValue = value == QLatin1String("true");
+            d->setBoolValue(boolValue);
+            QSparqlBinding binding;
+            binding.setValue(QVariant(boolValue));
+            QSparqlResultRow row;
+            row.append(binding);
+            d->results.append(row);
+        }
     }
+}
 
-    if (field >= d->results[pos()].count() || field < 0) {
-        qWarning() << "EndpointResult::data[" << pos() << "]: column" << field << "out of range";
-        return QVariant();
+bool JsonResultsParser::endString()
+{
+    const QString str = QString::fromUtf8(text.constData(), text.size());
+    text.resize(0);
+    if (stringIsKey) {
+        currentKey = str;
+        state = ExpectColon;
+    } else {
+        scalar(str);
+        valueDone();
     }
-
-    return d->results[pos()].value(field);
+    return true;
 }
 
-// This is just a temporary hack; eventually this should be refactored so that
-// the work is done here instead of Result::exec.
-EndpointResult* EndpointDriver::exec(const QString& query, QSparqlQuery::StatementType type, const QSparqlQueryOptions& options)
+bool JsonResultsParser::endLiteral()
 {
-    if (options.executionMethod() == QSparqlQueryOptions::SyncExec)
-        return 0;
-
-    EndpointResult* res = createResult();
-    res->exec(query, type, prefixes());
-    return res;
+    // true, false, null or a number; only the first two are of interest
+    if (containers.isEmpty())
+        return setError("Invalid JSON results");
+    scalar(QString::fromLatin1(text.constData(), text.size()));
+    text.resize(0);
+    valueDone();
+    return true;
 }
 
-bool EndpointResult::exec(const QString& query, QSparqlQuery::StatementType type, const QString& prefixes)
+static void appendUtf8(QByteArray &text, uint codePoint)
 {
-    QUrl queryUrl(d->driverPrivate->url);
-#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
-    QUrlQuery urlQuery(queryUrl);
-    urlQuery.addQueryItem(QLatin1String("query"), prefixes + query);
-#else
-    queryUrl.addQueryItem(QLatin1String("query"), prefixes + query);
-#endif
-    setQuery(query);
-    setStatementType(type);
-
-    // Virtuoso protocol extension options - timeout and maxrows
-    QVariant timeout = d->driverPrivate->options.option(QLatin1String("timeout"));
-    if (timeout.isValid()) {
-#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
-        urlQuery.addQueryItem(QLatin1String("timeout"), timeout.toString());
-#else
-        queryUrl.addQueryItem(QLatin1String("timeout"), timeout.toString());
-#endif
-    }
-
-    QVariant maxrows = d->driverPrivate->options.option(QLatin1String("maxrows"));
-    if (maxrows.isValid()) {
-#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
-        urlQuery.addQueryItem(QLatin1String("maxrows"), maxrows.toString());
-#else
-        queryUrl.addQueryItem(QLatin1String("maxrows"), maxrows.toString());
-#endif
+    if (codePoint < 0x80) {
+        text.append(char(codePoint));
+    } else if (codePoint < 0x800) {
+        text.append(char(0xc0 | (codePoint >> 6)));
+        text.append(char(0x80 | (codePoint & 0x3f)));
+    } else if (codePoint < 0x10000) {
+        text.append(char(0xe0 | (codePoint >> 12)));
+        text.append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        text.append(char(0x80 | (codePoint & 0x3f)));
+    } else {
+        text.append(char(0xf0 | (codePoint >> 18)));
+        text.append(char(0x80 | ((codePoint >> 12) & 0x3f)));
+        text.append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        text.append(char(0x80 | (codePoint & 0x3f)));
     }
+}
 
-#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
-    queryUrl.setQuery(urlQuery);
-#endif
-
-    // qDebug() << "Real url to run.... " << queryUrl.toString();
-
-    d->buffer.clear();
-    QNetworkRequest request(queryUrl);
-
-    if (isGraph())
-        // A Virtuoso protocol extension for CONSTRUCT or DESCRIBE queries.
-        // With DBPedia, 'text/plain' returns triples, but it isn't documented
-        // in the Virtuoso manual
-        request.setRawHeader("Accept", "text/plain");
-    else
-        request.setRawHeader("Accept", "application/sparql-results+xml");
-
-    request.setRawHeader("charset", "utf-8");
-
-    d->reply = d->driverPrivate->manager->get(request);
-
-    if (!isGraph())
-        d->xml = new XmlInputSource(d->reply);
-
-    // We don't want to add any results if it's an insert or delete, however, we still need to parse them
-    // because there may be warnings that need to be printed
-    if (statementType() == QSparqlQuery::InsertStatement || statementType() == QSparqlQuery::DeleteStatement)
-        d->noResults = true;
+bool JsonResultsParser::parse(const char *data, int len)
+{
+    const char *p = data;
+    const char *end = data + len;
+
+    while (p < end) {
+        const char c = *p;
+
+        switch (state) {
+        case InString:
+            if (c == '"') {
+                ++p;
+                if (!endString())
+                    return false;
+            } else if (c == '\\') {
+                ++p;
+                state = InEscape;
+            } else {
+                // Copy the run of plain characters in one go
+                const char *start = p;
+                while (p < end && *p != '"' && *p != '\\')
+                    ++p;
+                text.append(start, p - start);
+            }
+            continue;
+        case InEscape:
+            ++p;
+            state = InString;
+            switch (c) {
+            case 'b': text.append('\b'); break;
+            case 'f': text.append('\f'); break;
+            case 'n': text.append('\n'); break;
+            case 'r': text.append('\r'); break;
+            case 't': text.append('\t'); break;
+            case 'u':
+                unicode = 0;
+                unicodeDigits = 0;
+                state = InUnicodeEscape;
+                break;
+            default: text.append(c); break;
+            }
+            continue;
+        case InUnicodeEscape: {
+            ++p;
+            int digit;
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+            else if (c >= 'a' && c <= 'f')
+                digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                digit = c - 'A' + 10;
+            else
+                return setError("Invalid unicode escape in JSON results");
+            unicode = (unicode << 4) | digit;
+            if (++unicodeDigits < 4)
+                continue;
+
+            state = InString;
+            if (unicode >= 0xd800 && unicode < 0xdc00) {
+                highSurrogate = unicode;
+            } else if (unicode >= 0xdc00 && unicode < 0xe000 && highSurrogate) {
+                appendUtf8(text, 0x10000 + ((highSurrogate - 0xd800) << 10) + (unicode - 0xdc00));
+                highSurrogate = 0;
+            } else {
+                appendUtf8(text, unicode);
+                highSurrogate = 0;
+            }
+            continue;
+        }
+        case InLiteral:
+            if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')
+                || c == '-' || c == '+' || c == '.' || c == 'E') {
+                text.append(c);
+                ++p;
+            } else if (!endLiteral()) {
+                return false;
+            }
+            // The terminating character is handled on the next round
+            continue;
+        default:
+            break;
+        }
 
-    QObject::connect(d->reply, SIGNAL(readyRead()), d, SLOT(readData()));
-    QObject::connect(d->reply, SIGNAL(finished()), d, SLOT(parseResults()));
-    QObject::connect(d->reply, SIGNAL(error(QNetworkReply::NetworkError)), d, SLOT(handleError(QNetworkReply::NetworkError)));
+        ++p;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            continue;
 
-    if (!d->driverPrivate->user.isEmpty() && !d->driverPrivate->password.isEmpty()) {
-        QObject::connect(d->driverPrivate->manager, SIGNAL(authenticationRequired(QNetworkReply *, QAuthenticator *)),
-                         d, SLOT(authenticate(QNetworkReply *, QAuthenticator *)));
+        switch (state) {
+        case ExpectValueOrEnd:
+            if (c == ']') {
+                if (!endContainer(Array))
+                    return false;
+                break;
+            }
+            // fall through
+        case ExpectValue:
+            if (c == '{') {
+                startContainer(Object);
+            } else if (c == '[') {
+                startContainer(Array);
+            } else if (c == '"') {
+                stringIsKey = false;
+                state = InString;
+            } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-') {
+                text.append(c);
+                state = InLiteral;
+            } else {
+                return setError("Unexpected character in JSON results");
+            }
+            break;
+        case ExpectKeyOrEnd:
+            if (c == '}') {
+                if (!endContainer(Object))
+                    return false;
+                break;
+            }
+            // fall through
+        case ExpectKey:
+            if (c != '"')
+                return setError("Expected a key in JSON results");
+            stringIsKey = true;
+            state = InString;
+            break;
+        case ExpectColon:
+            if (c != ':')
+                return setError("Expected ':' in JSON results");
+            state = ExpectValue;
+            break;
+        case ExpectCommaOrEnd:
+            if (c == ',') {
+                state = containers.last() == Object ? ExpectKey : ExpectValue;
+            } else if (c == '}') {
+                if (!endContainer(Object))
+                    return false;
+            } else if (c == ']') {
+                if (!endContainer(Array))
+                    return false;
+            } else {
+                return setError("Expected ',' in JSON results");
+            }
+            break;
+        case Complete:
+            return setError("Trailing data after JSON results");
+        default:
+            break;
+        }
     }
 
     return true;
 }
 
-void EndpointResult::waitForFinished()
+TsvResultsParser::TsvResultsParser(EndpointResultPrivate * res)
+    : headerRead(false), d(res)
 {
-    if (d->isFinished)
-        return;
-
-    QEventLoop loop;
-    d->loop = &loop;
-    loop.exec();
-    d->loop = 0;
 }
 
-bool EndpointResult::isFinished() const
+QString TsvResultsParser::errorString() const
 {
-    return d->isFinished;
+    return errorStr;
 }
 
-int EndpointResult::size() const
+bool TsvResultsParser::setError(const char *message)
 {
-    return d->results.count();
+    errorStr = QString::fromLatin1(message);
+    return false;
 }
 
-QSparqlResultRow EndpointResult::current() const
+bool TsvResultsParser::parse(const QByteArray &data)
 {
-    if (!isValid()) {
-        return QSparqlResultRow();
+    partialLine.append(data);
+    const char *begin = partialLine.constData();
+    const char *end = begin + partialLine.size();
+    const char *line = begin;
+
+    // Only the complete lines are parsed, the rest waits for the next chunk
+    while (const char *eol = static_cast<const char *>(memchr(line, '\n', end - line))) {
+        const char *lineEnd = eol;
+        if (lineEnd > line && lineEnd[-1] == '\r')
+            --lineEnd;
+        if (!parseLine(line, lineEnd))
+            return false;
+        line = eol + 1;
     }
 
-    if (pos() < 0 || pos() >= d->results.count()) {
-        return QSparqlResultRow();
+    partialLine.remove(0, line - begin);
+    return true;
+}
+
+bool TsvResultsParser::finish()
+{
+    if (!partialLine.isEmpty()) {
+        const QByteArray lastLine = partialLine;
+        partialLine.clear();
+        const char *end = lastLine.constData() + lastLine.size();
+        if (end > lastLine.constData() && end[-1] == '\r')
+            --end;
+        if (!parseLine(lastLine.constData(), end))
+            return false;
     }
 
-    return d->results[pos()];
+    if (!headerRead)
+        return setError("Missing variables in TSV results");
+    return true;
 }
 
-EndpointDriver::EndpointDriver(QObject * parent)
+bool TsvResultsParser::parseLine(const char *p, const char *end)
+{
+    if (!headerRead) {
+        // The variables, with their leading '?' or '$'
+        headerRead = true;
+        while (p <= end) {
+            const char *tab = static_cast<const char *>(memchr(p, '\t', end - p));
+            const char *fieldEnd = tab ? tab : end;
+            if (fieldEnd > p && (*p == '?' || *p == '$'))
+                ++p;
+            variables.append(QString::fromUtf8(p, fieldEnd - p));
+            p = fieldEnd + 1;
+        }
+        return true;
+    }
+
+    // A query without variables gives an empty line per solution
+    QSparqlResultRow resultRow(schema);
+    int column = 0;
+    while (p <= end) {
+        const char *tab = static_cast<const char *>(memchr(p, '\t', end - p));
+        const char *fieldEnd = tab ? tab : end;
+        if (column >= variables.count())
+            return setError("Too many columns in TSV results");
+        if (fieldEnd > p) {
+            QSparqlBinding binding(variables[column]);
+            if (!parseTerm(p, fieldEnd, binding))
+                return false;
+            resultRow.append(binding);
+        }
+        ++column;
+        p = fieldEnd + 1;
+    }
+
+    // Unbound variables leave out columns; keep the longest schema seen
+    if (resultRow.count() >= schema.count())
+        schema = resultRow.schema();
+    if (!d->noResults)
+        d->results.append(resultRow);
+    return true;
+}
+
+bool TsvResultsParser::parseTerm(const char *p, const char *end, QSparqlBinding &binding)
+{
+    const int length = end - p;
+
+    if (*p == '<') {
+        if (end[-1] != '>' || length < 2)
+            return setError("Invalid IRI in TSV results");
+        binding.setValue(QVariant(QUrl(QString::fromUtf8(p + 1, length - 2))));
+        return true;
+    }
+
+    if (*p == '"')
+        return parseLiteral(p, end, binding);
+
+    if (length > 2 && p[0] == '_' && p[1] == ':') {
+        binding.setBlankNodeLabel(QString::fromUtf8(p + 2, length - 2));
+        return true;
+    }
+
+    // The Turtle short forms of booleans and numbers
+    const QString value = QString::fromLatin1(p, length);
+    const char *xsd;
+    if (value == QLatin1String("true") || value == QLatin1String("false")) {
+        xsd = "http://www.w3.org/2001/XMLSchema#boolean";
+    } else {
+        for (const char *c = p; c < end; ++c) {
+            if ((*c < '0' || *c > '9') && *c != '+' && *c != '-' && *c != '.'
+                && *c != 'e' && *c != 'E')
+                return setError("Invalid RDF term in TSV results");
+        }
+        if (value.contains(QLatin1Char('e')) || value.contains(QLatin1Char('E')))
+            xsd = "http://www.w3.org/2001/XMLSchema#double";
+        else if (value.contains(QLatin1Char('.')))
+            xsd = "http://www.w3.org/2001/XMLSchema#decimal";
+        else
+            xsd = "http://www.w3.org/2001/XMLSchema#integer";
+    }
+    binding.setValue(value, QUrl(QString::fromLatin1(xsd)));
+    return true;
+}
+
+bool TsvResultsParser::parseLiteral(const char *p, const char *end, QSparqlBinding &binding)
+{
+    QByteArray text;
+    ++p;
+    for (;;) {
+        if (p >= end)
+            return setError("Unterminated literal in TSV results");
+        const char c = *p++;
+        if (c == '"')
+            break;
+        if (c != '\\') {
+            text.append(c);
+            continue;
+        }
+        if (p >= end)
+            return setError("Invalid escape in TSV results");
+        const char escape = *p++;
+        switch (escape) {
+        case 't': text.append('\t'); break;
+        case 'n': text.append('\n'); break;
+        case 'r': text.append('\r'); break;
+        case 'b': text.append('\b'); break;
+        case 'f': text.append('\f'); break;
+        case '"':
+        case '\'':
+        case '\\':
+            text.append(escape);
+            break;
+        case 'u':
+        case 'U': {
+            const int digits = escape == 'u' ? 4 : 8;
+            if (end - p < digits)
+                return setError("Invalid unicode escape in TSV results");
+            bool ok = false;
+            const uint codePoint = QByteArray(p, digits).toUInt(&ok, 16);
+            if (!ok)
+                return setError("Invalid unicode escape in TSV results");
+            appendUtf8(text, codePoint);
+            p += digits;
+            break;
+        }
+        default:
+            return setError("Invalid escape in TSV results");
+        }
+    }
+
+    const QString value = QString::fromUtf8(text.constData(), text.size());
+    if (p == end) {
+        binding.setValue(QVariant(value));
+    } else if (*p == '@') {
+        binding.setValue(QVariant(value));
+        binding.setLanguageTag(QString::fromLatin1(p + 1, end - p - 1));
+    } else if (end - p > 4 && p[0] == '^' && p[1] == '^' && p[2] == '<' && end[-1] == '>') {
+        binding.setValue(value, QUrl(QString::fromUtf8(p + 3, end - p - 4)));
+    } else {
+        return setError("Invalid literal in TSV results");
+    }
+    return true;
+}
+
+void EndpointResultPrivate::authenticate(QNetworkReply * reply, QAuthenticator * authenticator)
+{
+    Q_UNUSED(reply);
+    authenticator->setUser(driverPrivate->user);
+    authenticator->setPassword(driverPrivate->password);
+}
+
+void EndpointResultPrivate::handleError(QNetworkReply::NetworkError code)
+{
+    if (code != QNetworkReply::UnknownContentError) {
+        q->setLastError(QSparqlError(reply->errorString(), QSparqlError::ConnectionError, code));
+        terminate();
+        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+    }
+    terminate();
+}
+
+void EndpointResultPrivate::terminate()
+{
+    if (isFinished)
+        return;
+
+    isFinished = true;
+    releaseSlot();
+    releaseReplicas();
+    q->Q_EMIT finished();
+    
+    if (loop != 0)
+        loop->exit();
+}
+
+void EndpointResultPrivate::readData()
+{
+    if (isFinished) {
+        reply->readAll();
+        return;
+    }
+
+    // The data waits in the reply, which stops reading from the socket
+    // when its buffer is full
+    if (paused)
+        return;
+
+    if (!firstByte) {
+        // The replica answered first, the hedge isn't needed any more
+        firstByte = true;
+        if (requestTimer.isValid() && driverPrivate)
+            driverPrivate->addLatency(requestTimer.elapsed());
+        dropHedge();
+    }
+
+    QByteArray data;
+    if (!readBody(data))
+        return;
+
+    if (q->isGraph()) {
+        // The triples are parsed line by line as they arrive
+        if (ntriples == 0)
+            ntriples = new QSparqlNTriples();
+        results += ntriples->parseChunk(data);
+        q->Q_EMIT dataReady(results.count());
+        return;
+    }
+
+    // The protocol doesn't say what the reply to an update contains, its
+    // success is told by the HTTP status; only a results document is
+    // parsed for the errors
+    if (noResults && !isXmlResultsReply())
+        return;
+
+    if (jsonParser != 0 || (xmlReader == 0 && tsvParser == 0 && isJsonReply())) {
+        readJsonData(data);
+        return;
+    }
+
+    if (tsvParser != 0 || (xmlReader == 0 && isTsvReply())) {
+        readTsvData(data);
+        return;
+    }
+
+    if (xmlReader == 0)
+        xmlReader = new QSparqlXmlResultsReader();
+
+    if (!xmlReader->parse(data)) {
+        q->setLastError(QSparqlError(xmlReader->errorString(), QSparqlError::StatementError));
+        terminate();
+        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+        return;
+    }
+
+    // We don't add any results for an insert or delete, but the reply is
+    // still parsed for the errors
+    const QVector<QSparqlResultRow> rows = xmlReader->takeRows();
+    if (!noResults) {
+        results += rows;
+        if (xmlReader->hasBoolean())
+            setBoolValue(xmlReader->boolValue());
+    }
+
+    q->Q_EMIT dataReady(results.count());
+}
+
+bool EndpointResultPrivate::readBody(QByteArray &data)
+{
+    if (!encodingChecked) {
+        encodingChecked = true;
+        const QByteArray encoding = reply->rawHeader("Content-Encoding").trimmed().toLower();
+        if (encoding == "gzip" || encoding == "x-gzip")
+            inflater = new EndpointInflater(false);
+        else if (encoding == "deflate")
+            inflater = new EndpointInflater(true);
+    }
+
+    if (inflater == 0) {
+        data = reply->readAll();
+        return true;
+    }
+
+    if (!inflater->decompress(reply->readAll(), data)) {
+        q->setLastError(QSparqlError(QString::fromLatin1("Unable to decompress the reply"),
+                                     QSparqlError::ConnectionError));
+        terminate();
+        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+        return false;
+    }
+    return true;
+}
+
+bool EndpointResultPrivate::isJsonReply() const
+{
+    // The endpoint is free to ignore the Accept header, so the format is
+    // picked by the type of the reply
+    const QByteArray contentType = reply->rawHeader("Content-Type").toLower();
+    return contentType.startsWith("application/sparql-results+json")
+        || contentType.startsWith("application/json");
+}
+
+bool EndpointResultPrivate::isTsvReply() const
+{
+    return reply->rawHeader("Content-Type").toLower().startsWith("text/tab-separated-values");
+}
+
+bool EndpointResultPrivate::isXmlResultsReply() const
+{
+    return reply->rawHeader("Content-Type").toLower().startsWith("application/sparql-results+xml");
+}
+
+void EndpointResultPrivate::readTsvData(const QByteArray &data)
+{
+    if (tsvParser == 0)
+        tsvParser = new TsvResultsParser(this);
+
+    if (!tsvParser->parse(data)) {
+        q->setLastError(QSparqlError(tsvParser->errorString(), QSparqlError::StatementError));
+        terminate();
+        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+        return;
+    }
+
+    q->Q_EMIT dataReady(results.count());
+}
+
+void EndpointResultPrivate::readJsonData(const QByteArray &data)
+{
+    if (jsonParser == 0)
+        jsonParser = new JsonResultsParser(this);
+
+    if (!jsonParser->parse(data.constData(), data.size())) {
+        q->setLastError(QSparqlError(jsonParser->errorString(), QSparqlError::StatementError));
+        terminate();
+        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+        return;
+    }
+
+    q->Q_EMIT dataReady(results.count());
+}
+
+void EndpointResultPrivate::parseResults()
+{ 
+    if (isFinished)
+        return;
+
+    if (paused) {
+        finishPending = true;
+        return;
+    }
+
+    // Only GET replies can come from the cache; a cached reply which the
+    // endpoint revalidated with 304 Not Modified is replayed as a hit
+    if (driverPrivate && !post && reply->error() == QNetworkReply::NoError
+        && driverPrivate->manager->cache() != 0) {
+        if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool())
+            ++driverPrivate->cacheHits;
+        else
+            ++driverPrivate->cacheMisses;
+    }
+
+    if (inflater && !inflater->isFinished() && !noResults) {
+        q->setLastError(QSparqlError(QString::fromLatin1("Incomplete compressed reply"),
+                                     QSparqlError::ConnectionError));
+        terminate();
+        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+        return;
+    }
+
+    if (q->isGraph()) {
+        if (ntriples) {
+            const QVector<QSparqlResultRow> lastRows = ntriples->finish();
+            if (!lastRows.isEmpty()) {
+                results += lastRows;
+                q->Q_EMIT dataReady(results.count());
+            }
+        }
+    } else if (tsvParser) {
+        // The last line doesn't need to end with a newline
+        const int count = results.count();
+        if (!tsvParser->finish() && !noResults) {
+            q->setLastError(QSparqlError(tsvParser->errorString(), QSparqlError::StatementError));
+            qWarning() << "QEndpoint:" << q->lastError() << q->query();
+        } else if (results.count() != count) {
+            q->Q_EMIT dataReady(results.count());
+        }
+    } else if (jsonParser && !jsonParser->isComplete() && !noResults) {
+        q->setLastError(QSparqlError(QString::fromLatin1("Incomplete JSON results"),
+                                     QSparqlError::StatementError));
+        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+    } else if (xmlReader && !xmlReader->isComplete() && !noResults) {
+        q->setLastError(QSparqlError(QString::fromLatin1("Incomplete XML results"),
+                                     QSparqlError::StatementError));
+        qWarning() << "QEndpoint:" << q->lastError() << q->query();
+    }
+
+    terminate();    
+    return;
+}
+
+EndpointResult::EndpointResult(EndpointDriverPrivate* p)
+{
+    d = new EndpointResultPrivate(this, p);
+}
+
+EndpointResult::~EndpointResult()
+{
+    cleanup();
+    delete d;
+}
+
+QVariant EndpointResult::handle() const
+{
+    return QVariant();
+}
+
+void EndpointResult::cleanup()
+{
+    // if we still have a network manager,
+    // delete the previous result here
+    if (d->driverPrivate)
+        delete d->reply;
+    d->reply = 0;
+    d->releaseSlot();
+    d->releaseReplicas();
+}
+
+QSparqlBinding EndpointResult::binding(int field) const
+{
+    if (!isValid()) {
+        return QSparqlBinding();
+    }
+
+    if (field >= d->results[pos()].count() || field < 0) {
+        qWarning() << "EndpointResult::data[" << pos() << "]: column" << field << "out of range";
+        return QSparqlBinding();
+    }
+
+    return d->results[pos()].binding(field);
+}
+
+QVariant EndpointResult::value(int field) const
+{
+    if (!isValid()) {
+        return QVariant();
+    }
+
+    if (field >= d->results[pos()].count() || field < 0) {
+        qWarning() << "EndpointResult::data[" << pos() << "]: column" << field << "out of range";
+        return QVariant();
+    }
+
+    return d->results[pos()].value(field);
+}
+
+// This is just a temporary hack; eventually this should be refactored so that
+// the work is done here instead of Result::exec.
+QSparqlResult* EndpointDriver::exec(const QString& query, QSparqlQuery::StatementType type, const QSparqlQueryOptions& options)
+{
+    if (options.executionMethod() == QSparqlQueryOptions::SyncExec || d->useNetworkThread)
+        return threadExec(query, type, options);
+
+    EndpointResult* res = createResult();
+    res->exec(query, type, prefixes(), options);
+    return res;
+}
+
+bool EndpointResult::exec(const QString& query, QSparqlQuery::StatementType type, const QString& prefixes,
+                          const QSparqlQueryOptions& options)
+{
+    setQuery(query);
+    setStatementType(type);
+
+    // Updates are sent as SPARQL 1.1 Update requests, and long queries in
+    // the body of a POST, so that they don't hit the URL length limits of
+    // the endpoint. The body is the UTF-8 of the query as such.
+    const QString fullQuery = prefixes + query;
+    const bool isUpdate = type == QSparqlQuery::InsertStatement || type == QSparqlQuery::DeleteStatement;
+    QByteArray body;
+    const char *contentType = 0;
+    if (isUpdate && d->driverPrivate->updateOverPost) {
+        body = fullQuery.toUtf8();
+        contentType = "application/sparql-update; charset=utf-8";
+    } else if (d->driverPrivate->postThreshold >= 0
+               && fullQuery.size() > d->driverPrivate->postThreshold / 3) {
+        // The UTF-8 can be up to three times the length of the string; only
+        // encode it when the query might be over the threshold
+        body = fullQuery.toUtf8();
+        if (body.size() > d->driverPrivate->postThreshold)
+            contentType = "application/sparql-query; charset=utf-8";
+    }
+
+    // The reads go to the replica with the fewest requests in flight
+    QUrl queryUrl(d->driverPrivate->url);
+    if (!d->driverPrivate->replicas.isEmpty()) {
+        d->replica = isUpdate ? 0 : d->driverPrivate->pickReplica();
+        queryUrl = d->driverPrivate->replicas.at(d->replica);
+        ++d->driverPrivate->outstanding[d->replica];
+        d->hedged = !isUpdate && d->driverPrivate->hedging && d->driverPrivate->replicas.count() > 1;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QUrlQuery urlQuery(queryUrl);
+    if (!contentType)
+        urlQuery.addQueryItem(QLatin1String("query"), fullQuery);
+#else
+    if (!contentType)
+        queryUrl.addQueryItem(QLatin1String("query"), fullQuery);
+#endif
+
+    // Virtuoso protocol extension options - timeout and maxrows
+    QVariant timeout = d->driverPrivate->options.option(QLatin1String("timeout"));
+    if (timeout.isValid()) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+        urlQuery.addQueryItem(QLatin1String("timeout"), timeout.toString());
+#else
+        queryUrl.addQueryItem(QLatin1String("timeout"), timeout.toString());
+#endif
+    }
+
+    QVariant maxrows = d->driverPrivate->options.option(QLatin1String("maxrows"));
+    if (maxrows.isValid()) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+        urlQuery.addQueryItem(QLatin1String("maxrows"), maxrows.toString());
+#else
+        queryUrl.addQueryItem(QLatin1String("maxrows"), maxrows.toString());
+#endif
+    }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    queryUrl.setQuery(urlQuery);
+#endif
+
+    // qDebug() << "Real url to run.... " << queryUrl.toString();
+
+    QNetworkRequest& request = d->request;
+    request.setUrl(queryUrl);
+
+    const QString resultsFormat =
+        d->driverPrivate->options.option(QLatin1String("resultsFormat")).toString();
+
+    if (isGraph())
+        // A Virtuoso protocol extension for CONSTRUCT or DESCRIBE queries.
+        // With DBPedia, 'text/plain' returns triples, but it isn't documented
+        // in the Virtuoso manual
+        request.setRawHeader("Accept", "text/plain");
+    else if (resultsFormat == QLatin1String("tsv") && statementType() == QSparqlQuery::SelectStatement)
+        // TSV has no form for ASK results. The endpoints which don't know it
+        // answer with XML, which is picked by the type of the reply.
+        request.setRawHeader("Accept", "text/tab-separated-values, "
+                                       "application/sparql-results+xml;q=0.9");
+    else if (resultsFormat == QLatin1String("json"))
+        // Prefer the JSON results, which are smaller and cheaper to parse,
+        // but let the endpoint fall back to XML
+        request.setRawHeader("Accept", "application/sparql-results+json, "
+                                       "application/sparql-results+xml;q=0.9");
+    else
+        request.setRawHeader("Accept", "application/sparql-results+xml");
+
+    request.setRawHeader("charset", "utf-8");
+
+    // Result documents compress very well. Setting the header ourselves
+    // turns off the decompression in QNetworkAccessManager, the reply is
+    // decompressed chunk by chunk in readData() instead.
+    if (d->driverPrivate->compression)
+        request.setRawHeader("Accept-Encoding", "gzip, deflate");
+
+    // Send the credentials with the request instead of waiting for the
+    // endpoint to ask for them, which would cost a round trip per request
+    if (!d->driverPrivate->user.isEmpty() && !d->driverPrivate->password.isEmpty()) {
+        const QByteArray credentials = d->driverPrivate->user.toUtf8() + ':'
+            + d->driverPrivate->password.toUtf8();
+        request.setRawHeader("Authorization", "Basic " + credentials.toBase64());
+    }
+
+    switch (options.priority()) {
+    case QSparqlQueryOptions::HighPriority:
+        request.setPriority(QNetworkRequest::HighPriority);
+        break;
+    case QSparqlQueryOptions::LowPriority:
+        request.setPriority(QNetworkRequest::LowPriority);
+        break;
+    default:
+        break;
+    }
+
+    if (contentType) {
+        request.setHeader(QNetworkRequest::ContentTypeHeader, QByteArray(contentType));
+        d->body = body;
+        d->post = true;
+    }
+
+    // We don't want to add any results if it's an insert or delete, however, we still need to parse them
+    // because there may be warnings that need to be printed
+    if (statementType() == QSparqlQuery::InsertStatement || statementType() == QSparqlQuery::DeleteStatement)
+        d->noResults = true;
+
+    // The request is sent when the scheduler has a free slot for the host
+    d->host = EndpointScheduler::hostKey(queryUrl);
+    d->driverPrivate->scheduler.enqueue(d, d, d->host, options.priority());
+
+    return true;
+}
+
+void EndpointResultPrivate::start()
+{
+    holdsSlot = true;
+    if (post)
+        reply = driverPrivate->manager->post(request, body);
+    else
+        reply = driverPrivate->manager->get(request);
+    if (readBufferSize > 0)
+        reply->setReadBufferSize(readBufferSize);
+
+    // The body is kept for the hedge until the first byte arrives
+    if (hedged)
+        QTimer::singleShot(driverPrivate->currentHedgeDelay(), this, SLOT(hedge()));
+    else
+        body.clear();
+    if (driverPrivate->hedging)
+        requestTimer.start();
+
+    QObject::connect(reply, SIGNAL(readyRead()), this, SLOT(readData()));
+    QObject::connect(reply, SIGNAL(finished()), this, SLOT(parseResults()));
+    QObject::connect(reply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(handleError(QNetworkReply::NetworkError)));
+
+    if (!driverPrivate->user.isEmpty() && !driverPrivate->password.isEmpty()) {
+        QObject::connect(driverPrivate->manager, SIGNAL(authenticationRequired(QNetworkReply *, QAuthenticator *)),
+                         this, SLOT(authenticate(QNetworkReply *, QAuthenticator *)),
+                         Qt::UniqueConnection);
+    }
+}
+
+void EndpointResultPrivate::releaseSlot()
+{
+    if (!holdsSlot)
+        return;
+    holdsSlot = false;
+    if (driverPrivate)
+        driverPrivate->scheduler.requestDone(host);
+}
+
+void EndpointResultPrivate::releaseReplicas()
+{
+    dropHedge();
+    if (driverPrivate)
+        driverPrivate->releaseReplica(replica);
+    replica = -1;
+}
+
+void EndpointResultPrivate::dropHedge()
+{
+    body.clear();
+    if (hedgeReply == 0)
+        return;
+
+    // After the driver has closed the reply may be gone with the manager
+    if (driverPrivate) {
+        hedgeReply->disconnect(this);
+        hedgeReply->abort();
+        hedgeReply->deleteLater();
+        driverPrivate->releaseReplica(hedgeReplica);
+        if (holdsHedgeSlot)
+            driverPrivate->scheduler.requestDone(hedgeHost);
+    }
+    holdsHedgeSlot = false;
+    hedgeReply = 0;
+    hedgeReplica = -1;
+}
+
+void EndpointResultPrivate::hedge()
+{
+    // Sent once, when the first replica hasn't answered within the delay
+    if (isFinished || firstByte || hedgeReply || reply == 0 || !driverPrivate)
+        return;
+    const int candidate = driverPrivate->pickReplica(replica);
+    if (candidate < 0)
+        return;
+
+    // The same request, only to another endpoint
+    const QUrl base = driverPrivate->replicas.at(candidate);
+    QUrl hedgeUrl = request.url();
+    hedgeUrl.setScheme(base.scheme());
+    hedgeUrl.setHost(base.host());
+    hedgeUrl.setPort(base.port());
+    hedgeUrl.setPath(base.path());
+    QNetworkRequest hedgeRequest(request);
+    hedgeRequest.setUrl(hedgeUrl);
+
+    // Not hedged when the other host is as busy as maxRequestsPerHost allows;
+    // a hedge waiting in the queue would be no faster than the first request
+    const QString candidateHost = EndpointScheduler::hostKey(hedgeUrl);
+    if (!driverPrivate->scheduler.tryAcquire(candidateHost))
+        return;
+    holdsHedgeSlot = true;
+    hedgeHost = candidateHost;
+    hedgeReplica = candidate;
+
+    ++driverPrivate->outstanding[hedgeReplica];
+    ++driverPrivate->hedgedRequests;
+    hedgeTimer.start();
+    if (post)
+        hedgeReply = driverPrivate->manager->post(hedgeRequest, body);
+    else
+        hedgeReply = driverPrivate->manager->get(hedgeRequest);
+    if (readBufferSize > 0)
+        hedgeReply->setReadBufferSize(readBufferSize);
+
+    QObject::connect(hedgeReply, SIGNAL(readyRead()), this, SLOT(hedgeReplyReady()));
+    QObject::connect(hedgeReply, SIGNAL(finished()), this, SLOT(hedgeReplyReady()));
+}
+
+void EndpointResultPrivate::hedgeReplyReady()
+{
+    QNetworkReply *winner = hedgeReply;
+    if (winner == 0 || firstByte || isFinished)
+        return;
+
+    // A failing hedge leaves the first request to answer
+    if (winner->error() != QNetworkReply::NoError) {
+        dropHedge();
+        return;
+    }
+
+    // The hedge answered first: it takes the place of the first request,
+    // which is cancelled
+    firstByte = true;
+    ++driverPrivate->hedgeWins;
+    driverPrivate->addLatency(hedgeTimer.elapsed());
+    body.clear();
+
+    reply->disconnect(this);
+    reply->abort();
+    reply->deleteLater();
+    driverPrivate->releaseReplica(replica);
+
+    // The slot of the hedge is the one of the request from now on
+    const bool hadSlot = holdsSlot;
+    const QString firstHost = host;
+    host = hedgeHost;
+    holdsSlot = holdsHedgeSlot;
+    holdsHedgeSlot = false;
+
+    reply = winner;
+    replica = hedgeReplica;
+    hedgeReply = 0;
+    hedgeReplica = -1;
+    if (hadSlot)
+        driverPrivate->scheduler.requestDone(firstHost);
+
+    winner->disconnect(this);
+    QObject::connect(winner, SIGNAL(readyRead()), this, SLOT(readData()));
+    QObject::connect(winner, SIGNAL(finished()), this, SLOT(parseResults()));
+    QObject::connect(winner, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(handleError(QNetworkReply::NetworkError)));
+
+    readData();
+    // The finished() signal may have been the one which brought us here
+    if (winner->isFinished())
+        parseResults();
+}
+
+QVector<QSparqlResultRow> EndpointResult::takeRows()
+{
+    QVector<QSparqlResultRow> rows = d->results;
+    d->results.clear();
+    return rows;
+}
+
+void EndpointResult::setReadBufferSize(qint64 size)
+{
+    d->readBufferSize = size;
+}
+
+void EndpointResult::pause()
+{
+    d->paused = true;
+}
+
+void EndpointResult::resume()
+{
+    if (!d->paused)
+        return;
+    d->paused = false;
+    if (d->reply == 0)
+        return;
+    d->readData();
+    if (d->finishPending) {
+        d->finishPending = false;
+        d->parseResults();
+    }
+}
+
+void EndpointResult::waitForFinished()
+{
+    if (d->isFinished)
+        return;
+
+    QEventLoop loop;
+    d->loop = &loop;
+    loop.exec();
+    d->loop = 0;
+}
+
+bool EndpointResult::isFinished() const
+{
+    return d->isFinished;
+}
+
+int EndpointResult::size() const
+{
+    return d->results.count();
+}
+
+QSparqlResultRow EndpointResult::current() const
+{
+    if (!isValid()) {
+        return QSparqlResultRow();
+    }
+
+    if (pos() < 0 || pos() >= d->results.count()) {
+        return QSparqlResultRow();
+    }
+
+    return d->results[pos()];
+}
+
+// The state a synchronous result shares with the network thread, which
+// appends the rows to it as they are parsed.
+struct EndpointRowBuffer
+{
+    EndpointRowBuffer()
+        : finished(false), hasBool(false), boolValue(false), maxRows(0),
+          paused(false), unlimited(false), cancelled(false), forwarder(0),
+          owner(0), notifyPending(false)
+    {
+    }
+
+    // Tells an asynchronous result that there are new rows. Called with the
+    // mutex locked; the rows which arrive before the result has taken the
+    // previous ones are published with them.
+    void notify()
+    {
+        if (owner && !notifyPending) {
+            notifyPending = true;
+            QMetaObject::invokeMethod(owner, "publishRows", Qt::QueuedConnection);
+        }
+    }
+
+    QMutex mutex;
+    QWaitCondition changed;
+    QList<QSparqlResultRow> rows;   // parsed, but not taken by the result
+    bool finished;
+    QSparqlError error;
+    bool hasBool;
+    bool boolValue;
+    int maxRows;            // forward only: pause the reply with this many rows
+    bool paused;
+    bool unlimited;         // waitForFinished() was called, don't pause
+    bool cancelled;         // the result was deleted
+    QObject *forwarder;     // in the network thread, 0 when it's gone
+    QObject *owner;         // an asynchronous result, in the caller's thread
+    bool notifyPending;
+};
+
+typedef QSharedPointer<EndpointRowBuffer> EndpointRowBufferPointer;
+
+struct EndpointThreadJob
+{
+    QString query;
+    QSparqlQuery::StatementType type;
+    QString prefixes;
+    QSparqlQueryOptions options;
+    EndpointRowBufferPointer buffer;
+};
+
+// Lives in the network thread, and moves the rows of an EndpointResult
+// to the buffer of the synchronous result.
+class EndpointRowForwarder : public QObject
+{
+    Q_OBJECT
+public:
+    EndpointRowForwarder(EndpointResult *result, const EndpointRowBufferPointer &buffer,
+                          QObject *parent)
+        : QObject(parent), result(result), buffer(buffer)
+    {
+    }
+    ~EndpointRowForwarder();
+
+public Q_SLOTS:
+    void forwardRows();
+    void forwardFinished();
+    void resume();
+    void cancel();
+
+private:
+    EndpointResult *result;
+    EndpointRowBufferPointer buffer;
+};
+
+// Starts the queued jobs in the network thread
+class EndpointThreadRunner : public QObject
+{
+    Q_OBJECT
+public:
+    EndpointThreadRunner(EndpointNetworkThread *thread) : thread(thread) {}
+
+    Q_INVOKABLE QVariantMap statistics() const;
+
+public Q_SLOTS:
+    void startJobs();
+    void stop();
+
+private:
+    EndpointNetworkThread *thread;
+};
+
+// The synchronous queries are sent from this thread, with a network access
+// manager of its own, so that the caller can block without spinning an
+// event loop which would re-enter the application. With the
+// "networkThread" option, the asynchronous queries are sent from here too,
+// so that reading and parsing the replies doesn't block the caller.
+class EndpointNetworkThread : public QThread
+{
+public:
+    EndpointNetworkThread(const EndpointDriverPrivate *driverPrivate);
+    ~EndpointNetworkThread();
+
+    void enqueue(const EndpointThreadJob &job);
+    QList<EndpointThreadJob> takeJobs();
+    QVariantMap statistics();
+
+    // The settings of the driver; the scheduler and the network access
+    // manager are only used in this thread
+    EndpointDriverPrivate threadPrivate;
+
+protected:
+    void run();
+
+private:
+    QMutex mutex;
+    QWaitCondition started;
+    QList<EndpointThreadJob> jobs;
+    EndpointThreadRunner *runner;
+};
+
+// A result of a query run in the network thread.
+//
+// For a synchronous query, next() waits for the network thread to parse the
+// next row. Forward only results drop the rows they have passed, and pause
+// the reply while syncBufferRows rows are waiting, so that results of any
+// size are read in constant memory.
+//
+// An asynchronous result takes the rows in blocks, when the event loop of
+// its thread gets to it, and emits one dataReady() for each block.
+class EndpointThreadResult : public QSparqlResult
+{
+    Q_OBJECT
+public:
+    EndpointThreadResult(const QString &query, QSparqlQuery::StatementType type,
+                         const EndpointRowBufferPointer &buffer, bool async, bool forwardOnly);
+    ~EndpointThreadResult();
+
+    bool next();
+    bool setPos(int pos);
+    QSparqlResultRow current() const;
+    QSparqlBinding binding(int field) const;
+    QVariant value(int field) const;
+    int size() const;
+
+    void waitForFinished();
+    void waitForData();
+    bool isFinished() const;
+    bool hasFeature(QSparqlResult::Feature feature) const;
+
+private Q_SLOTS:
+    void publishRows();
+
+private:
+    bool fetchRows(int count);
+    void takeState();
+
+    EndpointRowBufferPointer buffer;
+    bool async;
+    bool forwardOnly;
+    bool networkFinished;
+    bool finishedEmitted;
+    int publishedRows;
+    QVector<QSparqlResultRow> rows; // all the rows if not forward only
+    QSparqlResultRow currentRow;    // the current row if forward only
+};
+
+EndpointRowForwarder::~EndpointRowForwarder()
+{
+    // The network thread is stopping before the reply finished
+    QMutexLocker locker(&buffer->mutex);
+    buffer->forwarder = 0;
+    if (!buffer->finished) {
+        buffer->finished = true;
+        buffer->error = QSparqlError(
+                QString::fromUtf8("QSparqlConnection closed before QSparqlResult"),
+                QSparqlError::ConnectionError);
+        buffer->changed.wakeAll();
+        buffer->notify();
+    }
+}
+
+void EndpointRowForwarder::forwardRows()
+{
+    const QVector<QSparqlResultRow> newRows = result->takeRows();
+    QMutexLocker locker(&buffer->mutex);
+    for (int i = 0; i < newRows.count(); ++i)
+        buffer->rows.append(newRows[i]);
+    if (!newRows.isEmpty()) {
+        buffer->changed.wakeAll();
+        buffer->notify();
+    }
+
+    if (buffer->maxRows > 0 && !buffer->unlimited && !buffer->paused
+        && buffer->rows.count() >= buffer->maxRows) {
+        buffer->paused = true;
+        result->pause();
+    }
+}
+
+void EndpointRowForwarder::forwardFinished()
+{
+    const QVector<QSparqlResultRow> newRows = result->takeRows();
+    {
+        QMutexLocker locker(&buffer->mutex);
+        for (int i = 0; i < newRows.count(); ++i)
+            buffer->rows.append(newRows[i]);
+        buffer->error = result->lastError();
+        if (result->isBool()) {
+            buffer->hasBool = true;
+            buffer->boolValue = result->boolValue();
+        }
+        buffer->finished = true;
+        buffer->forwarder = 0;
+        buffer->changed.wakeAll();
+        buffer->notify();
+    }
+
+    // Called from the finished() signal of the result
+    result->deleteLater();
+    deleteLater();
+}
+
+void EndpointRowForwarder::resume()
+{
+    {
+        QMutexLocker locker(&buffer->mutex);
+        buffer->paused = false;
+    }
+    result->resume();
+}
+
+void EndpointRowForwarder::cancel()
+{
+    // Deleting the result aborts the reply
+    result->disconnect(this);
+    delete result;
+    deleteLater();
+}
+
+void EndpointThreadRunner::startJobs()
+{
+    const QList<EndpointThreadJob> jobs = thread->takeJobs();
+    for (int i = 0; i < jobs.count(); ++i) {
+        const EndpointThreadJob &job = jobs[i];
+
+        EndpointResult *result = new EndpointResult(&thread->threadPrivate);
+        result->setParent(this);
+        EndpointRowForwarder *forwarder = new EndpointRowForwarder(result, job.buffer, this);
+        {
+            QMutexLocker locker(&job.buffer->mutex);
+            if (job.buffer->cancelled) {
+                job.buffer->finished = true;
+                locker.unlock();
+                delete forwarder;
+                delete result;
+                continue;
+            }
+            job.buffer->forwarder = forwarder;
+        }
+
+        // A forward only result pauses the reply when the caller falls
+        // behind; then the reply stops reading from the socket
+        if (job.buffer->maxRows > 0)
+            result->setReadBufferSize(64 * 1024);
+        connect(result, SIGNAL(dataReady(int)), forwarder, SLOT(forwardRows()));
+        connect(result, SIGNAL(finished()), forwarder, SLOT(forwardFinished()));
+        result->exec(job.query, job.type, job.prefixes, job.options);
+    }
+}
+
+void EndpointThreadRunner::stop()
+{
+    thread->quit();
+}
+
+QVariantMap EndpointThreadRunner::statistics() const
+{
+    return thread->threadPrivate.statistics();
+}
+
+EndpointNetworkThread::EndpointNetworkThread(const EndpointDriverPrivate *driverPrivate)
+    : runner(0)
+{
+    threadPrivate.options = driverPrivate->options;
+    threadPrivate.url = driverPrivate->url;
+    threadPrivate.postThreshold = driverPrivate->postThreshold;
+    threadPrivate.updateOverPost = driverPrivate->updateOverPost;
+    threadPrivate.compression = driverPrivate->compression;
+    threadPrivate.user = driverPrivate->user;
+    threadPrivate.password = driverPrivate->password;
+#ifndef QT_NO_NETWORKPROXY
+    threadPrivate.proxy = driverPrivate->proxy;
+#endif
+    threadPrivate.scheduler.maxInFlight = driverPrivate->scheduler.maxInFlight;
+    threadPrivate.useNetworkThread = driverPrivate->useNetworkThread;
+    threadPrivate.replicas = driverPrivate->replicas;
+    threadPrivate.outstanding.fill(0, driverPrivate->replicas.count());
+    threadPrivate.hedging = driverPrivate->hedging;
+    threadPrivate.hedgePercentile = driverPrivate->hedgePercentile;
+    threadPrivate.hedgeDelay = driverPrivate->hedgeDelay;
+
+    QMutexLocker locker(&mutex);
+    start();
+    while (runner == 0)
+        started.wait(&mutex);
+}
+
+EndpointNetworkThread::~EndpointNetworkThread()
+{
+    // Stopped from its own event loop, which may not be running yet
+    {
+        QMutexLocker locker(&mutex);
+        if (runner)
+            QMetaObject::invokeMethod(runner, "stop", Qt::QueuedConnection);
+    }
+    wait();
+}
+
+void EndpointNetworkThread::enqueue(const EndpointThreadJob &job)
+{
+    QMutexLocker locker(&mutex);
+    jobs.append(job);
+    QMetaObject::invokeMethod(runner, "startJobs", Qt::QueuedConnection);
+}
+
+QVariantMap EndpointNetworkThread::statistics()
+{
+    QVariantMap stats;
+    // Not holding the mutex while waiting: the runner may have a startJobs
+    // queued before the call, and takeJobs() needs the mutex
+    EndpointThreadRunner *current;
+    {
+        QMutexLocker locker(&mutex);
+        current = runner;
+    }
+    // The runner stays until the thread is stopped by the destructor, which
+    // is called in this thread too
+    if (current)
+        QMetaObject::invokeMethod(current, "statistics", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(QVariantMap, stats));
+    return stats;
+}
+
+QList<EndpointThreadJob> EndpointNetworkThread::takeJobs()
+{
+    QMutexLocker locker(&mutex);
+    QList<EndpointThreadJob> taken = jobs;
+    jobs.clear();
+    return taken;
+}
+
+void EndpointNetworkThread::run()
+{
+    threadPrivate.manager = new QNetworkAccessManager();
+    threadPrivate.managerOwned = true;
+#ifndef QT_NO_NETWORKPROXY
+    if (threadPrivate.proxy.type() != QNetworkProxy::NoProxy)
+        threadPrivate.manager->setProxy(threadPrivate.proxy);
+#endif
+    // The cache goes with the asynchronous queries
+    if (threadPrivate.useNetworkThread)
+        threadPrivate.createDiskCache();
+
+    {
+        EndpointThreadRunner threadRunner(this);
+        {
+            QMutexLocker locker(&mutex);
+            runner = &threadRunner;
+            started.wakeAll();
+        }
+
+        exec();
+
+        QMutexLocker locker(&mutex);
+        runner = 0;
+        jobs.clear();
+        threadPrivate.scheduler.clear();
+        // The results and the forwarders still running are deleted with
+        // the runner, before the network access manager
+    }
+
+    delete threadPrivate.manager;
+    threadPrivate.manager = 0;
+    threadPrivate.managerOwned = false;
+}
+
+EndpointThreadResult::EndpointThreadResult(const QString &query, QSparqlQuery::StatementType type,
+                                           const EndpointRowBufferPointer &buffer,
+                                           bool async, bool forwardOnly)
+    : buffer(buffer), async(async), forwardOnly(forwardOnly && !async), networkFinished(false),
+      finishedEmitted(false), publishedRows(0)
+{
+    setQuery(query);
+    setStatementType(type);
+    if (async)
+        buffer->owner = this;
+}
+
+EndpointThreadResult::~EndpointThreadResult()
+{
+    QMutexLocker locker(&buffer->mutex);
+    buffer->cancelled = true;
+    buffer->owner = 0;
+    if (buffer->forwarder)
+        QMetaObject::invokeMethod(buffer->forwarder, "cancel", Qt::QueuedConnection);
+}
+
+void EndpointThreadResult::takeState()
+{
+    // Called with the buffer locked, when the network thread has finished
+    if (networkFinished)
+        return;
+    networkFinished = true;
+    if (buffer->error.type() != QSparqlError::NoError)
+        setLastError(buffer->error);
+    if (buffer->hasBool)
+        setBoolValue(buffer->boolValue);
+}
+
+bool EndpointThreadResult::fetchRows(int count)
+{
+    // Waits until the result has count rows or the reply has finished
+    QMutexLocker locker(&buffer->mutex);
+    while (rows.count() + buffer->rows.count() < count && !buffer->finished)
+        buffer->changed.wait(&buffer->mutex);
+    while (!buffer->rows.isEmpty())
+        rows.append(buffer->rows.takeFirst());
+    if (buffer->finished)
+        takeState();
+    return rows.count() >= count;
+}
+
+void EndpointThreadResult::publishRows()
+{
+    bool done;
+    {
+        QMutexLocker locker(&buffer->mutex);
+        buffer->notifyPending = false;
+        while (!buffer->rows.isEmpty())
+            rows.append(buffer->rows.takeFirst());
+        done = buffer->finished;
+        if (done)
+            takeState();
+    }
+
+    if (finishedEmitted)
+        return;
+    if (rows.count() != publishedRows) {
+        publishedRows = rows.count();
+        Q_EMIT dataReady(publishedRows);
+    }
+    if (done) {
+        finishedEmitted = true;
+        Q_EMIT finished();
+    }
+}
+
+bool EndpointThreadResult::next()
+{
+    // The rows of an asynchronous result are those published so far
+    if (async)
+        return QSparqlResult::next();
+
+    if (pos() == QSparql::AfterLastRow)
+        return false;
+    const int nextPos = pos() == QSparql::BeforeFirstRow ? 0 : pos() + 1;
+
+    if (!forwardOnly) {
+        if (!fetchRows(nextPos + 1)) {
+            updatePos(QSparql::AfterLastRow);
+            return false;
+        }
+        updatePos(nextPos);
+        return true;
+    }
+
+    QMutexLocker locker(&buffer->mutex);
+    while (buffer->rows.isEmpty() && !buffer->finished)
+        buffer->changed.wait(&buffer->mutex);
+
+    if (buffer->rows.isEmpty()) {
+        takeState();
+        currentRow = QSparqlResultRow();
+        updatePos(QSparql::AfterLastRow);
+        return false;
+    }
+
+    currentRow = buffer->rows.takeFirst();
+    if (buffer->paused && buffer->forwarder && buffer->rows.count() <= buffer->maxRows / 2)
+        QMetaObject::invokeMethod(buffer->forwarder, "resume", Qt::QueuedConnection);
+    updatePos(nextPos);
+    return true;
+}
+
+bool EndpointThreadResult::setPos(int pos)
+{
+    if (async)
+        return QSparqlResult::setPos(pos);
+    if (forwardOnly || pos < 0)
+        return false;
+    if (!fetchRows(pos + 1))
+        return false;
+    updatePos(pos);
+    return true;
+}
+
+QSparqlResultRow EndpointThreadResult::current() const
+{
+    if (pos() < 0)
+        return QSparqlResultRow();
+    if (forwardOnly)
+        return currentRow;
+    return pos() < rows.count() ? rows[pos()] : QSparqlResultRow();
+}
+
+QSparqlBinding EndpointThreadResult::binding(int field) const
+{
+    return current().binding(field);
+}
+
+QVariant EndpointThreadResult::value(int field) const
+{
+    return current().value(field);
+}
+
+int EndpointThreadResult::size() const
+{
+    if (async)
+        return rows.count();
+
+    // The size is known when all the rows have arrived
+    if (forwardOnly || !networkFinished)
+        return -1;
+    return rows.count();
+}
+
+void EndpointThreadResult::waitForFinished()
+{
+    if (async) {
+        {
+            QMutexLocker locker(&buffer->mutex);
+            while (!buffer->finished)
+                buffer->changed.wait(&buffer->mutex);
+        }
+        publishRows();
+        return;
+    }
+
+    if (!forwardOnly) {
+        fetchRows(INT_MAX);
+        return;
+    }
+
+    // The rows which haven't been read yet are kept
+    QMutexLocker locker(&buffer->mutex);
+    buffer->unlimited = true;
+    if (buffer->paused && buffer->forwarder)
+        QMetaObject::invokeMethod(buffer->forwarder, "resume", Qt::QueuedConnection);
+    while (!buffer->finished)
+        buffer->changed.wait(&buffer->mutex);
+    takeState();
+}
+
+void EndpointThreadResult::waitForData()
+{
+    // Waits until the first rows have arrived, so that the errors of the
+    // request are known when the query has been executed
+    if (!forwardOnly) {
+        fetchRows(1);
+        return;
+    }
+
+    QMutexLocker locker(&buffer->mutex);
+    while (buffer->rows.isEmpty() && !buffer->finished)
+        buffer->changed.wait(&buffer->mutex);
+    if (buffer->finished && buffer->rows.isEmpty())
+        takeState();
+}
+
+bool EndpointThreadResult::isFinished() const
+{
+    // Forward only results are finished when next() has read all the rows
+    return networkFinished && (!forwardOnly || pos() == QSparql::AfterLastRow);
+}
+
+bool EndpointThreadResult::hasFeature(QSparqlResult::Feature feature) const
+{
+    switch (feature) {
+    case QSparqlResult::Sync:
+        return !async;
+    case QSparqlResult::ForwardOnly:
+        return forwardOnly;
+    case QSparqlResult::QuerySize:
+        return !forwardOnly;
+    default:
+        return false;
+    }
+}
+
+QSparqlResult* EndpointDriver::threadExec(const QString& query, QSparqlQuery::StatementType type, const QSparqlQueryOptions& options)
+{
+    // The network thread is started with the first query it runs, and takes
+    // the settings of the connection
+    if (!d->networkThread)
+        d->networkThread = new EndpointNetworkThread(d);
+
+    EndpointThreadJob job;
+    job.query = query;
+    job.type = type;
+    job.prefixes = prefixes();
+    job.options = options;
+    job.buffer = EndpointRowBufferPointer(new EndpointRowBuffer);
+    const bool async = options.executionMethod() == QSparqlQueryOptions::AsyncExec;
+    if (!async && options.isForwardOnly())
+        job.buffer->maxRows = d->syncBufferRows;
+
+    EndpointThreadResult *result = new EndpointThreadResult(query, type, job.buffer,
+                                                            async, options.isForwardOnly());
+    d->networkThread->enqueue(job);
+    if (async)
+        return result;
+
+    // The rows of a SELECT or a CONSTRUCT are read with next(), the other
+    // queries have done their work when syncExec() returns
+    if (type == QSparqlQuery::SelectStatement || type == QSparqlQuery::ConstructStatement
+        || type == QSparqlQuery::DescribeStatement)
+        result->waitForData();
+    else
+        result->waitForFinished();
+    return result;
+}
+
+EndpointDriver::EndpointDriver(QObject * parent)
     : QSparqlDriver(parent)
 {
     d = new EndpointDriverPrivate();
@@ -533,6 +2367,7 @@ EndpointDriver::EndpointDriver(QObject * parent)
 
 EndpointDriver::~EndpointDriver()
 {
+    delete d->networkThread;
     if (d->managerOwned) {
         delete d->manager;
         d->managerOwned = false;
@@ -548,9 +2383,10 @@ bool EndpointDriver::hasFeature(QSparqlConnection::Feature f) const
     case QSparqlConnection::ConstructQueries:
     case QSparqlConnection::UpdateQueries:
     case QSparqlConnection::AsyncExec:
+    case QSparqlConnection::SyncExec:
+    case QSparqlConnection::GraphUpload:
         return true;
     case QSparqlConnection::DefaultGraph:
-    case QSparqlConnection::SyncExec:
         return false;
     default:
         return false;
@@ -581,6 +2417,43 @@ bool EndpointDriver::open(const QSparqlConnectionOptions& options)
     d->user = options.userName();
     d->password = options.password();
 
+    // Replicas of the endpoint share the reads; the updates go to the first
+    d->replicas.clear();
+    foreach (const QString &endpoint, options.option(QLatin1String("endpoints")).toStringList()) {
+        QUrl replica(endpoint);
+        if (replica.isValid() && !replica.host().isEmpty())
+            d->replicas.append(replica);
+        else
+            qWarning() << "QEndpoint: invalid endpoint URL" << endpoint;
+    }
+    if (d->replicas.isEmpty())
+        d->replicas.append(d->url);
+    else
+        d->url = d->replicas.first();
+    d->outstanding.fill(0, d->replicas.count());
+
+    d->hedging = options.option(QLatin1String("hedgeRequests")).toBool();
+    QVariant hedgePercentile = options.option(QLatin1String("hedgePercentile"));
+    d->hedgePercentile = hedgePercentile.isValid() ? qBound(1, hedgePercentile.toInt(), 100) : 95;
+    QVariant hedgeDelay = options.option(QLatin1String("hedgeDelay"));
+    d->hedgeDelay = hedgeDelay.isValid() ? qMax(0, hedgeDelay.toInt()) : 50;
+    d->latencies.clear();
+    d->nextLatency = 0;
+    d->hedgedRequests = 0;
+    d->hedgeWins = 0;
+
+    QVariant postThreshold = options.option(QLatin1String("postThreshold"));
+    d->postThreshold = postThreshold.isValid() ? postThreshold.toInt() : 2048;
+    QVariant updateOverPost = options.option(QLatin1String("updateOverPost"));
+    d->updateOverPost = updateOverPost.isValid() ? updateOverPost.toBool() : true;
+    QVariant compression = options.option(QLatin1String("compression"));
+    d->compression = compression.isValid() ? compression.toBool() : true;
+    QVariant maxRequestsPerHost = options.option(QLatin1String("maxRequestsPerHost"));
+    d->scheduler.maxInFlight = maxRequestsPerHost.toInt() > 0 ? maxRequestsPerHost.toInt() : 6;
+    d->useNetworkThread = options.option(QLatin1String("networkThread")).toBool();
+    QVariant syncBufferRows = options.option(QLatin1String("syncBufferRows"));
+    d->syncBufferRows = syncBufferRows.toInt() > 0 ? syncBufferRows.toInt() : 1000;
+
     if (d->managerOwned)
         delete d->manager;
     d->manager = 0;
@@ -592,7 +2465,12 @@ bool EndpointDriver::open(const QSparqlConnectionOptions& options)
         // mark that we need to delete it.
         d->manager = new QNetworkAccessManager();
         d->managerOwned = true;
+
+        if (!d->useNetworkThread)
+            d->createDiskCache();
     }
+    d->cacheHits = 0;
+    d->cacheMisses = 0;
 
 #ifndef QT_NO_NETWORKPROXY
     d->proxy = options.proxy();
@@ -607,16 +2485,109 @@ bool EndpointDriver::open(const QSparqlConnectionOptions& options)
 
 void EndpointDriver::close()
 {
+    // Nothing waiting in the queue is sent any more, and the synchronous
+    // results which haven't finished get an error
+    d->scheduler.clear();
+    delete d->networkThread;
+    d->networkThread = 0;
     Q_EMIT closing();
     if (isOpen()) {
         setOpen(false);
         setOpenError(false);
         d->url = QUrl();
+        d->replicas.clear();
+        d->outstanding.clear();
         d->user = QString();
         d->password = QString();
     }
 }
 
+void EndpointDriverPrivate::createDiskCache()
+{
+    // The replies are revalidated with If-None-Match or If-Modified-Since
+    // when the endpoint gave an ETag or a Last-Modified date, so a 304
+    // replays the cached result document
+    QString cacheDirectory = options.option(QLatin1String("cacheDirectory")).toString();
+    if (cacheDirectory.isEmpty())
+        return;
+
+    QNetworkDiskCache *cache = new QNetworkDiskCache(manager);
+    cache->setCacheDirectory(cacheDirectory);
+    QVariant cacheSize = options.option(QLatin1String("cacheSize"));
+    if (cacheSize.isValid())
+        cache->setMaximumCacheSize(cacheSize.toLongLong());
+    manager->setCache(cache);
+}
+
+QVariantMap EndpointDriverPrivate::statistics() const
+{
+    QVariantMap stats = scheduler.statistics();
+    if (manager && manager->cache()) {
+        stats.insert(QString::fromLatin1("cacheHits"), cacheHits);
+        stats.insert(QString::fromLatin1("cacheMisses"), cacheMisses);
+        stats.insert(QString::fromLatin1("cacheSize"), manager->cache()->cacheSize());
+        if (QNetworkDiskCache *cache = qobject_cast<QNetworkDiskCache *>(manager->cache()))
+            stats.insert(QString::fromLatin1("maximumCacheSize"), cache->maximumCacheSize());
+    }
+    if (replicas.count() > 1) {
+        QVariantMap replicaStats;
+        for (int i = 0; i < replicas.count(); ++i)
+            replicaStats.insert(replicas.at(i).toString(), outstanding.value(i));
+        stats.insert(QString::fromLatin1("outstandingRequests"), replicaStats);
+        stats.insert(QString::fromLatin1("hedgedRequests"), hedgedRequests);
+        stats.insert(QString::fromLatin1("hedgeWins"), hedgeWins);
+    }
+    return stats;
+}
+
+int EndpointDriverPrivate::pickReplica(int exclude) const
+{
+    // The least outstanding requests; the earlier replica on a tie
+    int best = -1;
+    for (int i = 0; i < outstanding.count(); ++i) {
+        if (i != exclude && (best < 0 || outstanding.at(i) < outstanding.at(best)))
+            best = i;
+    }
+    return best;
+}
+
+void EndpointDriverPrivate::releaseReplica(int replica)
+{
+    // The driver may have been reopened with other replicas meanwhile
+    if (replica >= 0 && replica < outstanding.count() && outstanding.at(replica) > 0)
+        --outstanding[replica];
+}
+
+int EndpointDriverPrivate::currentHedgeDelay() const
+{
+    // The percentile of the recent latencies, once there are enough of them
+    if (latencies.count() < 20)
+        return hedgeDelay;
+    QVector<qint64> sorted = latencies;
+    qSort(sorted);
+    const int index = qMin(sorted.count() - 1, sorted.count() * hedgePercentile / 100);
+    return int(sorted.at(index));
+}
+
+void EndpointDriverPrivate::addLatency(qint64 ms)
+{
+    if (latencies.count() < 100) {
+        latencies.append(ms);
+    } else {
+        latencies[nextLatency] = ms;
+        nextLatency = (nextLatency + 1) % latencies.count();
+    }
+}
+
+QVariantMap EndpointDriver::statistics() const
+{
+    // The queries run in the network thread are counted there
+    QVariantMap stats = d->statistics();
+    if (d->networkThread)
+        stats.insert(QString::fromLatin1("networkThread"), d->networkThread->statistics());
+    return stats;
+}
+
 EndpointResult* EndpointDriver::createResult() const
 {
     EndpointResult *result = new EndpointResult(d);
@@ -638,6 +2609,389 @@ void EndpointResult::driverClosing()
     qWarning() << "QEndpointResult: QSparqlConnection closed before QSparqlResult with query:" << query();
 }
 
+// Uploads RDF to a graph with the SPARQL 1.1 Graph Store HTTP Protocol. A
+// device of a known size is sent in one request, read as the request goes.
+// Sequential devices are sent in requests of about "uploadChunkSize" bytes,
+// cut at the end of a statement, so that the data never is in the memory
+// as a whole; each Turtle chunk gets the prefixes seen before it.
+class EndpointUploadResult : public QSparqlResult, public EndpointRequest
+{
+    Q_OBJECT
+public:
+    EndpointUploadResult(EndpointDriverPrivate *dpp, QIODevice *data, const QString &contentType,
+                         const QUrl &graph, QSparqlConnection::GraphUploadMode mode);
+    ~EndpointUploadResult();
+
+    QSparqlResultRow current() const { return QSparqlResultRow(); }
+    QSparqlBinding binding(int) const { return QSparqlBinding(); }
+    QVariant value(int) const { return QVariant(); }
+    void waitForFinished();
+    bool isFinished() const { return finishedFlag; }
+
+    void start();
+    bool isDone() const { return finishedFlag; }
+
+public Q_SLOTS:
+    void driverClosing();
+
+private Q_SLOTS:
+    void readDevice();
+    void deviceFinished();
+    void replyProgress(qint64 sent, qint64 total);
+    void replyFinished();
+
+private:
+    bool isDeviceAtEnd() const;
+    int statementsEnd(QByteArray &directives) const;
+    void send(QIODevice *data, const QByteArray &body);
+    void releaseSlot();
+    void fail(const QSparqlError &error);
+    void terminate();
+
+    EndpointDriverPrivate *driverPrivate;
+    QPointer<QIODevice> device;
+    QNetworkRequest request;
+    bool replace;           // the next request replaces the graph
+    bool turtle;
+    QNetworkReply *reply;
+    // The request waiting for a slot of the scheduler, or being sent
+    QIODevice *requestData;
+    QByteArray requestBody;
+    QString host;
+    bool waitingForSlot;
+    bool holdsSlot;
+    QByteArray pending;     // read from the device and not sent yet
+    QByteArray prologue;    // the Turtle prefixes and base of the chunks sent
+    qint64 chunkSize;
+    qint64 chunkBytes;      // the data in the request in flight
+    qint64 bytesSent;
+    qint64 bytesTotal;      // -1 for a sequential device
+    bool sentAny;
+    bool deviceDone;
+    bool finishedFlag;
+    QEventLoop *loop;
+};
+
+EndpointUploadResult::EndpointUploadResult(EndpointDriverPrivate *dpp, QIODevice *data,
+                                           const QString &contentType, const QUrl &graph,
+                                           QSparqlConnection::GraphUploadMode mode)
+    : driverPrivate(dpp), device(data), replace(mode == QSparqlConnection::ReplaceGraph),
+      turtle(false), reply(0), requestData(0), waitingForSlot(false), holdsSlot(false),
+      chunkSize(1024 * 1024), chunkBytes(0), bytesSent(0),
+      bytesTotal(-1), sentAny(false), deviceDone(false), finishedFlag(false), loop(0)
+{
+    setQuery(graph.isEmpty() ? QString::fromLatin1("default graph") : graph.toString());
+    setStatementType(QSparqlQuery::InsertStatement);
+
+    QString path = dpp->options.option(QLatin1String("graphStorePath")).toString();
+    if (path.isEmpty())
+        path = QLatin1String("sparql-graph-crud");
+    QUrl storeUrl(dpp->url);
+    storeUrl.setPath(path);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QUrlQuery urlQuery;
+    if (graph.isEmpty())
+        urlQuery.addQueryItem(QLatin1String("default"), QString());
+    else
+        urlQuery.addQueryItem(QLatin1String("graph"), graph.toString());
+    storeUrl.setQuery(urlQuery);
+#else
+    if (graph.isEmpty())
+        storeUrl.addQueryItem(QLatin1String("default"), QString());
+    else
+        storeUrl.addQueryItem(QLatin1String("graph"), graph.toString());
+#endif
+    request.setUrl(storeUrl);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, contentType.toLatin1());
+    if (!dpp->user.isEmpty() && !dpp->password.isEmpty()) {
+        const QByteArray credentials = dpp->user.toUtf8() + ':' + dpp->password.toUtf8();
+        request.setRawHeader("Authorization", "Basic " + credentials.toBase64());
+    }
+
+    QVariant uploadChunkSize = dpp->options.option(QLatin1String("uploadChunkSize"));
+    if (uploadChunkSize.toLongLong() > 0)
+        chunkSize = uploadChunkSize.toLongLong();
+
+    if (!data->isSequential()) {
+        // Read by the network access manager as the request is sent
+        bytesTotal = data->size() - data->pos();
+        send(data, QByteArray());
+        return;
+    }
+
+    const QString type = contentType.section(QLatin1Char(';'), 0, 0).trimmed().toLower();
+    turtle = type == QLatin1String("text/turtle") || type == QLatin1String("application/x-turtle");
+    if (!turtle && type != QLatin1String("application/n-triples") && type != QLatin1String("text/plain")) {
+        // Other formats can't be split into chunks
+        setLastError(QSparqlError(QString::fromLatin1("Only N-Triples and Turtle can be uploaded "
+                                                      "from a sequential device"),
+                                  QSparqlError::StatementError));
+        qWarning() << "QEndpoint:" << lastError() << query();
+        finishedFlag = true;
+        return;
+    }
+
+    connect(data, SIGNAL(readyRead()), this, SLOT(readDevice()));
+    connect(data, SIGNAL(readChannelFinished()), this, SLOT(deviceFinished()));
+    QMetaObject::invokeMethod(this, "readDevice", Qt::QueuedConnection);
+}
+
+EndpointUploadResult::~EndpointUploadResult()
+{
+    if (reply && driverPrivate) {
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+    releaseSlot();
+}
+
+bool EndpointUploadResult::isDeviceAtEnd() const
+{
+    if (deviceDone || !device->isOpen())
+        return true;
+    // A socket has no data for the moment when atEnd() is true, the data
+    // ends when the peer closes the connection
+    if (qobject_cast<QAbstractSocket *>(device))
+        return false;
+#ifndef QT_NO_LOCALSOCKET
+    if (qobject_cast<QLocalSocket *>(device))
+        return false;
+#endif
+    return device->atEnd();
+}
+
+void EndpointUploadResult::deviceFinished()
+{
+    deviceDone = true;
+    readDevice();
+}
+
+void EndpointUploadResult::readDevice()
+{
+    // The next chunk is read when the previous one has been sent
+    if (finishedFlag || reply || waitingForSlot)
+        return;
+    if (!device) {
+        fail(QSparqlError(QString::fromLatin1("Upload device deleted"),
+                          QSparqlError::ConnectionError));
+        return;
+    }
+
+    while (pending.size() < chunkSize) {
+        const QByteArray data = device->read(chunkSize - pending.size());
+        if (data.isEmpty())
+            break;
+        pending += data;
+    }
+
+    const bool atEnd = isDeviceAtEnd();
+    if (atEnd) {
+        // An empty upload still clears the graph it replaces
+        if (pending.isEmpty() && (sentAny || !replace)) {
+            terminate();
+            return;
+        }
+        send(0, prologue + pending);
+        chunkBytes = pending.size();
+        pending.clear();
+        return;
+    }
+    if (pending.size() < chunkSize)
+        return;
+
+    QByteArray directives;
+    int end = statementsEnd(directives);
+    while (end == 0) {
+        // A statement longer than a chunk; read on to its end
+        const QByteArray data = device->read(chunkSize);
+        if (data.isEmpty())
+            return;
+        pending += data;
+        end = statementsEnd(directives);
+    }
+
+    send(0, prologue + pending.left(end));
+    chunkBytes = end;
+    pending.remove(0, end);
+    prologue += directives;
+}
+
+// @prefix and @base, or their SPARQL style forms
+static bool isTurtleDirective(const QByteArray &line)
+{
+    if (line.startsWith("@prefix") || line.startsWith("@base"))
+        return true;
+    const QByteArray keyword = line.left(line.indexOf(' ')).toUpper();
+    return keyword == "PREFIX" || keyword == "BASE";
+}
+
+// Returns the length of the complete statements at the start of pending
+// data, and the Turtle directives in them
+int EndpointUploadResult::statementsEnd(QByteArray &directives) const
+{
+    if (!turtle)
+        return pending.lastIndexOf('\n') + 1;
+
+    directives.clear();
+    QByteArray lineDirectives;
+    int end = 0;
+    char longQuote = 0;     // in a """ or ''' string, which can span lines
+    int lineStart = 0;
+    while (lineStart < pending.size()) {
+        const int newline = pending.indexOf('\n', lineStart);
+        if (newline == -1)
+            break;
+        const QByteArray line = pending.mid(lineStart, newline - lineStart).trimmed();
+        const bool inString = longQuote != 0;
+        for (int i = 0; i + 2 < line.size(); ++i) {
+            const char c = line.at(i);
+            if ((c == '"' || c == '\'') && line.at(i + 1) == c && line.at(i + 2) == c
+                && (longQuote == 0 || longQuote == c)) {
+                longQuote = longQuote ? 0 : c;
+                i += 2;
+            }
+        }
+        if (!inString && longQuote == 0 && isTurtleDirective(line))
+            lineDirectives += line + '\n';
+        // A statement ends with a dot outside of a string
+        if (longQuote == 0 && line.endsWith('.') && (inString || !line.startsWith('#'))) {
+            end = newline + 1;
+            directives += lineDirectives;
+            lineDirectives.clear();
+        }
+        lineStart = newline + 1;
+    }
+    return end;
+}
+
+// The request is sent by start() when the scheduler has a free slot for
+// the host, like the queries
+void EndpointUploadResult::send(QIODevice *data, const QByteArray &body)
+{
+    requestData = data;
+    requestBody = body;
+    waitingForSlot = true;
+    host = EndpointScheduler::hostKey(request.url());
+    driverPrivate->scheduler.enqueue(this, this, host, QSparqlQueryOptions::NormalPriority);
+}
+
+void EndpointUploadResult::start()
+{
+    waitingForSlot = false;
+    holdsSlot = true;
+    QNetworkRequest chunkRequest(request);
+    if (requestData) {
+        chunkRequest.setHeader(QNetworkRequest::ContentLengthHeader, bytesTotal);
+        chunkRequest.setAttribute(QNetworkRequest::DoNotBufferUploadDataAttribute, true);
+        reply = replace ? driverPrivate->manager->put(chunkRequest, requestData)
+                        : driverPrivate->manager->post(chunkRequest, requestData);
+    } else {
+        chunkRequest.setHeader(QNetworkRequest::ContentLengthHeader, requestBody.size());
+        reply = replace ? driverPrivate->manager->put(chunkRequest, requestBody)
+                        : driverPrivate->manager->post(chunkRequest, requestBody);
+    }
+    requestData = 0;
+    requestBody.clear();
+    // The chunks after the first one add to the replaced graph
+    replace = false;
+    sentAny = true;
+
+    connect(reply, SIGNAL(uploadProgress(qint64,qint64)), this, SLOT(replyProgress(qint64,qint64)));
+    connect(reply, SIGNAL(finished()), this, SLOT(replyFinished()));
+}
+
+void EndpointUploadResult::replyProgress(qint64 sent, qint64 total)
+{
+    Q_UNUSED(total);
+    if (bytesTotal >= 0)
+        Q_EMIT uploadProgress(sent, bytesTotal);
+    else
+        Q_EMIT uploadProgress(bytesSent + qMin(sent, chunkBytes), -1);
+}
+
+void EndpointUploadResult::releaseSlot()
+{
+    if (!holdsSlot)
+        return;
+    holdsSlot = false;
+    if (driverPrivate)
+        driverPrivate->scheduler.requestDone(host);
+}
+
+void EndpointUploadResult::replyFinished()
+{
+    QNetworkReply *finishedReply = reply;
+    reply = 0;
+    finishedReply->deleteLater();
+    releaseSlot();
+    if (finishedReply->error() != QNetworkReply::NoError) {
+        fail(QSparqlError(finishedReply->errorString(), QSparqlError::ConnectionError,
+                          finishedReply->error()));
+        return;
+    }
+
+    if (bytesTotal >= 0) {
+        terminate();
+        return;
+    }
+    bytesSent += chunkBytes;
+    chunkBytes = 0;
+    Q_EMIT uploadProgress(bytesSent, -1);
+    readDevice();
+}
+
+void EndpointUploadResult::fail(const QSparqlError &error)
+{
+    setLastError(error);
+    qWarning() << "QEndpoint:" << lastError() << query();
+    if (reply && driverPrivate) {
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+    reply = 0;
+    releaseSlot();
+    terminate();
+}
+
+void EndpointUploadResult::terminate()
+{
+    if (finishedFlag)
+        return;
+    finishedFlag = true;
+    Q_EMIT finished();
+    if (loop)
+        loop->exit();
+}
+
+void EndpointUploadResult::waitForFinished()
+{
+    if (finishedFlag)
+        return;
+
+    QEventLoop eventLoop;
+    loop = &eventLoop;
+    eventLoop.exec();
+    loop = 0;
+}
+
+void EndpointUploadResult::driverClosing()
+{
+    if (!finishedFlag)
+        fail(QSparqlError(QString::fromUtf8("QSparqlConnection closed before QSparqlResult"),
+                          QSparqlError::ConnectionError));
+    driverPrivate = 0;
+}
+
+QSparqlResult* EndpointDriver::uploadGraph(QIODevice* data, const QString& contentType, const QUrl& graph,
+                                           QSparqlConnection::GraphUploadMode mode)
+{
+    EndpointUploadResult *result = new EndpointUploadResult(d, data, contentType, graph, mode);
+    QObject::connect(this, SIGNAL(closing()), result, SLOT(driverClosing()));
+    return result;
+}
+
 QT_END_NAMESPACE
 
 #include "qsparql_endpoint.moc"
@@ -42,6 +42,10 @@
 
 #include <private/qsparqldriver_p.h>
 #include <qsparqlresult.h>
+#include <qsparqlresultrow.h>
+#include <qsparqlqueryoptions.h>
+
+#include <QtCore/qvector.h>
 
 #if defined (Q_OS_WIN32)
 #include <QtCore/qt_windows.h>
@@ -71,7 +75,8 @@ public:
 
     QVariant handle() const;
     // TODO: this should be removed
-    bool exec(const QString& query, QSparqlQuery::StatementType type, const QString& prefixes);
+    bool exec(const QString& query, QSparqlQuery::StatementType type, const QString& prefixes,
+              const QSparqlQueryOptions& options = QSparqlQueryOptions());
 
     QSparqlBinding binding(int field) const;
     QVariant value(int field) const;
@@ -81,6 +86,13 @@ public:
     void waitForFinished();
     bool isFinished() const;
 
+    // Used by the synchronous results, which run the request in the network
+    // thread of the driver
+    QVector<QSparqlResultRow> takeRows();
+    void setReadBufferSize(qint64 size);
+    void pause();
+    void resume();
+
 protected:
     void cleanup();
 
@@ -103,12 +115,17 @@ public:
     bool open(const QSparqlConnectionOptions& options);
     void close();
     EndpointResult* createResult() const;
-    EndpointResult* exec(const QString& query, QSparqlQuery::StatementType type, const QSparqlQueryOptions& options);
+    QSparqlResult* exec(const QString& query, QSparqlQuery::StatementType type, const QSparqlQueryOptions& options);
+    QVariantMap statistics() const;
+    QSparqlResult* uploadGraph(QIODevice* data, const QString& contentType, const QUrl& graph,
+                               QSparqlConnection::GraphUploadMode mode);
 
 Q_SIGNALS:
     void closing();
 
 private:
+    QSparqlResult* threadExec(const QString& query, QSparqlQuery::StatementType type, const QSparqlQueryOptions& options);
+
     EndpointDriverPrivate* d;
 };
 
@@ -52,9 +52,26 @@
 #include <qvector.h>
 #include <qstring.h>
 #include <qregexp.h>
+#include <qdatetime.h>
+#include <qurl.h>
+#include <qsocketnotifier.h>
+#include <qtimer.h>
+#include <qelapsedtimer.h>
+#include <qpointer.h>
 
 #include <qdebug.h>
 
+#define XSD_INTEGER
+#include "../../kernel/qsparqlxsd_p.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(4, 8, 0) && defined(Q_OS_UNIX)
+#define QT_SPARQL_TRACKER_STEROIDS
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 Q_DECLARE_METATYPE(QVector<QStringList>)
 
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
@@ -112,11 +129,30 @@ typedef enum  {
     TRACKER_SPARQL_ERROR_UNSUPPORTED
 } TrackerSparqlError;
 
+// This enum is defined in tracker-sparql.h too. The Steroids interface sends
+// these as the type of each cell.
+typedef enum {
+    TRACKER_SPARQL_VALUE_TYPE_UNBOUND,
+    TRACKER_SPARQL_VALUE_TYPE_URI,
+    TRACKER_SPARQL_VALUE_TYPE_STRING,
+    TRACKER_SPARQL_VALUE_TYPE_INTEGER,
+    TRACKER_SPARQL_VALUE_TYPE_DOUBLE,
+    TRACKER_SPARQL_VALUE_TYPE_DATETIME,
+    TRACKER_SPARQL_VALUE_TYPE_BLANK_NODE,
+    TRACKER_SPARQL_VALUE_TYPE_BOOLEAN
+} TrackerSparqlValueType;
+
+class QTrackerUpdateBatcher;
+class QTrackerUpdateBatch;
+
 class QTrackerDriverPrivate {
 public:
     QTrackerDriverPrivate();
     ~QTrackerDriverPrivate();
     QDBusInterface* iface;
+    QDBusInterface* steroidsIface; // 0 if Tracker doesn't offer the
+                                   // Steroids interface
+    QTrackerUpdateBatcher* batcher; // 0 if updates are not batched
     bool doBatch; // true: call BatchSparqlUpdate on Tracker instead of
                   // SparqlUpdateBlank
 };
@@ -129,18 +165,93 @@ public:
 
     ~QTrackerResultPrivate();
     QDBusPendingCallWatcher* watcher;
-    QVector<QStringList> data;
+    QVector<QSparqlResultRow> results;
+    QStringList columnNames;
+    // The columns of the first row, shared by the rest of them
+    QSparqlResultRowSchema schema;
     QTrackerDriverPrivate* driverPrivate;
+    QString prefixes;
     void setCall(QDBusPendingCall& call);
+    void setDBusError(const QDBusError& dbusError);
     static TrackerSparqlError errorNameToCode(const QString& name);
     static QSparqlError::ErrorType errorCodeToType(TrackerSparqlError code);
+    static QSparqlBinding makeBinding(const QString& name, int type,
+                                      const char* str, int len);
+
+    // Reading the results of a Steroids query from the pipe
+    int pipeFd;
+    QSocketNotifier* notifier;
+    QByteArray buffer;
+    void setPipe(int fd);
+    void readPipe();
+    void closePipe();
+    void waitForReply();
+    bool parseBuffer();
+
+    // State of an update which was queued into a batch
+    bool batched;
+    bool batchDone;
+    QPointer<QTrackerUpdateBatch> batch;
+    void batchFinished(const QDBusError& dbusError);
 
 private Q_SLOTS:
     void onDBusCallFinished();
+    void onPipeReadable();
 private:
     QTrackerResult* q; // public part
 };
 
+// One BatchSparqlUpdate call, followed by a BatchCommit, carrying the
+// updates of several QTrackerResults.
+class QTrackerUpdateBatch : public QObject {
+    Q_OBJECT
+public:
+    QTrackerUpdateBatch(QDBusInterface* iface, const QString& updates,
+                        const QList<QPointer<QTrackerResultPrivate> >& results,
+                        QObject* parent);
+    ~QTrackerUpdateBatch();
+
+    void waitForFinished();
+
+private Q_SLOTS:
+    void onUpdateFinished();
+    void onCommitFinished();
+
+private:
+    QDBusPendingCallWatcher* updateWatcher;
+    QDBusPendingCallWatcher* commitWatcher;
+    QList<QPointer<QTrackerResultPrivate> > results;
+    QDBusError error;
+    bool isFinished;
+};
+
+// Collects the updates issued within the batch window and sends them to
+// Tracker as one QTrackerUpdateBatch.
+class QTrackerUpdateBatcher : public QObject {
+    Q_OBJECT
+public:
+    QTrackerUpdateBatcher(QTrackerDriverPrivate* dp, int window);
+
+    void enqueue(const QString& query, const QString& prefixes,
+                 QTrackerResultPrivate* result);
+
+public Q_SLOTS:
+    void flush();
+
+private:
+    void send(const QString& updates,
+              const QList<QPointer<QTrackerResultPrivate> >& results);
+
+    QTrackerDriverPrivate* driverPrivate;
+    QTimer timer;
+    // The prologue of a query, which can't go in a batch with other ones;
+    // indexIn() modifies it, so each batcher has its own
+    QRegExp prologue;
+    QString pendingPrefixes;
+    QStringList pendingUpdates;
+    QList<QPointer<QTrackerResultPrivate> > pendingResults;
+};
+
 namespace {
 
 // How to recognize tracker
@@ -148,12 +259,15 @@ QLatin1String service("org.freedesktop.Tracker1");
 QLatin1String basePath("/org/freedesktop/Tracker1");
 QLatin1String resourcesInterface("org.freedesktop.Tracker1.Resources");
 QLatin1String resourcesPath("/org/freedesktop/Tracker1/Resources");
+QLatin1String steroidsInterface("org.freedesktop.Tracker1.Steroids");
+QLatin1String steroidsPath("/org/freedesktop/Tracker1/Steroids");
 
 } // end of unnamed namespace
 
 QTrackerResultPrivate::QTrackerResultPrivate(QTrackerResult* res,
                                              QTrackerDriverPrivate* dp)
-: watcher(0), driverPrivate(dp), q(res)
+: watcher(0), driverPrivate(dp), pipeFd(-1), notifier(0),
+  batched(false), batchDone(false), q(res)
 {
 }
 
@@ -167,9 +281,192 @@ void QTrackerResultPrivate::setCall(QDBusPendingCall& call)
 
 QTrackerResultPrivate::~QTrackerResultPrivate()
 {
+    closePipe();
     delete watcher;
 }
 
+void QTrackerResultPrivate::setPipe(int fd)
+{
+#ifdef QT_SPARQL_TRACKER_STEROIDS
+    // Tracker writes the whole result set into the pipe before it replies
+    // to the D-Bus call, so the pipe has to be drained while waiting for the
+    // reply; otherwise Tracker blocks once the pipe buffer is full.
+    pipeFd = fd;
+    ::fcntl(pipeFd, F_SETFL, ::fcntl(pipeFd, F_GETFL) | O_NONBLOCK);
+    notifier = new QSocketNotifier(pipeFd, QSocketNotifier::Read);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(onPipeReadable()));
+#else
+    Q_UNUSED(fd);
+#endif
+}
+
+void QTrackerResultPrivate::onPipeReadable()
+{
+    readPipe();
+}
+
+// Reads what is in the pipe now. The pipe doesn't reach its end while the
+// D-Bus call is alive, because the pending call keeps the message, and with
+// it a copy of the write end.
+void QTrackerResultPrivate::readPipe()
+{
+#ifdef QT_SPARQL_TRACKER_STEROIDS
+    if (pipeFd < 0)
+        return;
+
+    char chunk[16384];
+    for (;;) {
+        const ssize_t n = ::read(pipeFd, chunk, sizeof(chunk));
+        if (n > 0) {
+            buffer.append(chunk, n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN) {
+            // The rest of the data will arrive later
+            return;
+        } else {
+            // End of file or a read error
+            break;
+        }
+    }
+    closePipe();
+#endif
+}
+
+// Waits for the reply to the D-Bus call. The pipe is drained meanwhile,
+// since Tracker writes all the results before it replies.
+void QTrackerResultPrivate::waitForReply()
+{
+#ifdef QT_SPARQL_TRACKER_STEROIDS
+    if (pipeFd >= 0) {
+        int timeout = driverPrivate->steroidsIface ? driverPrivate->steroidsIface->timeout() : -1;
+        if (timeout < 0)
+            timeout = 25000; // the default timeout of D-Bus
+        QElapsedTimer timer;
+        timer.start();
+        while (pipeFd >= 0 && !watcher->isFinished() && timer.elapsed() < timeout) {
+            pollfd readable;
+            readable.fd = pipeFd;
+            readable.events = POLLIN;
+            readable.revents = 0;
+            if (::poll(&readable, 1, 10) > 0)
+                readPipe();
+            // The reply may be read by the event loop of this thread
+            QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+        }
+    }
+#endif
+    // The connection may have been closed meanwhile
+    if (watcher)
+        watcher->waitForFinished();
+}
+
+void QTrackerResultPrivate::closePipe()
+{
+#ifdef QT_SPARQL_TRACKER_STEROIDS
+    delete notifier;
+    notifier = 0;
+    if (pipeFd >= 0) {
+        ::close(pipeFd);
+        pipeFd = -1;
+    }
+#endif
+}
+
+/*
+    Converts the contents of the pipe into result rows. For each row Tracker
+    writes the number of columns, the type of each column, the offset of the
+    terminating zero of each column and then the zero-terminated values.
+    All integers are in host byte order.
+*/
+bool QTrackerResultPrivate::parseBuffer()
+{
+    const char* p = buffer.constData();
+    const char* end = p + buffer.size();
+    const int intSize = sizeof(qint32);
+
+    while (p < end) {
+        qint32 nColumns = 0;
+        if (end - p < intSize)
+            return false;
+        memcpy(&nColumns, p, intSize);
+        p += intSize;
+        if (nColumns <= 0 || end - p < 2 * nColumns * intSize)
+            return false;
+
+        const char* types = p;
+        p += nColumns * intSize;
+        const char* offsets = p;
+        p += nColumns * intSize;
+
+        qint32 lastOffset = 0;
+        memcpy(&lastOffset, offsets + (nColumns - 1) * intSize, intSize);
+        if (lastOffset < 0 || end - p < lastOffset + 1)
+            return false;
+        const char* data = p;
+        p += lastOffset + 1;
+
+        QSparqlResultRow row(schema);
+        qint32 start = 0;
+        for (int i = 0; i < nColumns; ++i) {
+            qint32 type = 0;
+            qint32 offset = 0;
+            memcpy(&type, types + i * intSize, intSize);
+            memcpy(&offset, offsets + i * intSize, intSize);
+            if (offset < start || offset > lastOffset)
+                return false;
+            row.append(makeBinding(columnNames.value(i), type, data + start, offset - start));
+            start = offset + 1;
+        }
+        if (schema.isEmpty())
+            schema = row.schema();
+        results.append(row);
+    }
+
+    buffer.clear();
+    return true;
+}
+
+QSparqlBinding QTrackerResultPrivate::makeBinding(const QString& name, int type,
+                                                  const char* str, int len)
+{
+    QSparqlBinding b(name);
+    const QByteArray value = QByteArray::fromRawData(str, len);
+
+    switch (type) {
+    case TRACKER_SPARQL_VALUE_TYPE_UNBOUND:
+        break;
+    case TRACKER_SPARQL_VALUE_TYPE_URI:
+        b.setValue(QUrl::fromEncoded(value));
+        break;
+    case TRACKER_SPARQL_VALUE_TYPE_STRING:
+        b.setValue(QString::fromUtf8(str, len));
+        break;
+    case TRACKER_SPARQL_VALUE_TYPE_INTEGER:
+        // Stored as longlong like in the QTRACKER_DIRECT driver, but the
+        // data type uri should be xsd:integer.
+        b.setValue(value.toLongLong());
+        b.setDataTypeUri(*XSD::Integer());
+        break;
+    case TRACKER_SPARQL_VALUE_TYPE_DOUBLE:
+        b.setValue(value.toDouble());
+        break;
+    case TRACKER_SPARQL_VALUE_TYPE_DATETIME:
+        b.setValue(QDateTime::fromString(QString::fromLatin1(str, len), Qt::ISODate));
+        break;
+    case TRACKER_SPARQL_VALUE_TYPE_BLANK_NODE:
+        b.setBlankNodeLabel(QString::fromUtf8(str, len));
+        break;
+    case TRACKER_SPARQL_VALUE_TYPE_BOOLEAN:
+        b.setValue(value == "1" || value == "true");
+        break;
+    default:
+        b.setValue(QString::fromUtf8(str, len));
+        break;
+    }
+    return b;
+}
+
 TrackerSparqlError QTrackerResultPrivate::errorNameToCode(const QString& name)
 {
     if (name == QLatin1String("org.freedesktop.Tracker1.SparqlError.Parse")) {
@@ -217,22 +514,37 @@ QSparqlError::ErrorType QTrackerResultPrivate::errorCodeToType(TrackerSparqlErro
     }
 }
 
+void QTrackerResultPrivate::setDBusError(const QDBusError& dbusError)
+{
+    QSparqlError error(dbusError.message());
+    if (dbusError.type() == QDBusError::Other) {
+        TrackerSparqlError code = errorNameToCode(dbusError.name());
+        error.setNumber(code);
+        error.setType(errorCodeToType(code));
+    } else {
+        // Error from D-Bus
+        error.setNumber((int)dbusError.type());
+        error.setType(QSparqlError::ConnectionError);
+    }
+
+    q->setLastError(error);
+    qWarning() << "QTrackerResult:" << q->lastError() << q->query();
+}
+
+void QTrackerResultPrivate::batchFinished(const QDBusError& dbusError)
+{
+    batchDone = true;
+    if (dbusError.isValid())
+        setDBusError(dbusError);
+    Q_EMIT q->finished();
+}
+
 void QTrackerResultPrivate::onDBusCallFinished()
 {
     if (watcher->isError()) {
-        QSparqlError error(watcher->error().message());
-        if (watcher->error().type() == QDBusError::Other) {
-            TrackerSparqlError code = errorNameToCode(watcher->error().name());
-            error.setNumber(code);
-            error.setType(errorCodeToType(code));
-        } else {
-            // Error from D-Bus
-            error.setNumber((int)watcher->error().type());
-            error.setType(QSparqlError::ConnectionError);
-        }
-
-        q->setLastError(error);
-        qWarning() << "QTrackerResult:" << q->lastError() << q->query();
+        closePipe();
+        buffer.clear();
+        setDBusError(watcher->error());
         Q_EMIT q->finished();
         return;
     }
@@ -241,16 +553,47 @@ void QTrackerResultPrivate::onDBusCallFinished()
     case QSparqlQuery::AskStatement:
     case QSparqlQuery::SelectStatement:
     {
-        QDBusPendingReply<QVector<QStringList> > reply = *watcher;
-        data = reply.argumentAt<0>();
+        if (driverPrivate->steroidsIface) {
+            QDBusPendingReply<QStringList> reply = *watcher;
+            columnNames = reply.argumentAt<0>();
+            // Tracker has written everything by now, read what's left
+            readPipe();
+            closePipe();
+            if (!parseBuffer()) {
+                results.clear();
+                buffer.clear();
+                q->setLastError(QSparqlError(
+                        QLatin1String("Malformed reply from the Steroids interface"),
+                        QSparqlError::BackendError));
+                qWarning() << "QTrackerResult:" << q->lastError() << q->query();
+                Q_EMIT q->finished();
+                return;
+            }
+        } else {
+            // The plain interface only gives strings and no variable names
+            QDBusPendingReply<QVector<QStringList> > reply = *watcher;
+            const QVector<QStringList> data = reply.argumentAt<0>();
+            results.reserve(data.count());
+            Q_FOREACH (const QStringList& strings, data) {
+                QSparqlResultRow row(schema);
+                for (int i = 0; i < strings.count(); ++i) {
+                    if (columnNames.count() <= i)
+                        columnNames.append(QString::fromLatin1("$%1").arg(i + 1));
+                    row.append(QSparqlBinding(columnNames[i], strings[i]));
+                }
+                if (row.count() > schema.count())
+                    schema = row.schema();
+                results.append(row);
+            }
+        }
 
-        if (q->statementType() == QSparqlQuery::AskStatement && data.count() == 1 && data[0].count() == 1)
+        if (q->statementType() == QSparqlQuery::AskStatement && results.count() == 1 && results[0].count() == 1)
         {
-            QVariant boolValue = data[0][0];
+            QVariant boolValue = results[0].value(0);
             q->setBoolValue(boolValue.toBool());
         }
 
-        Q_EMIT q->dataReady(data.size());
+        Q_EMIT q->dataReady(results.size());
         break;
     }
     default:
@@ -260,11 +603,130 @@ void QTrackerResultPrivate::onDBusCallFinished()
     Q_EMIT q->finished();
 }
 
+QTrackerUpdateBatch::QTrackerUpdateBatch(QDBusInterface* iface, const QString& updates,
+                                         const QList<QPointer<QTrackerResultPrivate> >& res,
+                                         QObject* parent)
+    : QObject(parent), results(res), isFinished(false)
+{
+    // Tracker handles the calls in order, so the commit is done after the
+    // updates have been applied
+    QDBusPendingCall updateCall = iface->asyncCall(QString::fromLatin1("BatchSparqlUpdate"),
+                                                   QVariant(updates));
+    QDBusPendingCall commitCall = iface->asyncCall(QString::fromLatin1("BatchCommit"));
+    updateWatcher = new QDBusPendingCallWatcher(updateCall);
+    commitWatcher = new QDBusPendingCallWatcher(commitCall);
+    connect(updateWatcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onUpdateFinished()));
+    connect(commitWatcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCommitFinished()));
+
+    Q_FOREACH (const QPointer<QTrackerResultPrivate>& result, results) {
+        if (result)
+            result->batch = this;
+    }
+}
+
+QTrackerUpdateBatch::~QTrackerUpdateBatch()
+{
+    delete updateWatcher;
+    delete commitWatcher;
+}
+
+void QTrackerUpdateBatch::waitForFinished()
+{
+    updateWatcher->waitForFinished();
+    commitWatcher->waitForFinished();
+}
+
+void QTrackerUpdateBatch::onUpdateFinished()
+{
+    if (updateWatcher->isError())
+        error = updateWatcher->error();
+}
+
+void QTrackerUpdateBatch::onCommitFinished()
+{
+    if (isFinished)
+        return;
+    isFinished = true;
+
+    // An error in any of the updates fails the whole batch, since Tracker
+    // executes the updates of one call in one transaction.
+    if (!error.isValid() && commitWatcher->isError())
+        error = commitWatcher->error();
+
+    Q_FOREACH (const QPointer<QTrackerResultPrivate>& result, results) {
+        if (result)
+            result->batchFinished(error);
+    }
+    deleteLater();
+}
+
+QTrackerUpdateBatcher::QTrackerUpdateBatcher(QTrackerDriverPrivate* dp, int window)
+    : driverPrivate(dp),
+      prologue(QLatin1String("^(\\s|#[^\\n]*\\n)*(PREFIX|BASE)\\b"), Qt::CaseInsensitive)
+{
+    timer.setSingleShot(true);
+    timer.setInterval(window);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+void QTrackerUpdateBatcher::enqueue(const QString& query, const QString& prefixes,
+                                    QTrackerResultPrivate* result)
+{
+    // The query text begins with the prefixes of the connection. The
+    // prefixes of a query with a prologue of its own would apply to the
+    // updates after it in the batch, so it is sent in a batch of its own.
+    QString body = query.mid(prefixes.length()).trimmed();
+    // The updates are separated by ";" in the batch; a second one after the
+    // one of the query would make the batch invalid
+    if (body.endsWith(QLatin1Char(';')))
+        body.chop(1);
+
+    QList<QPointer<QTrackerResultPrivate> > resultList;
+    resultList.append(result);
+
+    if (body.isEmpty() || prologue.indexIn(body) != -1) {
+        flush();
+        send(query, resultList);
+        return;
+    }
+
+    if (!pendingUpdates.isEmpty() && prefixes != pendingPrefixes)
+        flush();
+
+    pendingPrefixes = prefixes;
+    pendingUpdates.append(body);
+    pendingResults.append(resultList);
+    if (!timer.isActive())
+        timer.start();
+}
+
+void QTrackerUpdateBatcher::flush()
+{
+    timer.stop();
+    if (pendingUpdates.isEmpty())
+        return;
+
+    // On a line of its own, in case an update ends with a comment
+    send(pendingPrefixes + pendingUpdates.join(QLatin1String("\n;\n")), pendingResults);
+    pendingPrefixes.clear();
+    pendingUpdates.clear();
+    pendingResults.clear();
+}
+
+void QTrackerUpdateBatcher::send(const QString& updates,
+                                 const QList<QPointer<QTrackerResultPrivate> >& results)
+{
+    new QTrackerUpdateBatch(driverPrivate->iface, updates, results, this);
+}
+
 QTrackerResult::QTrackerResult(const QString& query, QSparqlQuery::StatementType tp, QTrackerDriver* driver)
 {
     setQuery(query);
     setStatementType(tp);
     d = new QTrackerResultPrivate(this, driver->d);
+    d->prefixes = driver->prefixes();
     connect(driver, SIGNAL(closing()), this, SLOT(driverClosing()), Qt::DirectConnection);
 }
 
@@ -280,13 +742,12 @@ QSparqlBinding QTrackerResult::binding(int field) const
     }
 
     int i = pos();
-    if (field >= d->data[i].count() || field < 0) {
+    if (field >= d->results[i].count() || field < 0) {
         qWarning() << "QTrackerResult::data: column" << field << "out of range";
         return QSparqlBinding();
     }
 
-    QString name = QString::fromLatin1("$%1").arg(field + 1);
-    return QSparqlBinding(name, QVariant(d->data[i][field]));
+    return d->results[i].binding(field);
 }
 
 QVariant QTrackerResult::value(int field) const
@@ -298,21 +759,31 @@ QVariant QTrackerResult::value(int field) const
     // The upper layer calls this function only when this Result is positioned
     // in a valid position, so we don't need to check that.
     int i = pos();
-    if (field >= d->data[i].count() || field < 0) {
+    if (field >= d->results[i].count() || field < 0) {
         qWarning() << "QTrackerResult::data: column" << field << "out of range";
         return QVariant();
     }
-    return d->data[i][field];
+    return d->results[i].value(field);
 }
 
 void QTrackerResult::waitForFinished()
 {
     if (d->watcher)
-        d->watcher->waitForFinished();
+        d->waitForReply();
+
+    if (d->batched && !d->batchDone) {
+        // Still waiting in the batcher; don't wait for the batch window
+        if (!d->batch && d->driverPrivate->batcher)
+            d->driverPrivate->batcher->flush();
+        if (d->batch)
+            d->batch->waitForFinished();
+    }
 }
 
 bool QTrackerResult::isFinished() const
 {
+    if (d->batched)
+        return d->batchDone;
     if (d->watcher)
         return d->watcher->isFinished();
     return true;
@@ -320,7 +791,7 @@ bool QTrackerResult::isFinished() const
 
 int QTrackerResult::size() const
 {
-    return d->data.count();
+    return d->results.count();
 }
 
 QSparqlResultRow QTrackerResult::current() const
@@ -329,19 +800,10 @@ QSparqlResultRow QTrackerResult::current() const
         return QSparqlResultRow();
     }
 
-    QSparqlResultRow info;
-    if (pos() >= d->data.count() || pos() < 0)
-        return info;
+    if (pos() >= d->results.count() || pos() < 0)
+        return QSparqlResultRow();
 
-    QStringList resultStrings = d->data[pos()];
-    Q_FOREACH (const QString& str, resultStrings) {
-        // This only creates a binding with the values but with empty column
-        // names.
-        // TODO: how to add column names?
-        QSparqlBinding b(QString(), str);
-        info.append(b);
-    }
-    return info;
+    return d->results[pos()];
 }
 
 bool QTrackerResult::hasFeature(QSparqlResult::Feature feature) const
@@ -377,6 +839,15 @@ void QTrackerResult::exec(const QSparqlQueryOptions& options)
             fireAndForget = true;
         }
 
+        if (d->driverPrivate->batcher) {
+            // Fire-and-forget updates join the batch too, but nobody is
+            // waiting for their completion
+            d->batched = !fireAndForget;
+            d->driverPrivate->batcher->enqueue(query(), d->prefixes,
+                                               fireAndForget ? 0 : d);
+            return;
+        }
+
         if (d->driverPrivate->doBatch || options.priority() == QSparqlQueryOptions::LowPriority) {
             funcToCall = QString::fromLatin1("BatchSparqlUpdate");
         }
@@ -392,6 +863,33 @@ void QTrackerResult::exec(const QSparqlQueryOptions& options)
         qWarning() << "QTrackerResult:" << lastError() << query();
         return;
     }
+
+    // The queued updates go first, so that the query sees them
+    if (d->driverPrivate->batcher)
+        d->driverPrivate->batcher->flush();
+
+#ifdef QT_SPARQL_TRACKER_STEROIDS
+    if (funcToCall == QLatin1String("SparqlQuery") && d->driverPrivate->steroidsIface) {
+        // Tracker writes the typed results into a pipe we give it, and
+        // replies with the variable names
+        int fds[2];
+        if (::pipe(fds) == 0) {
+            QDBusPendingCall call = d->driverPrivate->steroidsIface->asyncCall(
+                        QString::fromLatin1("Query"), QVariant(query()),
+                        QVariant::fromValue(QDBusUnixFileDescriptor(fds[1])));
+            // QDBusUnixFileDescriptor made its own copy of the write end
+            ::close(fds[1]);
+            d->setPipe(fds[0]);
+            d->setCall(call);
+            return;
+        }
+        setLastError(QSparqlError(
+                QLatin1String("Unable to create a pipe for the results"),
+                QSparqlError::BackendError));
+        qWarning() << "QTrackerResult:" << lastError() << query();
+        return;
+    }
+#endif
     QDBusPendingCall call = d->driverPrivate->iface->asyncCall(funcToCall,
                                                 QVariant(query()));
     // if it's an insert or delete, and fireAndForget was set to true, don't
@@ -411,17 +909,21 @@ void QTrackerResult::driverClosing()
     }
     delete d->watcher;
     d->watcher = 0;
+    d->closePipe();
+    d->batchDone = true;
     qWarning() << "QTrackerResult: QSparqlConnection closed before QSparqlResult with query:" << query();
 }
 
 QTrackerDriverPrivate::QTrackerDriverPrivate()
-    : iface(0),  doBatch(false)
+    : iface(0), steroidsIface(0), batcher(0), doBatch(false)
 {
 }
 
 QTrackerDriverPrivate::~QTrackerDriverPrivate()
 {
+    delete batcher;
     delete iface;
+    delete steroidsIface;
 }
 
 QTrackerDriver::QTrackerDriver(QObject* parent)
@@ -460,6 +962,7 @@ bool QTrackerDriver::hasFeature(QSparqlConnection::Feature f) const
         return true;
     case QSparqlConnection::ConstructQueries:
     case QSparqlConnection::SyncExec:
+    case QSparqlConnection::GraphUpload:
         return false;
     default:
         return false;
@@ -484,10 +987,33 @@ bool QTrackerDriver::open(const QSparqlConnectionOptions& options)
 
     if (isOpen())
         close();
+
+    // Updates issued within batchWindow milliseconds are sent to Tracker
+    // with one BatchSparqlUpdate call and one BatchCommit
+    int batchWindow = options.option(QString::fromLatin1("batchWindow")).toInt();
+    delete d->batcher;
+    d->batcher = 0;
+    if (batchWindow > 0)
+        d->batcher = new QTrackerUpdateBatcher(d, batchWindow);
+
     d->iface = new QDBusInterface(service, resourcesPath,
                                   resourcesInterface,
                                   QDBusConnection::sessionBus());
     if (d->iface->isValid()) {
+#ifdef QT_SPARQL_TRACKER_STEROIDS
+        // Use the Steroids interface for reading results when the bus can
+        // pass file descriptors. It gives us the variable names and the type
+        // of each value, so the values can be converted here once.
+        QDBusConnection bus = QDBusConnection::sessionBus();
+        if (bus.connectionCapabilities() & QDBusConnection::UnixFileDescriptorPassing) {
+            d->steroidsIface = new QDBusInterface(service, steroidsPath,
+                                                  steroidsInterface, bus);
+            if (!d->steroidsIface->isValid()) {
+                delete d->steroidsIface;
+                d->steroidsIface = 0;
+            }
+        }
+#endif
         setOpen(true);
         setOpenError(false);
 
@@ -508,14 +1034,27 @@ bool QTrackerDriver::open(const QSparqlConnectionOptions& options)
 void QTrackerDriver::close()
 {
     if (isOpen()) {
+        // Queued updates are sent so that they're not lost, but the results
+        // won't learn about their completion any more
+        flush();
         Q_EMIT closing();
+        delete d->batcher;
+        d->batcher = 0;
         delete d->iface;
         d->iface = 0;
+        delete d->steroidsIface;
+        d->steroidsIface = 0;
         setOpen(false);
         setOpenError(false);
     }
 }
 
+void QTrackerDriver::flush()
+{
+    if (d->batcher)
+        d->batcher->flush();
+}
+
 QTrackerResult* QTrackerDriver::exec(const QString& query,
                           QSparqlQuery::StatementType type,
                           const QSparqlQueryOptions& options)
@@ -107,6 +107,7 @@ public:
     bool hasError() const;
     bool open(const QSparqlConnectionOptions& options);
     void close();
+    void flush();
     QTrackerResult* exec(const QString& query,
                          QSparqlQuery::StatementType type,
                          const QSparqlQueryOptions& options);
@@ -347,6 +347,7 @@ bool QTrackerDirectDriver::hasFeature(QSparqlConnection::Feature f) const
         return true;
     case QSparqlConnection::ConstructQueries:
     case QSparqlConnection::AsyncExec:
+    case QSparqlConnection::GraphUpload:
         return false;
     default:
         return false;
@@ -329,11 +329,13 @@ QSparqlResultRow QTrackerDirectSelectResult::current() const
     if (columnNames.size() != results[pos()].size())
         return QSparqlResultRow();
 
-    QSparqlResultRow resultRow;
+    QSparqlResultRow resultRow(schema);
     for (int i = 0; i < results[pos()].size(); ++i) {
         QSparqlBinding b(columnNames[i], results[pos()][i]);
         resultRow.append(b);
     }
+    if (schema.isEmpty())
+        schema = resultRow.schema();
     return resultRow;
 }
 
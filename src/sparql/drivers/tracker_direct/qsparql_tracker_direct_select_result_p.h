@@ -92,6 +92,8 @@ private:
     TrackerSparqlCursor* cursor;
     mutable QMutex resultMutex;
     QVector<QString> columnNames;
+    // The rows returned by current() share the column names
+    mutable QSparqlResultRowSchema schema;
     QList<QVector<QVariant> > results;
 };
 
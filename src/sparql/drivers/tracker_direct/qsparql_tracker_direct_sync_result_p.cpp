@@ -214,7 +214,7 @@ QSparqlResultRow QTrackerDirectSyncResult::current() const
     if (!cursor || pos() == QSparql::BeforeFirstRow || pos() == QSparql::AfterLastRow)
         return QSparqlResultRow();
 
-    QSparqlResultRow resultRow;
+    QSparqlResultRow resultRow(schema);
     // get the no. of columns only once; it won't change between rows
     if (n_columns < 0)
         n_columns = tracker_sparql_cursor_get_n_columns(cursor);
@@ -222,6 +222,8 @@ QSparqlResultRow QTrackerDirectSyncResult::current() const
     for (int i = 0; i < n_columns; i++) {
         resultRow.append(binding(i));
     }
+    if (schema.isEmpty())
+        schema = resultRow.schema();
     return resultRow;
 }
 
@@ -80,6 +80,7 @@ public Q_SLOTS:
 private:
     TrackerSparqlCursor* cursor;
     mutable int n_columns;
+    mutable QSparqlResultRowSchema schema;
     bool isAsync;
 
     Q_INVOKABLE void startFetcher();
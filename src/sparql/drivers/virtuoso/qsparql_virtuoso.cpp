@@ -49,13 +49,21 @@
 #include <QtCore/qdatetime.h>
 #include <QtCore/qstringlist.h>
 #include <QtCore/qvarlengtharray.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qvector.h>
 #include <QtCore/qurl.h>
+#include <QtCore/qiodevice.h>
 
 #include <QtCore/QAtomicInt>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QMutex>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QPointer>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
 #include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
 
 #include <QtSparql/qsparqlerror.h>
 #include <QtSparql/qsparqlbinding.h>
@@ -63,6 +71,7 @@
 #include <QtSparql/qsparqlquery.h>
 #include <QtSparql/qsparqlqueryoptions.h>
 #include <QtSparql/private/qsparqlntriples_p.h>
+#include <QtSparql/private/qsparqlquery_p.h>
 #define XSD_DATE
 #include "../../kernel/qsparqlxsd_p.h"
 
@@ -80,15 +89,123 @@ QT_BEGIN_NAMESPACE
 #endif
 
 static const int COLNAMESIZE = 256;
-
-class QVirtuosoFetcherPrivate : public QThread
+// The size of the pieces the N-Triples of a graph result are read in
+static const int GRAPHCHUNKSIZE = 64 * 1024;
+// The size of the pieces the data of a graph upload is sent in
+static const int UPLOADCHUNKSIZE = 64 * 1024;
+
+// Runs an async query on one of the driver's pooled threads. The semaphore is
+// held while the fetcher is queued or running. waitForFinished() takes a
+// fetcher which is still in the queue of the pool out of it and runs it in
+// its own thread (Qt 5.9 and later); otherwise it waits for the pooled
+// thread to finish with it.
+class QVirtuosoFetcherPrivate : public QRunnable
 {
 public:
-    QVirtuosoFetcherPrivate(QVirtuosoAsyncResult *res) : result(res) { }
+    QVirtuosoFetcherPrivate(QVirtuosoAsyncResult *res, int priority)
+        : result(res), priority(priority), runSemaphore(1), runFinished(false),
+          queued(false), started(false), orphaned(false)
+    {
+        setAutoDelete(false);
+    }
+
+    void runOrWait()
+    {
+        if (runSemaphore.tryAcquire(1)) {
+            if (!runFinished)
+                run();
+            else
+                runSemaphore.release(1);
+        } else {
+            wait();
+        }
+    }
+
+    // Runs a fetcher which is still in the queue of the pool in the calling
+    // thread instead of waiting behind the queries running in the pool
+    void runOrWait(QThreadPool& threadPool)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+        QMutexLocker stateLocker(&stateMutex);
+        if (queued && !started && threadPool.tryTake(this)) {
+            // The semaphore taken by queue() is released by run()
+            queued = false;
+            stateLocker.unlock();
+            run();
+            return;
+        }
+        stateLocker.unlock();
+#else
+        Q_UNUSED(threadPool);
+#endif
+        runOrWait();
+    }
+
+    void queue(QThreadPool& threadPool)
+    {
+        // QSparqlQueryPriority's are the wrong way round for
+        // the thread pool, so just * -1 to get the correct
+        // number
+        if (runSemaphore.tryAcquire(1)) {
+            QMutexLocker stateLocker(&stateMutex);
+            queued = true;
+            threadPool.start(this, priority * -1);
+        }
+    }
+
+    // Called when the result is deleted. A fetcher still waiting in the
+    // queue of the pool is taken out of it instead of waited for; returns
+    // false if it can't be, and then it deletes itself when it's run.
+    bool cancel(QThreadPool& threadPool)
+    {
+        QMutexLocker stateLocker(&stateMutex);
+        if (queued && !started) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+            if (threadPool.tryTake(this))
+                return true;
+#else
+            Q_UNUSED(threadPool);
+#endif
+            orphaned = true;
+            return false;
+        }
+        stateLocker.unlock();
+        wait();
+        return true;
+    }
+
+    void wait()
+    {
+        runSemaphore.acquire(1);
+        runSemaphore.release(1);
+    }
 
     void run()
     {
-        if (result->runQuery()) {
+        {
+            QMutexLocker stateLocker(&stateMutex);
+            if (orphaned) {
+                stateLocker.unlock();
+                delete this;
+                return;
+            }
+            started = true;
+        }
+        // The result is marked finished when it is deleted before the
+        // fetcher was picked up from the queue
+        if (!runFinished && !result->isFinished())
+            fetch();
+        runFinished = true;
+        runSemaphore.release(1);
+    }
+
+private:
+    void fetch()
+    {
+        if (result->isUpload()) {
+            if (result->runUpload())
+                result->terminate();
+        } else if (result->runQuery()) {
             if (result->isTable()) {
                 while (!result->isFinished() && result->fetchNextResult()) {
                     ;
@@ -101,20 +218,76 @@ public:
                 result->terminate();
             }
         }
+        result->releaseConnection();
     }
 
-private:
     QVirtuosoAsyncResult *result;
+    int priority;
+    QSemaphore runSemaphore;
+    bool runFinished;
+
+    QMutex stateMutex;
+    bool queued;
+    bool started;
+    // The result was deleted while this was in the queue of the pool
+    bool orphaned;
+};
+
+struct QVirtuosoPooledConnection
+{
+    SQLHANDLE hDbc;
+    QElapsedTimer idle;
 };
 
+struct QVirtuosoCachedStatement
+{
+    SQLHANDLE hstmt;
+    qint64 lastUse;
+};
+
+// The prepared statements of one connection, by query text. The handles are
+// freed by SQLDisconnect, so the cache is dropped when disconnectCount has
+// changed. The least recently used statement is evicted when the cache is
+// full; a statement is taken out of the cache while a result is using it,
+// and put back as the most recently used one.
+struct QVirtuosoStatementCache
+{
+    QVirtuosoStatementCache() : disconnectCount(0), uses(0) { }
+    int disconnectCount;
+    QHash<QByteArray, QVirtuosoCachedStatement> statements;
+    // The queries of the statements by their lastUse, the oldest first
+    QMap<qint64, QByteArray> recentlyUsed;
+    qint64 uses;
+};
+
+class QVirtuosoDriverConnectionOpen;
+
 class QVirtuosoDriverPrivate
 {
 public:
-    QVirtuosoDriverPrivate()
-    : hEnv(0), hDbc(0), disconnectCount(0), mutex(QMutex::Recursive)
+    QVirtuosoDriverPrivate(QVirtuosoDriver *driver)
+    : hEnv(0), hDbc(0), disconnectCount(0), mutex(QMutex::Recursive),
+      pooledConnections(0), minConnections(1), maxConnections(1),
+      connectionIdleTimeout(60000), statementCacheSize(32),
+      rowArraySize(256), blockCursors(false), inTransaction(false), driver(driver),
+      connectionOpener(0), asyncOpenCalled(false), connectTime(-1)
     {
     }
 
+    bool openConnections();
+    void onConnectionOpen(QObject* object, const char* method, const char* slot);
+    void waitForConnectionOpen();
+    SQLHANDLE waitForOpenConnection(QString *error);
+    SQLHANDLE connect(QString *error);
+    void disconnect(SQLHANDLE hDbc);
+    SQLHANDLE acquireConnection(QString *error, bool primary = false);
+    void releaseConnection(SQLHANDLE hDbc);
+    QList<SQLHANDLE> takeExpiredConnections();
+    void drainPool();
+    SQLHANDLE takeStatement(SQLHANDLE hDbc, const QByteArray& query);
+    void cacheStatement(SQLHANDLE hDbc, const QByteArray& query, SQLHANDLE hstmt);
+    void finishTransactionResults();
+
     SQLHANDLE hEnv;
     SQLHANDLE hDbc;
 
@@ -123,13 +296,120 @@ public:
     // is using the connection to make odbc queries
     QMutex mutex;
     int dataReadyInterval;
+
+    // The async results check out a connection of their own from this pool,
+    // so that they run in parallel against the server. hDbc is used for the
+    // sync results and the transactions.
+    QByteArray connectString;
+    QMutex poolMutex;
+    QWaitCondition connectionReleased;
+    QList<QVirtuosoPooledConnection> idleConnections;
+    int pooledConnections;
+    int minConnections;
+    int maxConnections;
+    int connectionIdleTimeout;
+
+    // Guarded by poolMutex; the statements of a connection are only used by
+    // the result which has checked out the connection
+    QHash<SQLHANDLE, QVirtuosoStatementCache> statementCaches;
+    int statementCacheSize;
+
+    // The number of rows the async results fetch with one SQLFetch, when
+    // the ODBC driver can SQLGetData() from a block cursor
+    int rowArraySize;
+    bool blockCursors;
+    // The async results are fetched by a bounded set of reusable threads
+    // instead of one new thread per result
+    QThreadPool threadPool;
+
+    // While a transaction is active, the async results run on hDbc, which
+    // has autocommit disabled, one at a time; they are finished before the
+    // transaction is committed or rolled back. Guarded by poolMutex.
+    bool inTransaction;
+    QList<QPointer<QVirtuosoAsyncResult> > transactionResults;
+
+    // The connections are opened in the thread pool, so that open() doesn't
+    // block on the server. The queries issued meanwhile are started when
+    // the opened() signal is emitted. openMutex guards connectionOpener and
+    // asyncOpenCalled; it isn't the connection mutex, which a transaction
+    // query holds for as long as it fetches.
+    QVirtuosoDriver *driver;
+    QMutex openMutex;
+    QVirtuosoDriverConnectionOpen *connectionOpener;
+    bool asyncOpenCalled;
+    QString openError;
+    QElapsedTimer connectTimer;
+    // Milliseconds from open() until the connections were up, -1 before
+    // that; guarded by poolMutex
+    qint64 connectTime;
+};
+
+class QVirtuosoDriverConnectionOpen : public QRunnable
+{
+public:
+    QVirtuosoDriverConnectionOpen(QVirtuosoDriverPrivate *d)
+        : d(d), runSemaphore(1), runFinished(false)
+    {
+        setAutoDelete(false);
+    }
+
+    void runOrWait()
+    {
+        if (acquireRunSemaphore())
+        {
+            if (!runFinished)
+                run();
+            else
+                runSemaphore.release(1);
+        }
+        else
+            wait();
+    }
+
+    void queue(QThreadPool& threadPool)
+    {
+        if (acquireRunSemaphore())
+            threadPool.start(this);
+    }
+
+    void wait()
+    {
+        runSemaphore.acquire(1);
+        runSemaphore.release(1);
+    }
+
+    bool isFinished() const
+    {
+        return runFinished;
+    }
+
+private:
+    QVirtuosoDriverPrivate *d;
+    QSemaphore runSemaphore;
+    bool runFinished;
+
+    void run()
+    {
+        if (!runFinished) {
+            d->openConnections();
+            runFinished = true;
+            QMetaObject::invokeMethod(d->driver, "asyncOpenComplete", Qt::QueuedConnection);
+        }
+        runSemaphore.release(1);
+    }
+
+    bool acquireRunSemaphore()
+    {
+        return runSemaphore.tryAcquire(1);
+    }
 };
 
 class QVirtuosoResultPrivate
 {
 public:
     QVirtuosoResultPrivate(const QVirtuosoDriver* d, QVirtuosoDriverPrivate *dpp) :
-        driver(d), hstmt(0), numResultCols(0), hdesc(0),
+        driver(d), hDbc(0), hstmt(0), numResultCols(0), hdesc(0),
+        prepared(false), statementPrepared(false),
         resultColIdx(0), driverPrivate(dpp)
     {
     }
@@ -139,23 +419,41 @@ public:
     }
 
     SQLHANDLE dpEnv() const { return driverPrivate ? driverPrivate->hEnv : 0;}
-    SQLHANDLE dpDbc() const { return driverPrivate ? driverPrivate->hDbc : 0;}
+    SQLHANDLE dpDbc() const
+    {
+        if (hDbc)
+            return hDbc;
+        return driverPrivate ? driverPrivate->hDbc : 0;
+    }
 
     inline void clearValues()
     {
-        QSparqlResultRow resultRow;
+        // The rows share the column names of the first one
+        if (schema.isEmpty() && !results.isEmpty())
+            schema = results.last().schema();
+        QSparqlResultRow resultRow(schema);
         results.append(resultRow);
         resultColIdx = 0;
     }
 
     const QVirtuosoDriver* driver;
+    // The pooled connection of an async result while it is running
+    SQLHANDLE hDbc;
     SQLHANDLE hstmt;
     SQLSMALLINT numResultCols;
     SQLHDESC hdesc;
 
     QByteArray query;
+    // Set for the results executed with SQLPrepare(); the parameters are
+    // bound to the ?? markers of the query
+    bool prepared;
+    bool statementPrepared;
+    QList<QByteArray> parameters;
+    QVector<QSQLLEN> parameterLengths;
     QStringList bindingNames;
+    QVector<QSQLULEN> columnSizes;
 	QVector<QSparqlResultRow> results;
+    QSparqlResultRowSchema schema;
     int resultColIdx;
     int disconnectCount;
     QVirtuosoDriverPrivate *driverPrivate;
@@ -165,12 +463,28 @@ public:
     void updateStmtHandleState() { disconnectCount = driver->d->disconnectCount; }
 };
 
+// Column-wise bound buffers for fetching a block of rows with one SQLFetch.
+// The buffers are reused for every block, and a column's buffer grows when a
+// value didn't fit in it.
+struct QVirtuosoRowArray
+{
+    QVirtuosoRowArray() : size(1), rowsFetched(0) { }
+
+    int size;
+    QSQLULEN rowsFetched;
+    QVector<SQLUSMALLINT> rowStatus;
+    QVector<int> widths;
+    QVector<QByteArray> buffers;
+    QVector<QVector<QSQLLEN> > indicators;
+};
+
 class QVirtuosoAsyncResultPrivate : public QVirtuosoResultPrivate
 {
 public:
     QVirtuosoAsyncResultPrivate(const QVirtuosoDriver* d, QVirtuosoDriverPrivate *dpp, QVirtuosoFetcherPrivate *f) :
         QVirtuosoResultPrivate(d, dpp),
-        fetcher(f), fetcherStarted(false), mutex(QMutex::Recursive)
+        fetcher(f), fetcherStarted(false), inTransaction(false), reportedCount(0),
+        uploadData(0), uploadReplace(false), mutex(QMutex::Recursive)
     {
     }
 
@@ -180,6 +494,17 @@ public:
 
     QVirtuosoFetcherPrivate *fetcher;
     bool fetcherStarted;
+    // Run on the connection of the transaction the query was made in
+    bool inTransaction;
+    QVirtuosoRowArray rowArray;
+    // The count of the last dataReady signal
+    int reportedCount;
+    // Set for the results of QVirtuosoDriver::uploadGraph(); the data is
+    // passed to the loader procedure in pieces with SQLPutData()
+    QIODevice *uploadData;
+    QByteArray uploadLoader;
+    QUrl uploadGraph;
+    bool uploadReplace;
     // This mutex is for ensuring that only one thread at a time
     // is accessing the results array
     QMutex mutex;
@@ -260,25 +585,348 @@ static QSparqlError qMakeError(const QString& err, QSparqlError::ErrorType type,
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+
+bool QVirtuosoDriverPrivate::openConnections()
+{
+    QString error;
+    SQLHANDLE dbc = connect(&error);
+    {
+        // Read by the async results in the other threads of the pool
+        QMutexLocker connectionLocker(&mutex);
+        hDbc = dbc;
+        openError = error;
+    }
+    if (!hDbc)
+        return false;
+
+    // The values which don't fit in the bound buffers, and the descriptor
+    // fields of a value, are read from the rows of the block
+    SQLUINTEGER getDataExtensions = 0;
+    SQLRETURN r = SQLGetInfo(hDbc, SQL_GETDATA_EXTENSIONS, &getDataExtensions, sizeof(getDataExtensions), 0);
+    blockCursors = (r == SQL_SUCCESS || r == SQL_SUCCESS_WITH_INFO)
+            && (getDataExtensions & SQL_GD_BOUND) && (getDataExtensions & SQL_GD_BLOCK);
+
+    for (int i = 0; i < minConnections; ++i) {
+        QString error;
+        SQLHANDLE dbc = connect(&error);
+        if (!dbc) {
+            qWarning() << "QVirtuosoDriver::open: Unable to open pooled connection:" << error;
+            break;
+        }
+        QMutexLocker poolLocker(&poolMutex);
+        ++pooledConnections;
+        poolLocker.unlock();
+        releaseConnection(dbc);
+    }
+
+    QMutexLocker poolLocker(&poolMutex);
+    connectTime = connectTimer.elapsed();
+    return true;
+}
+
+void QVirtuosoDriverPrivate::onConnectionOpen(QObject* object, const char* method, const char* slot)
+{
+    QMutexLocker openLocker(&openMutex);
+    if (!connectionOpener || asyncOpenCalled)
+        QMetaObject::invokeMethod(object, method, Qt::QueuedConnection);
+    else
+        QObject::connect(driver, SIGNAL(opened()), object, slot, Qt::UniqueConnection);
+}
+
+// Only called in the thread of the driver, which is the one setting the
+// open state of the driver and emitting opened()
+void QVirtuosoDriverPrivate::waitForConnectionOpen()
+{
+    if (connectionOpener) {
+        connectionOpener->runOrWait();
+        driver->asyncOpenComplete();
+    }
+}
+
+// Called by the async results in the thread pool; the driver is told about
+// the open by the queued asyncOpenComplete() of the opener
+SQLHANDLE QVirtuosoDriverPrivate::waitForOpenConnection(QString *error)
+{
+    QMutexLocker openLocker(&openMutex);
+    QVirtuosoDriverConnectionOpen *opener = connectionOpener;
+    openLocker.unlock();
+    if (opener)
+        opener->runOrWait();
+    QMutexLocker connectionLocker(&mutex);
+    if (!hDbc)
+        *error = openError.isEmpty() ? QLatin1String("QVirtuoso: Connection not open") : openError;
+    return hDbc;
+}
+
+SQLHANDLE QVirtuosoDriverPrivate::connect(QString *error)
+{
+    SQLHANDLE dbc = 0;
+    SQLRETURN r = SQLAllocHandle(SQL_HANDLE_DBC, hEnv, &dbc);
+    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
+        *error = QLatin1String("QVirtuoso: Unable to allocate connection ")
+                 + qWarnODBCHandle(SQL_HANDLE_ENV, hEnv);
+        return 0;
+    }
+
+    SQLSMALLINT cb;
+    SQLTCHAR connectionOut[4097];
+    connectionOut[4096] = 0;
+
+    r = SQLDriverConnect(dbc, 0, (UCHAR*) connectString.data(), SQL_NTS,
+                         connectionOut, 4096, &cb, SQL_DRIVER_COMPLETE);
+    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
+        *error = QLatin1String("QVirtuoso: Unable to connect ")
+                 + qWarnODBCHandle(SQL_HANDLE_DBC, dbc);
+        SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+        return 0;
+    }
+    return dbc;
+}
+
+void QVirtuosoDriverPrivate::disconnect(SQLHANDLE dbc)
+{
+    // Open statements/descriptors handles are automatically cleaned up by SQLDisconnect
+    SQLRETURN r = SQLDisconnect(dbc);
+    if (r != SQL_SUCCESS)
+        qWarning() << "QVirtuosoDriver: Unable to disconnect pooled connection\tError:"
+                   << qWarnODBCHandle(SQL_HANDLE_DBC, dbc);
+    r = SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+    if (r != SQL_SUCCESS)
+        qWarning() << "QVirtuosoDriver: Unable to free pooled connection handle";
+}
+
+// Called with poolMutex held. The connections which have been idle for longer
+// than the timeout are removed from the pool, but not below the minimum size.
+// The oldest ones are at the front of the list.
+QList<SQLHANDLE> QVirtuosoDriverPrivate::takeExpiredConnections()
+{
+    QList<SQLHANDLE> expired;
+    while (!idleConnections.isEmpty() && pooledConnections > minConnections
+           && connectionIdleTimeout >= 0
+           && idleConnections.first().idle.hasExpired(connectionIdleTimeout)) {
+        expired.append(idleConnections.takeFirst().hDbc);
+        statementCaches.remove(expired.last());
+        --pooledConnections;
+    }
+    return expired;
+}
+
+SQLHANDLE QVirtuosoDriverPrivate::acquireConnection(QString *error, bool primary)
+{
+    // A driver created from existing handles can't open connections of its
+    // own, so its queries share the one connection, one at a time
+    if (primary || connectString.isEmpty()) {
+        mutex.lock();
+        if (!hDbc) {
+            mutex.unlock();
+            *error = QLatin1String("QVirtuoso: Connection not open");
+        }
+        return hDbc;
+    }
+
+    QMutexLocker poolLocker(&poolMutex);
+    QList<SQLHANDLE> expired = takeExpiredConnections();
+    SQLHANDLE dbc = 0;
+    forever {
+        if (!idleConnections.isEmpty()) {
+            // Reuse the most recently released connection, so that the
+            // others can expire
+            dbc = idleConnections.takeLast().hDbc;
+            break;
+        }
+        if (pooledConnections < maxConnections) {
+            ++pooledConnections;
+            poolLocker.unlock();
+            dbc = connect(error);
+            if (!dbc) {
+                poolLocker.relock();
+                --pooledConnections;
+                connectionReleased.wakeOne();
+            }
+            break;
+        }
+        connectionReleased.wait(&poolMutex);
+    }
+    poolLocker.unlock();
+
+    foreach (SQLHANDLE old, expired)
+        disconnect(old);
+    return dbc;
+}
+
+void QVirtuosoDriverPrivate::releaseConnection(SQLHANDLE dbc)
+{
+    if (dbc == hDbc) {
+        mutex.unlock();
+        return;
+    }
+
+    QMutexLocker poolLocker(&poolMutex);
+    QVirtuosoPooledConnection connection;
+    connection.hDbc = dbc;
+    connection.idle.start();
+    idleConnections.append(connection);
+    QList<SQLHANDLE> expired = takeExpiredConnections();
+    connectionReleased.wakeOne();
+    poolLocker.unlock();
+
+    foreach (SQLHANDLE old, expired)
+        disconnect(old);
+}
+
+void QVirtuosoDriverPrivate::drainPool()
+{
+    QMutexLocker poolLocker(&poolMutex);
+    QList<QVirtuosoPooledConnection> idle = idleConnections;
+    idleConnections.clear();
+    statementCaches.clear();
+    pooledConnections -= idle.count();
+    poolLocker.unlock();
+
+    foreach (const QVirtuosoPooledConnection& connection, idle)
+        disconnect(connection.hDbc);
+}
+
+SQLHANDLE QVirtuosoDriverPrivate::takeStatement(SQLHANDLE dbc, const QByteArray& query)
+{
+    QMutexLocker poolLocker(&poolMutex);
+    QHash<SQLHANDLE, QVirtuosoStatementCache>::iterator it = statementCaches.find(dbc);
+    if (it == statementCaches.end())
+        return 0;
+    if (it->disconnectCount != disconnectCount) {
+        statementCaches.erase(it);
+        return 0;
+    }
+    QHash<QByteArray, QVirtuosoCachedStatement>::iterator cached = it->statements.find(query);
+    if (cached == it->statements.end())
+        return 0;
+    const SQLHANDLE hstmt = cached->hstmt;
+    it->recentlyUsed.remove(cached->lastUse);
+    it->statements.erase(cached);
+    return hstmt;
+}
+
+void QVirtuosoDriverPrivate::cacheStatement(SQLHANDLE dbc, const QByteArray& query, SQLHANDLE hstmt)
+{
+    QMutexLocker poolLocker(&poolMutex);
+    QVirtuosoStatementCache& cache = statementCaches[dbc];
+    if (cache.disconnectCount != disconnectCount) {
+        cache.statements.clear();
+        cache.recentlyUsed.clear();
+        cache.disconnectCount = disconnectCount;
+    }
+
+    QList<SQLHANDLE> evicted;
+    QHash<QByteArray, QVirtuosoCachedStatement>::iterator cached = cache.statements.find(query);
+    if (cached != cache.statements.end()) {
+        // Another result had prepared the same query meanwhile
+        evicted.append(hstmt);
+        cache.recentlyUsed.remove(cached->lastUse);
+        cached->lastUse = ++cache.uses;
+        cache.recentlyUsed.insert(cached->lastUse, query);
+    } else if (statementCacheSize <= 0) {
+        evicted.append(hstmt);
+    } else {
+        while (cache.statements.count() >= statementCacheSize) {
+            QMap<qint64, QByteArray>::iterator oldest = cache.recentlyUsed.begin();
+            evicted.append(cache.statements.take(oldest.value()).hstmt);
+            cache.recentlyUsed.erase(oldest);
+        }
+        QVirtuosoCachedStatement statement;
+        statement.hstmt = hstmt;
+        statement.lastUse = ++cache.uses;
+        cache.statements.insert(query, statement);
+        cache.recentlyUsed.insert(statement.lastUse, query);
+    }
+    poolLocker.unlock();
+
+    foreach (SQLHANDLE statement, evicted)
+        SQLFreeHandle(SQL_HANDLE_STMT, statement);
+}
+
+void QVirtuosoDriverPrivate::finishTransactionResults()
+{
+    QMutexLocker poolLocker(&poolMutex);
+    QList<QPointer<QVirtuosoAsyncResult> > results = transactionResults;
+    transactionResults.clear();
+    poolLocker.unlock();
+
+    foreach (const QPointer<QVirtuosoAsyncResult>& result, results) {
+        if (result)
+            result->waitForFinished();
+    }
+}
+
+// Parameters are passed to Virtuoso as strings; the casts make the server
+// see them as the same typed literals the query text would contain
+static QString qVirtuosoParameterMarker(const QSparqlBinding& value)
+{
+    static const char* const casts[] = {
+        "integer", "int", "long", "unsignedInt", "unsignedLong", "decimal",
+        "double", "float", "boolean", "date", "time", "dateTime", 0
+    };
+
+    if (value.isUri())
+        return QLatin1String("`iri(??)`");
+    // Blank nodes and language tagged literals are inserted in the query
+    if (!value.isLiteral() || !value.languageTag().isEmpty())
+        return QString();
+
+    const QString dataType = value.dataTypeUri().toString();
+    const QLatin1String xsd("http://www.w3.org/2001/XMLSchema#");
+    if (dataType == xsd + QLatin1String("string"))
+        return QLatin1String("??");
+    for (int i = 0; casts[i]; ++i) {
+        if (dataType == xsd + QLatin1String(casts[i]))
+            return QString::fromLatin1("`<%1>(??)`").arg(dataType);
+    }
+    return QString();
+}
+
+static QByteArray qVirtuosoParameterValue(const QSparqlBinding& binding)
+{
+    const QVariant value = binding.value();
+    switch (value.type()) {
+    case QVariant::Url:
+        return value.toUrl().toString().toUtf8();
+    case QVariant::Bool:
+        return value.toBool() ? "true" : "false";
+    case QVariant::Date:
+        return value.toDate().toString(Qt::ISODate).toLatin1();
+    case QVariant::Time:
+        return value.toTime().toString(Qt::ISODate).toLatin1();
+    case QVariant::DateTime:
+        return value.toDateTime().toString(Qt::ISODate).toLatin1();
+    default:
+        return value.toString().toUtf8();
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////
 
 QVirtuosoAsyncResult::QVirtuosoAsyncResult(const QVirtuosoDriver * db, QVirtuosoDriverPrivate* p,
                                 const QString& query, QSparqlQuery::StatementType type,
-                                const QString& prefixes)
+                                const QString& prefixes, const QSparqlQueryOptions& options)
 : QVirtuosoResult(db, p, query, type, prefixes)
 {
-    da = new QVirtuosoAsyncResultPrivate(db, p, new QVirtuosoFetcherPrivate(this));
+    da = new QVirtuosoAsyncResultPrivate(db, p, new QVirtuosoFetcherPrivate(this, options.priority()));
+
+    QMutexLocker poolLocker(&(p->poolMutex));
+    if (p->inTransaction) {
+        da->inTransaction = true;
+        p->transactionResults.append(this);
+    }
 }
 
 QVirtuosoAsyncResult::~QVirtuosoAsyncResult()
 {
-    QMutexLocker connectionLocker(&(d->driverPrivate->mutex));
-
-	if (da->fetcher->isRunning()) {
-		d->isFinished = 1;
-		da->fetcher->wait();
-	}
-    delete da->fetcher;
+    // Stop the fetcher between two rows, and wait for it without holding
+    // the connection mutex, which the fetcher needs for every row. A
+    // fetcher which hasn't been started isn't waited for.
+    d->isFinished = 1;
+    if (da->fetcher->cancel(d->driverPrivate->threadPool))
+        delete da->fetcher;
     delete da;
 }
 
@@ -288,7 +936,7 @@ QVirtuosoResult* QVirtuosoDriver::exec(const QString& query, QSparqlQuery::State
 
     switch (options.executionMethod()) {
     case QSparqlQueryOptions::AsyncExec:
-        result = asyncExec(query, type);
+        result = asyncExec(query, type, options);
         break;
     case QSparqlQueryOptions::SyncExec:
         result = syncExec(query, type);
@@ -298,35 +946,368 @@ QVirtuosoResult* QVirtuosoDriver::exec(const QString& query, QSparqlQuery::State
     return result;
 }
 
-QVirtuosoAsyncResult* QVirtuosoDriver::asyncExec(const QString& query, QSparqlQuery::StatementType type)
+QVirtuosoResult* QVirtuosoDriver::execPrepared(const QSparqlQuery& query, const QSparqlQueryOptions& options)
+{
+    // The sync results keep their cursor on the shared connection, so only
+    // the async results, which have a pooled connection of their own, reuse
+    // prepared statements
+    if (options.executionMethod() != QSparqlQueryOptions::AsyncExec)
+        return 0;
+
+    QList<QSparqlBinding> parameters;
+    QString text = QSparqlParametrizedQuery::queryText(query, qVirtuosoParameterMarker, &parameters);
+    // A query without bound values is executed directly, so that unique
+    // texts neither pay for a prepare nor push the reused statements out of
+    // the cache
+    if (parameters.isEmpty())
+        return 0;
+
+    QVirtuosoAsyncResult* res = new QVirtuosoAsyncResult(this, d, text, query.type(), prefixes(), options);
+    res->setParameters(parameters, query.preparedQueryText());
+
+    d->onConnectionOpen(res, "startFetcher", SLOT(startFetcher()));
+    return res;
+}
+
+QVirtuosoAsyncResult* QVirtuosoDriver::asyncExec(const QString& query, QSparqlQuery::StatementType type,
+                                                 const QSparqlQueryOptions& options)
 {
-    QVirtuosoAsyncResult* res = new QVirtuosoAsyncResult(this, d, query, type, prefixes());
+    QVirtuosoAsyncResult* res = new QVirtuosoAsyncResult(this, d, query, type, prefixes(), options);
 
     // Queue calling exec() on the result. This way the finished() and
     // dataReady() signals won't be emitted before the user connects to
     // them, and the result won't be in the "finished" state before the
-    // thread that calls this function has entered its event loop.
-    QMetaObject::invokeMethod(res, "startFetcher",  Qt::QueuedConnection);
+    // thread that calls this function has entered its event loop. While
+    // the connection is being opened, the result is started when it's up.
+    d->onConnectionOpen(res, "startFetcher", SLOT(startFetcher()));
+    return res;
+}
+
+// The Virtuoso procedure which loads RDF of the MIME type into a graph. The
+// Turtle loader reads N-Triples too, since they are a subset of Turtle.
+static QByteArray qVirtuosoLoader(const QString& contentType)
+{
+    const QString type = contentType.section(QLatin1Char(';'), 0, 0).trimmed().toLower();
+    if (type == QLatin1String("text/turtle") || type == QLatin1String("application/x-turtle")
+            || type == QLatin1String("application/n-triples") || type == QLatin1String("text/plain"))
+        return QByteArray("DB.DBA.TTLP (?, ?, ?, 0)");
+    if (type == QLatin1String("application/rdf+xml"))
+        return QByteArray("DB.DBA.RDF_LOAD_RDFXML (?, ?, ?)");
+    return QByteArray();
+}
+
+QSparqlResult* QVirtuosoDriver::uploadGraph(QIODevice* data, const QString& contentType, const QUrl& graph,
+                                            QSparqlConnection::GraphUploadMode mode)
+{
+    const QByteArray loader = qVirtuosoLoader(contentType);
+    QVirtuosoAsyncResult* res = new QVirtuosoAsyncResult(this, d, QString::fromLatin1(loader),
+                                                         QSparqlQuery::InsertStatement, QString(),
+                                                         QSparqlQueryOptions());
+    res->setUpload(data, loader, graph, mode == QSparqlConnection::ReplaceGraph);
+
+    // Each upload is run on a pooled connection of its own, so that several
+    // graphs are loaded in parallel
+    d->onConnectionOpen(res, "startFetcher", SLOT(startFetcher()));
     return res;
 }
 
+void QVirtuosoAsyncResult::setUpload(QIODevice* data, const QByteArray& loader, const QUrl& graph, bool replace)
+{
+    da->uploadData = data;
+    da->uploadLoader = loader;
+    da->uploadGraph = graph;
+    da->uploadReplace = replace;
+}
+
+bool QVirtuosoAsyncResult::isUpload() const
+{
+    return da->uploadData != 0;
+}
+
+bool QVirtuosoAsyncResult::runUpload()
+{
+    if (da->uploadLoader.isEmpty()) {
+        setLastError(QSparqlError(QLatin1String("QVirtuoso: Unsupported content type for graph upload"),
+                                  QSparqlError::StatementError));
+        terminate();
+        return false;
+    }
+    if (da->uploadGraph.isEmpty()) {
+        // Virtuoso has no default graph
+        setLastError(QSparqlError(QLatin1String("QVirtuoso: Graph uploads need a graph"),
+                                  QSparqlError::StatementError));
+        terminate();
+        return false;
+    }
+    // The data is read in this thread of the pool. Sockets and processes
+    // can't wait for more data outside their own thread, and running out of
+    // data for now would look like the end of it.
+    if (!da->uploadData->isReadable() || da->uploadData->isSequential()) {
+        setLastError(QSparqlError(QLatin1String("QVirtuoso: Graph uploads need a readable random access device"),
+                                  QSparqlError::StatementError));
+        terminate();
+        return false;
+    }
+
+    QString error;
+    if (d->driverPrivate->waitForOpenConnection(&error))
+        d->hDbc = d->driverPrivate->acquireConnection(&error, da->inTransaction);
+    if (!d->hDbc) {
+        setLastError(QSparqlError(error, QSparqlError::ConnectionError));
+        terminate();
+        return false;
+    }
+
+    // The graph is cleared and loaded in one transaction, unless the upload
+    // is a part of the transaction of the connection
+    const bool replaceInTransaction = da->uploadReplace && !da->inTransaction;
+    if (replaceInTransaction)
+        SQLSetConnectAttr(d->hDbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, SQL_IS_UINTEGER);
+
+    bool ok = putUploadData();
+
+    if (replaceInTransaction) {
+        if (SQLEndTran(SQL_HANDLE_DBC, d->hDbc, ok ? SQL_COMMIT : SQL_ROLLBACK) != SQL_SUCCESS && ok) {
+            setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult", "Unable to commit graph upload"),
+                                    QSparqlError::TransactionError, d));
+            ok = false;
+        }
+        SQLSetConnectAttr(d->hDbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, SQL_IS_UINTEGER);
+    }
+    // A deleted result is finished already
+    if (!ok && !isFinished())
+        terminate();
+    return ok;
+}
+
+bool QVirtuosoAsyncResult::putUploadData()
+{
+    const QByteArray graph = da->uploadGraph.toEncoded();
+    SQLRETURN r;
+
+    if (da->uploadReplace) {
+        QByteArray clear = "SPARQL CLEAR GRAPH <" + graph + ">";
+        SQLHANDLE hstmt = 0;
+        r = SQLAllocHandle(SQL_HANDLE_STMT, d->hDbc, &hstmt);
+        if (r != SQL_SUCCESS) {
+            setLastError(QSparqlError(QLatin1String("QVirtuoso: Unable to allocate statement handle ")
+                                      + qWarnODBCHandle(SQL_HANDLE_DBC, d->hDbc),
+                                      QSparqlError::StatementError));
+            return false;
+        }
+        r = SQLExecDirect(hstmt, (UCHAR*) clear.data(), clear.length());
+        if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO && r != SQL_NO_DATA) {
+            setLastError(QSparqlError(QLatin1String("QVirtuoso: Unable to clear graph ")
+                                      + qWarnODBCHandle(SQL_HANDLE_STMT, hstmt),
+                                      QSparqlError::StatementError));
+            SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+            return false;
+        }
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    }
+
+    r = SQLAllocHandle(SQL_HANDLE_STMT, d->hDbc, &d->hstmt);
+    if (r != SQL_SUCCESS) {
+        setLastError(QSparqlError(QLatin1String("QVirtuoso: Unable to allocate statement handle ")
+                                  + qWarnODBCHandle(SQL_HANDLE_DBC, d->hDbc),
+                                  QSparqlError::StatementError));
+        d->hstmt = 0;
+        return false;
+    }
+    r = SQLPrepare(d->hstmt, (UCHAR*) da->uploadLoader.data(), da->uploadLoader.length());
+    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
+        setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult", "Unable to prepare statement"),
+                                QSparqlError::StatementError, d));
+        return false;
+    }
+
+    // The data is the first parameter, and is sent at execution time; the
+    // graph is both the base IRI and the graph
+    QSQLLEN dataLength = SQL_LEN_DATA_AT_EXEC(0);
+    QSQLLEN graphLength = graph.length();
+    SQLBindParameter(d->hstmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_LONGVARCHAR,
+                     0, 0, (SQLPOINTER) 1, 0, &dataLength);
+    SQLBindParameter(d->hstmt, 2, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+                     graph.length(), 0, (SQLPOINTER) graph.constData(), graph.length(), &graphLength);
+    SQLBindParameter(d->hstmt, 3, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+                     graph.length(), 0, (SQLPOINTER) graph.constData(), graph.length(), &graphLength);
+
+    r = SQLExecute(d->hstmt);
+    if (r == SQL_NEED_DATA) {
+        SQLPOINTER token = 0;
+        r = SQLParamData(d->hstmt, &token);
+        if (r == SQL_NEED_DATA) {
+            const qint64 total = da->uploadData->isSequential() ? -1 : da->uploadData->size();
+            qint64 sent = 0;
+            QByteArray chunk(UPLOADCHUNKSIZE, 0);
+            forever {
+                if (isFinished()) {
+                    // The result has been deleted
+                    SQLCancel(d->hstmt);
+                    return false;
+                }
+                qint64 length = da->uploadData->read(chunk.data(), chunk.size());
+                if (length == 0)
+                    break;
+                if (length < 0) {
+                    // Nothing of the statement is executed, and a replaced
+                    // graph is rolled back by runUpload()
+                    SQLCancel(d->hstmt);
+                    setLastError(QSparqlError(QLatin1String("QVirtuoso: Unable to read graph upload data: ")
+                                              + da->uploadData->errorString(),
+                                              QSparqlError::StatementError));
+                    return false;
+                }
+                r = SQLPutData(d->hstmt, chunk.data(), length);
+                if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO)
+                    break;
+                sent += length;
+                emit uploadProgress(sent, total);
+            }
+            if (sent == 0)
+                r = SQLPutData(d->hstmt, chunk.data(), 0);
+            if (r == SQL_SUCCESS || r == SQL_SUCCESS_WITH_INFO)
+                r = SQLParamData(d->hstmt, &token);
+        }
+    }
+    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO && r != SQL_NO_DATA) {
+        setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult", "Unable to load graph"),
+                                QSparqlError::StatementError, d));
+        return false;
+    }
+    return true;
+}
+
 void QVirtuosoAsyncResult::startFetcher()
 {
     QMutexLocker resultLocker(&(da->mutex));
-    if (!da->fetcherStarted) {
+    if (!da->fetcherStarted && !isFinished()) {
         da->fetcherStarted = true;
-        da->fetcher->start();
+        da->fetcher->queue(d->driverPrivate->threadPool);
     }
 }
 
 bool QVirtuosoAsyncResult::runQuery()
 {
-    QMutexLocker connectionLocker(&(d->driverPrivate->mutex));
-    return QVirtuosoResult::runQuery();
+    QString error;
+    if (!d->driverPrivate->waitForOpenConnection(&error)) {
+        setLastError(QSparqlError(error, QSparqlError::ConnectionError));
+        terminate();
+        return false;
+    }
+
+    d->hDbc = d->driverPrivate->acquireConnection(&error, da->inTransaction);
+    if (!d->hDbc) {
+        setLastError(QSparqlError(error, QSparqlError::ConnectionError));
+        terminate();
+        return false;
+    }
+    if (!QVirtuosoResult::runQuery())
+        return false;
+
+    if (isTable() && !isFinished() && d->numResultCols > 0
+            && d->driverPrivate->blockCursors && d->driverPrivate->rowArraySize > 1) {
+        if (!bindRowArray()) {
+            qSparqlWarning(QLatin1String("QVirtuosoAsyncResult: Unable to bind the row array, fetching row by row"), d);
+            unbindRowArray();
+        }
+    }
+    return true;
+}
+
+static int qInitialColumnWidth(QSQLULEN columnSize)
+{
+    // Room for the terminating 0; untyped columns report no size or a
+    // huge one
+    if (columnSize > 0 && columnSize < 1024)
+        return int(columnSize) + 1;
+    return 256;
+}
+
+bool QVirtuosoAsyncResult::bindRowArray()
+{
+    QVirtuosoRowArray& a = da->rowArray;
+    a.size = d->driverPrivate->rowArraySize;
+    a.rowsFetched = 0;
+    a.rowStatus.resize(a.size);
+    a.widths.resize(d->numResultCols);
+    a.buffers.resize(d->numResultCols);
+    a.indicators.resize(d->numResultCols);
+
+    SQLRETURN r = SQLSetStmtAttr(d->hstmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER) SQL_BIND_BY_COLUMN, 0);
+    if (r != SQL_SUCCESS)
+        return false;
+    r = SQLSetStmtAttr(d->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) (QSQLULEN) a.size, 0);
+    if (r != SQL_SUCCESS)
+        return false;
+    r = SQLSetStmtAttr(d->hstmt, SQL_ATTR_ROW_STATUS_PTR, a.rowStatus.data(), 0);
+    if (r != SQL_SUCCESS)
+        return false;
+    r = SQLSetStmtAttr(d->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &a.rowsFetched, 0);
+    if (r != SQL_SUCCESS)
+        return false;
+
+    for (int i = 0; i < d->numResultCols; ++i) {
+        a.indicators[i].resize(a.size);
+        if (!bindRowArrayColumn(i, qInitialColumnWidth(d->columnSizes.value(i))))
+            return false;
+    }
+    return true;
+}
+
+bool QVirtuosoAsyncResult::bindRowArrayColumn(int column, int width)
+{
+    QVirtuosoRowArray& a = da->rowArray;
+    a.widths[column] = width;
+    a.buffers[column].resize(a.size * width);
+    SQLRETURN r = SQLBindCol(d->hstmt, column + 1, SQL_C_CHAR, a.buffers[column].data(),
+                             width, a.indicators[column].data());
+    return r == SQL_SUCCESS;
+}
+
+void QVirtuosoAsyncResult::unbindRowArray()
+{
+    // The statement may be cached for other results, so its attributes
+    // have to be reset
+    if (da->rowArray.size > 1) {
+        SQLFreeStmt(d->hstmt, SQL_UNBIND);
+        SQLSetStmtAttr(d->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) 1, 0);
+        SQLSetStmtAttr(d->hstmt, SQL_ATTR_ROW_STATUS_PTR, 0, 0);
+        SQLSetStmtAttr(d->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, 0, 0);
+    }
+    da->rowArray = QVirtuosoRowArray();
+}
+
+void QVirtuosoAsyncResult::releaseConnection()
+{
+    if (!d->hDbc)
+        return;
+
+    if (d->hstmt && d->statementPrepared) {
+        // Keep the prepared statement for the next query with the same text
+        unbindRowArray();
+        SQLFreeStmt(d->hstmt, SQL_CLOSE);
+        SQLFreeStmt(d->hstmt, SQL_RESET_PARAMS);
+        d->driverPrivate->cacheStatement(d->hDbc, d->query, d->hstmt);
+        d->hstmt = 0;
+        d->hdesc = 0;
+    } else if (d->hstmt) {
+        SQLRETURN r = SQLFreeHandle(SQL_HANDLE_STMT, d->hstmt);
+        if (r != SQL_SUCCESS)
+            qSparqlWarning(QLatin1String("QVirtuosoAsyncResult: Unable to free statement handle"), d);
+        d->hstmt = 0;
+        d->hdesc = 0;
+    }
+
+    d->driverPrivate->releaseConnection(d->hDbc);
+    d->hDbc = 0;
 }
 
 bool QVirtuosoResult::runQuery()
 {
+    if (d->prepared)
+        return runPreparedQuery();
+
     // Always reallocate the statement handle - the statement attributes
     // are not reset if SQLFreeStmt() is called which causes some problems.
     SQLRETURN r;
@@ -362,6 +1343,73 @@ bool QVirtuosoResult::runQuery()
         return true;
     }
 
+    return describeColumns();
+}
+
+bool QVirtuosoResult::runPreparedQuery()
+{
+    // The prepared statements are not used for anything else, so their
+    // attributes don't need to be reset
+    SQLRETURN r;
+    d->hstmt = d->driverPrivate->takeStatement(d->dpDbc(), d->query);
+    d->statementPrepared = d->hstmt != 0;
+    if (!d->hstmt) {
+        r = SQLAllocHandle(SQL_HANDLE_STMT, d->dpDbc(), &d->hstmt);
+        if (r != SQL_SUCCESS) {
+            qSparqlWarning(QLatin1String("QVirtuosoResult::exec: Unable to allocate statement handle"), d);
+            d->hstmt = 0;
+            terminate();
+            return false;
+        }
+        r = SQLPrepare(d->hstmt, (UCHAR*) d->query.data(), d->query.length());
+        if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
+            setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult", "Unable to prepare statement"),
+                                    QSparqlError::StatementError,
+                                    d));
+            terminate();
+            return false;
+        }
+        d->statementPrepared = true;
+    }
+
+    d->updateStmtHandleState();
+
+    d->parameterLengths.resize(d->parameters.count());
+    for (int i = 0; i < d->parameters.count(); ++i) {
+        QByteArray& value = d->parameters[i];
+        d->parameterLengths[i] = value.length();
+        r = SQLBindParameter(d->hstmt, i + 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+                             qMax(value.length(), 1), 0, value.data(), value.length(),
+                             &d->parameterLengths[i]);
+        if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
+            setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult", "Unable to bind parameter %1").arg(i + 1),
+                                    QSparqlError::StatementError,
+                                    d));
+            terminate();
+            return false;
+        }
+    }
+
+    r = SQLExecute(d->hstmt);
+    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO && r!= SQL_NO_DATA) {
+        setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult", "Unable to execute statement"),
+                                QSparqlError::StatementError,
+                                d));
+        terminate();
+        return false;
+    }
+
+    if (r == SQL_NO_DATA) {
+        terminate();
+        return true;
+    }
+
+    return describeColumns();
+}
+
+bool QVirtuosoResult::describeColumns()
+{
+    SQLRETURN r;
     SQLINTEGER isScrollable, bufferLength;
     r = SQLGetStmtAttr(d->hstmt, SQL_ATTR_CURSOR_SCROLLABLE, &isScrollable, SQL_IS_INTEGER, &bufferLength);
     r = SQLGetStmtAttr(d->hstmt, SQL_ATTR_IMP_ROW_DESC, &(d->hdesc), SQL_IS_POINTER, 0);
@@ -371,7 +1419,8 @@ bool QVirtuosoResult::runQuery()
         for (int i = 0; i < d->numResultCols; ++i) {
             SQLSMALLINT colNameLen;
             SQLTCHAR colName[COLNAMESIZE];
-            r = SQLDescribeCol(d->hstmt, i+1, colName, (SQLSMALLINT)COLNAMESIZE, &colNameLen, 0, 0, 0, 0);
+            QSQLULEN colSize = 0;
+            r = SQLDescribeCol(d->hstmt, i+1, colName, (SQLSMALLINT)COLNAMESIZE, &colNameLen, 0, &colSize, 0, 0);
 
             if (r != SQL_SUCCESS) {
                 qSparqlWarning(QString::fromLatin1("qMakeField: Unable to describe column %1").arg(i), d);
@@ -380,6 +1429,7 @@ bool QVirtuosoResult::runQuery()
             }
 
             d->bindingNames.append(QString::fromLatin1((const char*) colName));
+            d->columnSizes.append(colSize);
         }
     }
 
@@ -391,8 +1441,14 @@ void QVirtuosoAsyncResult::waitForFinished()
     if (d->isFinished == 1)
         return;
 
-	startFetcher();
-    da->fetcher->wait();
+    {
+        QMutexLocker resultLocker(&(da->mutex));
+        da->fetcherStarted = true;
+    }
+    // A fetcher which hasn't been queued, or can be taken back from the
+    // queue of the pool, is run in this thread; otherwise this waits for
+    // the pooled thread to finish it
+    da->fetcher->runOrWait(d->driverPrivate->threadPool);
 }
 
 bool QVirtuosoAsyncResult::isFinished() const
@@ -404,7 +1460,8 @@ void QVirtuosoAsyncResult::terminate()
 {
     QMutexLocker resultLocker(&(da->mutex));
 
-    if (d->results.count() % d->driverPrivate->dataReadyInterval != 0) {
+    if (d->results.count() != da->reportedCount) {
+        da->reportedCount = d->results.count();
         emit dataReady(d->results.count());
     }
 
@@ -412,21 +1469,33 @@ void QVirtuosoAsyncResult::terminate()
     emit finished();
 }
 
-static QSparqlBinding qMakeBinding(const QVirtuosoResultPrivate* p, int colNum)
+static QByteArray qGetData(const QVirtuosoResultPrivate* p, int colNum)
 {
-    QSparqlBinding b;
     int r;
     SQLLEN length = 0;
-    int bufferLength = 0;
+    int bufferLength = 1;
     SQLCHAR dummyBuffer[1]; // dummy buffer only used to determine length
     r = SQLGetData(p->hstmt, colNum, SQL_C_CHAR, dummyBuffer, 0, &length);
     if ((r == SQL_SUCCESS || r == SQL_SUCCESS_WITH_INFO) && length > 0)
         bufferLength = length / sizeof(SQLTCHAR) + 1;
 
-    QVarLengthArray<char> buffer(bufferLength);  // The real buffer
+    QByteArray buffer(bufferLength, 0);  // The real buffer
     r = SQLGetData(p->hstmt, colNum, SQL_C_CHAR, buffer.data(), buffer.size(), 0);
+    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO)
+        buffer[0] = 0;
+    buffer.truncate(qstrlen(buffer.constData()));
+    return buffer;
+}
+
+// The column types of SPARQL results are not fixed, so Virtuoso describes
+// the value of the current row in the descriptor fields
+static QSparqlBinding qMakeBinding(const QVirtuosoResultPrivate* p, int colNum, const char* data)
+{
+    QSparqlBinding b;
+    QByteArray buffer = QByteArray::fromRawData(data, qstrlen(data));
 
     int dvtype = 0;
+    int r;
     r = SQLGetDescField(p->hdesc, colNum, SQL_DESC_COL_DV_TYPE, &dvtype, SQL_IS_INTEGER, 0);
 
     switch (dvtype) {
@@ -511,9 +1580,17 @@ static QSparqlBinding qMakeBinding(const QVirtuosoResultPrivate* p, int colNum)
     return b;
 }
 
+static QSparqlBinding qMakeBinding(const QVirtuosoResultPrivate* p, int colNum)
+{
+    QByteArray buffer = qGetData(p, colNum);
+    return qMakeBinding(p, colNum, buffer.constData());
+}
+
 bool QVirtuosoAsyncResult::fetchNextResult()
 {
-    QMutexLocker connectionLocker(&(d->driverPrivate->mutex));
+    if (da->rowArray.size > 1)
+        return fetchNextRows();
+
     SQLRETURN r;
     r = SQLFetch(d->hstmt);
 
@@ -534,14 +1611,81 @@ bool QVirtuosoAsyncResult::fetchNextResult()
     }
 
     if (d->results.count() % d->driverPrivate->dataReadyInterval == 0) {
+        da->reportedCount = d->results.count();
         emit dataReady(d->results.count());
     }
     return true;
 }
 
+bool QVirtuosoAsyncResult::fetchNextRows()
+{
+    SQLRETURN r = SQLFetch(d->hstmt);
+
+    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
+        if (r != SQL_NO_DATA)
+            setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult",
+                "Unable to fetch next"), QSparqlError::BackendError, d));
+        terminate();
+        return false;
+    }
+
+    QVirtuosoRowArray& a = da->rowArray;
+    QVector<int> grownWidths(d->numResultCols, 0);
+    // The rows are read without holding the lock of the result, which the
+    // reads of the results in the thread of the result wait for
+    QVector<QSparqlResultRow> rows;
+    rows.reserve(int(a.rowsFetched));
+
+    for (int row = 0; row < int(a.rowsFetched); ++row) {
+        if (a.rowStatus[row] == SQL_ROW_NOROW || a.rowStatus[row] == SQL_ROW_ERROR)
+            continue;
+        // The descriptor fields describe the values of the current row
+        r = SQLSetPos(d->hstmt, row + 1, SQL_POSITION, SQL_LOCK_NO_CHANGE);
+        if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
+            setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult",
+                "Unable to fetch next"), QSparqlError::BackendError, d));
+            terminate();
+            return false;
+        }
+
+        // The rows share the column names of the first one
+        QSparqlResultRow resultRow(d->schema);
+        for (d->resultColIdx = 1; d->resultColIdx <= d->numResultCols; ++(d->resultColIdx)) {
+            const int column = d->resultColIdx - 1;
+            const QSQLLEN length = a.indicators[column][row];
+            if (length == SQL_NO_TOTAL || length >= a.widths[column]) {
+                // The value didn't fit in the buffer; read all of it, and
+                // have room for it in the following blocks
+                QByteArray value = qGetData(d, d->resultColIdx);
+                grownWidths[column] = qMax(grownWidths[column],
+                                           qMax(value.size() + 1, a.widths[column] * 2));
+                resultRow.append(qMakeBinding(d, d->resultColIdx, value.constData()));
+            } else if (length == SQL_NULL_DATA) {
+                resultRow.append(qMakeBinding(d, d->resultColIdx, ""));
+            } else {
+                const char* cell = a.buffers[column].constData() + row * a.widths[column];
+                resultRow.append(qMakeBinding(d, d->resultColIdx, cell));
+            }
+        }
+        if (d->schema.isEmpty())
+            d->schema = resultRow.schema();
+        rows.append(resultRow);
+    }
+    appendRows(rows);
+
+    for (int column = 0; column < d->numResultCols; ++column) {
+        if (grownWidths[column] > 0 && !bindRowArrayColumn(column, grownWidths[column])) {
+            setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult",
+                "Unable to bind column"), QSparqlError::BackendError, d));
+            terminate();
+            return false;
+        }
+    }
+    return true;
+}
+
 bool QVirtuosoAsyncResult::fetchBoolResult()
 {
-    QMutexLocker connectionLocker(&(d->driverPrivate->mutex));
     SQLRETURN r = SQLFetch(d->hstmt);
     QMutexLocker resultLocker(&(da->mutex));
 
@@ -563,9 +1707,7 @@ bool QVirtuosoAsyncResult::fetchBoolResult()
 
 bool QVirtuosoAsyncResult::fetchGraphResult()
 {
-    QMutexLocker connectionLocker(&(d->driverPrivate->mutex));
     SQLRETURN r = SQLFetch(d->hstmt);
-    QMutexLocker resultLocker(&(da->mutex));
 
     if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
         if (r != SQL_NO_DATA)
@@ -577,18 +1719,69 @@ bool QVirtuosoAsyncResult::fetchGraphResult()
 
     }
 
-    QSparqlBinding retval = qMakeBinding(d, 1);
+    if (d->bindingNames.value(0).toUpper() != QLatin1String("FMTAGGRET-NT")) {
+        terminate();
+        return true;
+    }
+
+    // The N-Triples are read a piece at a time and the triples on the
+    // complete lines are published while the rest is still being read
+    int boxFlags = 0;
+    SQLGetDescField(d->hdesc, 1, SQL_DESC_COL_BOX_FLAGS, &boxFlags, SQL_IS_INTEGER, 0);
+    const bool isUtf8 = (boxFlags & VIRTUOSO_BF_UTF8) != 0;
+
+    QSparqlNTriples parser;
+    QByteArray buffer(GRAPHCHUNKSIZE, 0);
+    forever {
+        // The result is being deleted
+        if (isFinished())
+            return true;
+
+        QSQLLEN length = 0;
+        r = SQLGetData(d->hstmt, 1, SQL_C_CHAR, buffer.data(), buffer.size(), &length);
+        if (r == SQL_NO_DATA || length == SQL_NULL_DATA)
+            break;
+        if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
+            setLastError(qMakeError(QCoreApplication::translate("QVirtuosoResult",
+                "Unable to fetch next"), QSparqlError::BackendError, d));
+            terminate();
+            return false;
+        }
+
+        // A piece which didn't hold the rest of the value is full, less the
+        // terminating 0
+        const int pieceLength = (length == SQL_NO_TOTAL || length >= buffer.size())
+                ? buffer.size() - 1 : int(length);
+        QByteArray piece = buffer.left(pieceLength);
+        if (!isUtf8)
+            piece = QString::fromLatin1(piece.constData(), piece.size()).toUtf8();
+        appendRows(parser.parseChunk(piece));
 
-    if (retval.name().toUpper() == QLatin1String("FMTAGGRET-NT")) {
-        QByteArray buffer = retval.value().toString().toLatin1();
-        QSparqlNTriples parser(buffer);
-        d->results = parser.parse();
+        if (r == SQL_SUCCESS)
+            break;
     }
+    appendRows(parser.finish());
 
     terminate();
     return true;
 }
 
+void QVirtuosoAsyncResult::appendRows(const QVector<QSparqlResultRow>& rows)
+{
+    if (rows.isEmpty())
+        return;
+
+    QMutexLocker resultLocker(&(da->mutex));
+    const int previousCount = d->results.count();
+    d->results += rows;
+
+    const int interval = d->driverPrivate->dataReadyInterval;
+    if (d->results.count() / interval != previousCount / interval) {
+        da->reportedCount = d->results.count();
+        emit dataReady(d->results.count());
+    }
+}
+
 bool QVirtuosoAsyncResult::next()
 {
     return QSparqlResult::next();
@@ -655,6 +1848,16 @@ QVariant QVirtuosoResult::handle() const
     return QVariant(qRegisterMetaType<SQLHANDLE>("SQLHANDLE"), &d->hstmt);
 }
 
+void QVirtuosoResult::setParameters(const QList<QSparqlBinding>& parameters, const QString& queryText)
+{
+    // The query with the values, instead of the one with the markers
+    setQuery(queryText);
+    d->prepared = true;
+    d->parameters.clear();
+    foreach (const QSparqlBinding& parameter, parameters)
+        d->parameters.append(qVirtuosoParameterValue(parameter));
+}
+
 QVirtuosoResult::QVirtuosoResult(const QVirtuosoDriver * db, QVirtuosoDriverPrivate* p,
                                 const QString& query, QSparqlQuery::StatementType type,
                                 const QString& prefixes)
@@ -707,12 +1910,14 @@ bool QVirtuosoResult::next()
 
 QSparqlResultRow QVirtuosoResult::current() const
 {
-    QSparqlResultRow resultRow;
+    QSparqlResultRow resultRow(d->schema);
 
     for (int i = 1; i <= d->numResultCols; ++i) {
         resultRow.append(qMakeBinding(d, i));
     }
 
+    if (d->schema.isEmpty())
+        d->schema = resultRow.schema();
     return resultRow;
 }
 
@@ -757,6 +1962,8 @@ QVirtuosoDriver::QVirtuosoDriver(SQLHANDLE env, SQLHANDLE con, QObject * parent)
     : QSparqlDriver(parent)
 {
     init();
+    // Built from open handles, there is nothing to wait for
+    d->connectTime = 0;
     d->hEnv = env;
     d->hDbc = con;
     if (env && con) {
@@ -767,12 +1974,14 @@ QVirtuosoDriver::QVirtuosoDriver(SQLHANDLE env, SQLHANDLE con, QObject * parent)
 
 void QVirtuosoDriver::init()
 {
-    d = new QVirtuosoDriverPrivate();
+    d = new QVirtuosoDriverPrivate(this);
 }
 
 QVirtuosoDriver::~QVirtuosoDriver()
 {
+    d->threadPool.waitForDone();
     cleanup();
+    delete d->connectionOpener;
     delete d;
 }
 
@@ -783,6 +1992,8 @@ bool QVirtuosoDriver::hasFeature(QSparqlConnection::Feature f) const
     case QSparqlConnection::AskQueries:
     case QSparqlConnection::ConstructQueries:
     case QSparqlConnection::UpdateQueries:
+    case QSparqlConnection::Transactions:
+    case QSparqlConnection::GraphUpload:
         return true;
     case QSparqlConnection::DefaultGraph:
     case QSparqlConnection::SyncExec:
@@ -795,7 +2006,36 @@ bool QVirtuosoDriver::hasFeature(QSparqlConnection::Feature f) const
 
 bool QVirtuosoDriver::hasError() const
 {
-    return false;
+    return isOpenError();
+}
+
+void QVirtuosoDriver::asyncOpenComplete()
+{
+    QMutexLocker openLocker(&(d->openMutex));
+    // Ignore a completion queued by the opener of an earlier open()
+    if (d->asyncOpenCalled || !d->connectionOpener || !d->connectionOpener->isFinished())
+        return;
+    d->asyncOpenCalled = true;
+    openLocker.unlock();
+
+    // The opener has finished, so hDbc and openError don't change any more
+    if (!d->hDbc) {
+        qWarning() << "QVirtuosoDriver::open:" << d->openError;
+        setOpen(false);
+        setOpenError(true);
+        setLastError(QSparqlError(d->openError, QSparqlError::ConnectionError));
+    }
+    Q_EMIT opened();
+}
+
+QVariantMap QVirtuosoDriver::statistics() const
+{
+    QVariantMap stats;
+    QMutexLocker poolLocker(&(d->poolMutex));
+    stats.insert(QLatin1String("connectTime"), d->connectTime);
+    stats.insert(QLatin1String("pooledConnections"), d->pooledConnections);
+    stats.insert(QLatin1String("idleConnections"), d->idleConnections.count());
+    return stats;
 }
 
 bool QVirtuosoDriver::open(const QSparqlConnectionOptions& options)
@@ -815,13 +2055,6 @@ bool QVirtuosoDriver::open(const QSparqlConnectionOptions& options)
         // set odbc version
     SQLSetEnvAttr(d->hEnv, SQL_ATTR_ODBC_VERSION, (SQLPOINTER) SQL_OV_ODBC3, SQL_IS_UINTEGER);
 
-    r = SQLAllocHandle(SQL_HANDLE_DBC, d->hEnv, &d->hDbc);
-    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
-        qSparqlWarning(QLatin1String("QVirtuosoDriver::open: Unable to allocate connection"), d);
-        setOpenError(true);
-        return false;
-    }
-
     // Create the connection string
     QString connectString;
     // support the "DRIVER={SQL SERVER};SERVER=blah" syntax
@@ -857,26 +2090,71 @@ bool QVirtuosoDriver::open(const QSparqlConnectionOptions& options)
     else
         connectString += QLatin1String(";PWD=") + options.password();
 
-    SQLSMALLINT cb;
-    SQLTCHAR connectionOut[4097];
-    connectionOut[4096] = 0;
-
-    r = SQLDriverConnect( d->hDbc,
-                          0,
-                          (UCHAR*) connectString.toUtf8().data(),
-                          SQL_NTS,
-                          connectionOut,
-                          4096,
-                          &cb,
-                          SQL_DRIVER_COMPLETE);
-    if (r != SQL_SUCCESS && r != SQL_SUCCESS_WITH_INFO) {
-        setLastError(qMakeError(tr("Unable to connect"), QSparqlError::ConnectionError, d));
-        setOpenError(true);
-        return false;
-    }
+    d->connectString = connectString.toUtf8();
 
     d->dataReadyInterval = options.dataReadyInterval();
 
+    //Get the options for the thread pool, if no expiry time has been set
+    //set our own value of 2 seconds (the default value is 30 seconds)
+    if (options.threadExpiryTime() != -1)
+        d->threadPool.setExpiryTimeout(options.threadExpiryTime());
+    else
+        d->threadPool.setExpiryTimeout(2000);
+
+    //get the max thread count from an option if it was set, else use
+    //the qt default of number of cores
+    if (options.maxThreadCount() > 0)
+        d->threadPool.setMaxThreadCount(options.maxThreadCount());
+    else
+        d->threadPool.setMaxThreadCount(QThread::idealThreadCount());
+
+    //a pooled thread uses one connection at a time, and waitForFinished()
+    //may run one more query in the calling thread
+    QVariant v = options.option(QLatin1String("maxConnections"));
+    if (v.isValid() && v.toInt() > 0)
+        d->maxConnections = v.toInt();
+    else
+        d->maxConnections = d->threadPool.maxThreadCount() + 1;
+
+    v = options.option(QLatin1String("minConnections"));
+    if (v.isValid())
+        d->minConnections = qBound(0, v.toInt(), d->maxConnections);
+    else
+        d->minConnections = qMin(1, d->maxConnections);
+
+    v = options.option(QLatin1String("connectionIdleTimeout"));
+    if (v.isValid())
+        d->connectionIdleTimeout = v.toInt();
+    else
+        d->connectionIdleTimeout = 60000;
+
+    v = options.option(QLatin1String("rowArraySize"));
+    if (v.isValid())
+        d->rowArraySize = qMax(1, v.toInt());
+    else
+        d->rowArraySize = 256;
+
+    v = options.option(QLatin1String("statementCacheSize"));
+    if (v.isValid())
+        d->statementCacheSize = qMax(0, v.toInt());
+    else
+        d->statementCacheSize = 32;
+
+    // The connections are opened in the thread pool; a query issued before
+    // they are up is started once the opened() signal has been emitted, and
+    // a sync query waits for the connection
+    QMutexLocker poolLocker(&(d->poolMutex));
+    d->connectTime = -1;
+    poolLocker.unlock();
+    d->connectTimer.start();
+    d->openError.clear();
+    QMutexLocker openLocker(&(d->openMutex));
+    d->asyncOpenCalled = false;
+    delete d->connectionOpener;
+    d->connectionOpener = new QVirtuosoDriverConnectionOpen(d);
+    d->connectionOpener->queue(d->threadPool);
+    openLocker.unlock();
+
     setOpen(true);
     setOpenError(false);
     return true;
@@ -884,6 +2162,13 @@ bool QVirtuosoDriver::open(const QSparqlConnectionOptions& options)
 
 void QVirtuosoDriver::close()
 {
+    d->waitForConnectionOpen();
+    QMutexLocker poolLocker(&(d->poolMutex));
+    bool inTransaction = d->inTransaction;
+    poolLocker.unlock();
+    if (inTransaction)
+        rollbackTransaction();
+    d->threadPool.waitForDone();
     cleanup();
     setOpen(false);
     setOpenError(false);
@@ -897,6 +2182,8 @@ void QVirtuosoDriver::cleanup()
     if (!d)
         return;
 
+    d->drainPool();
+
     if(d->hDbc) {
         // Open statements/descriptors handles are automatically cleaned up by SQLDisconnect
         if (isOpen()) {
@@ -923,12 +2210,21 @@ void QVirtuosoDriver::cleanup()
 
 bool QVirtuosoDriver::beginTransaction()
 {
+    d->waitForConnectionOpen();
     QMutexLocker connectionLocker(&(d->mutex));
 
     if (!isOpen()) {
         qWarning() << "QVirtuosoDriver::beginTransaction: Database not open";
         return false;
     }
+    QMutexLocker poolLocker(&(d->poolMutex));
+    if (d->inTransaction) {
+        setLastError(QSparqlError(QLatin1String("QVirtuoso: A transaction is already active"),
+                                  QSparqlError::TransactionError));
+        return false;
+    }
+    poolLocker.unlock();
+
     SQLUINTEGER ac(SQL_AUTOCOMMIT_OFF);
     SQLRETURN r  = SQLSetConnectAttr(d->hDbc,
                                       SQL_ATTR_AUTOCOMMIT,
@@ -939,11 +2235,16 @@ bool QVirtuosoDriver::beginTransaction()
                      QSparqlError::TransactionError, d));
         return false;
     }
+    poolLocker.relock();
+    d->inTransaction = true;
     return true;
 }
 
 bool QVirtuosoDriver::commitTransaction()
 {
+    d->waitForConnectionOpen();
+    // The queries of the transaction are run on hDbc under the mutex
+    d->finishTransactionResults();
     QMutexLocker connectionLocker(&(d->mutex));
 
     if (!isOpen()) {
@@ -963,6 +2264,9 @@ bool QVirtuosoDriver::commitTransaction()
 
 bool QVirtuosoDriver::rollbackTransaction()
 {
+    d->waitForConnectionOpen();
+    // The queries of the transaction are run on hDbc under the mutex
+    d->finishTransactionResults();
     QMutexLocker connectionLocker(&(d->mutex));
 
     if (!isOpen()) {
@@ -984,6 +2288,10 @@ bool QVirtuosoDriver::endTrans()
 {
     QMutexLocker connectionLocker(&(d->mutex));
 
+    QMutexLocker poolLocker(&(d->poolMutex));
+    d->inTransaction = false;
+    poolLocker.unlock();
+
     SQLUINTEGER ac(SQL_AUTOCOMMIT_ON);
     SQLRETURN r  = SQLSetConnectAttr(d->hDbc,
                                       SQL_ATTR_AUTOCOMMIT,
@@ -999,11 +2307,13 @@ bool QVirtuosoDriver::endTrans()
 
 QVariant QVirtuosoDriver::handle() const
 {
+    d->waitForConnectionOpen();
     return QVariant(qRegisterMetaType<SQLHANDLE>("SQLHANDLE"), &d->hDbc);
 }
 
 QVirtuosoResult* QVirtuosoDriver::syncExec(const QString& query, QSparqlQuery::StatementType type)
 {
+    d->waitForConnectionOpen();
     QVirtuosoResult* result = new QVirtuosoResult(this, d, query, type, prefixes());
     result->runQuery();
     return result;
@@ -43,6 +43,8 @@
 #include <QtSparql/private/qsparqldriver_p.h>
 #include <QtSparql/qsparqlresult.h>
 
+#include <QtCore/qvector.h>
+
 #if defined (Q_OS_WIN32)
 #include <QtCore/qt_windows.h>
 #endif
@@ -92,6 +94,7 @@ public:
 
     QVariant handle() const;
     virtual bool runQuery();
+    void setParameters(const QList<QSparqlBinding>& parameters, const QString& queryText);
 
     bool next();
     QSparqlBinding binding(int field) const;
@@ -104,6 +107,9 @@ public:
     virtual void terminate() {}
 protected:
     QVirtuosoResultPrivate *d;
+private:
+    bool runPreparedQuery();
+    bool describeColumns();
 };
 
 class QVirtuosoAsyncResult : public QVirtuosoResult
@@ -113,11 +119,13 @@ class QVirtuosoAsyncResult : public QVirtuosoResult
 public:
     QVirtuosoAsyncResult(const QVirtuosoDriver * db, QVirtuosoDriverPrivate* p,
                     const QString& query, QSparqlQuery::StatementType type,
-                    const QString& prefixes);
+                    const QString& prefixes, const QSparqlQueryOptions& options);
     virtual ~QVirtuosoAsyncResult();
 
-    Q_INVOKABLE void startFetcher();
     bool runQuery();
+    void setUpload(QIODevice* data, const QByteArray& loader, const QUrl& graph, bool replace);
+    bool isUpload() const;
+    bool runUpload();
 
     bool next();
     QSparqlBinding binding(int field) const;
@@ -130,10 +138,21 @@ public:
 
     bool hasFeature(QSparqlResult::Feature feature) const;
     void terminate();
+
+public Q_SLOTS:
+    void startFetcher();
+
 private:
+    bool putUploadData();
+    void releaseConnection();
+    bool bindRowArray();
+    bool bindRowArrayColumn(int column, int width);
+    void unbindRowArray();
     bool fetchNextResult();
+    bool fetchNextRows();
     bool fetchBoolResult();
     bool fetchGraphResult();
+    void appendRows(const QVector<QSparqlResultRow>& rows);
     QVirtuosoAsyncResultPrivate *da;
 };
 
@@ -150,19 +169,31 @@ public:
     QVariant handle() const;
     bool open(const QSparqlConnectionOptions& options);
     QVirtuosoResult* exec(const QString& query, QSparqlQuery::StatementType type, const QSparqlQueryOptions& options);
+    QVirtuosoResult* execPrepared(const QSparqlQuery& query, const QSparqlQueryOptions& options);
+    QVariantMap statistics() const;
+    QSparqlResult* uploadGraph(QIODevice* data, const QString& contentType, const QUrl& graph,
+                               QSparqlConnection::GraphUploadMode mode);
+
+Q_SIGNALS:
+    void opened();
 
 protected:
     bool beginTransaction();
     bool commitTransaction();
     bool rollbackTransaction();
 
+private Q_SLOTS:
+    void asyncOpenComplete();
+
 private:
     void init();
     bool endTrans();
     void cleanup();
-    QVirtuosoAsyncResult* asyncExec(const QString& query, QSparqlQuery::StatementType type);
+    QVirtuosoAsyncResult* asyncExec(const QString& query, QSparqlQuery::StatementType type,
+                                    const QSparqlQueryOptions& options);
     QVirtuosoResult* syncExec(const QString& query, QSparqlQuery::StatementType type);
     QVirtuosoDriverPrivate* d;
+    friend class QVirtuosoDriverPrivate;
     friend class QVirtuosoResultPrivate;
     friend class QVirtuosoAsyncResultPrivate;
 };
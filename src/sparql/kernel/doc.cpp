@@ -216,6 +216,15 @@
 
     \section connectionoptions Connection options supported by drivers
 
+    QTRACKER driver supports the following connection options:
+    - custom: "batchWindow" (int, default 0), when greater than zero, insert
+      and delete queries executed within this many milliseconds are sent to
+      Tracker with a single BatchSparqlUpdate call followed by a BatchCommit.
+      Each QSparqlResult still finishes on its own, but an error in any of
+      the updates fails all the results of the batch. Queued updates can be
+      sent immediately with QSparqlConnection::flush(). They are also sent
+      before any other query of the connection, which then sees them.
+
     QTRACKER_DIRECT driver supports the following connection options:
     - dataReadyInterval (int, default 1), controls the interval for
       emitting the dataReady signal.
@@ -230,11 +239,68 @@
     - path (QString)
     - port (int)
     - userName (QString)
-    - password (QString)
+    - password (QString), the credentials are sent with each request using
+      HTTP basic authentication
     - networkAccessManager (QNetworkAccessManager*)
     - proxy (const QNetworkProxy&)
     - custom: "timeout" (int) (for virtuoso endpoints)
     - custom: "maxrows" (int) (for virtuoso endpoints)
+    - custom: "postThreshold" (int, default 2048), queries longer than
+      this many bytes of UTF-8 are sent in the body of a POST request as
+      application/sparql-query instead of in the URL. Set to -1 to always
+      use GET.
+    - custom: "updateOverPost" (bool, default true), send insert and delete
+      queries as SPARQL 1.1 Update POST requests (application/sparql-update).
+      Set to false for endpoints which only take updates in the query URL.
+    - custom: "cacheDirectory" (QString), keep the replies of queries sent
+      with GET in a QNetworkDiskCache in this directory. Cached replies are
+      revalidated with the endpoint using their ETag or Last-Modified date,
+      and replayed when the endpoint answers 304 Not Modified. Ignored when
+      the networkAccessManager option is set; set a cache on that manager
+      instead. The hits and misses are reported by
+      QSparqlConnection::statistics().
+    - custom: "cacheSize" (qint64), the maximum size of the cache in bytes.
+    - custom: "compression" (bool, default true), ask the endpoint for gzip
+      or deflate compressed replies, which are decompressed as they arrive.
+    - custom: "maxRequestsPerHost" (int, default 6), the number of requests
+      sent to a host at the same time. The other requests wait in a queue in
+      the order of their QSparqlQueryOptions::priority(). The time the
+      requests spend in the queue is reported by
+      QSparqlConnection::statistics().
+    - custom: "networkThread" (bool, default false), send the asynchronous
+      queries too from the network thread of the driver, where the replies
+      are read and parsed without blocking the thread of the connection. The
+      rows are published to the result in blocks, with one
+      QSparqlResult::dataReady() signal for each block. The
+      networkAccessManager option is not used for the queries then.
+    - custom: "syncBufferRows" (int, default 1000), the number of rows a
+      forward only synchronous result reads ahead of QSparqlResult::next().
+      See \ref endpointspecific "QSPARQL_ENDPOINT specific usage".
+    - custom: "resultsFormat" (QString, default "xml"), set to "json" to
+      ask the endpoint for SPARQL JSON results, which are parsed
+      incrementally as they arrive, or to "tsv" to ask for SPARQL TSV
+      results for SELECT queries, which are the smallest and cheapest to
+      parse. Endpoints which answer with XML results are still handled.
+    - custom: "graphStorePath" (QString, default "sparql-graph-crud"), the
+      path of the SPARQL 1.1 Graph Store HTTP Protocol service on the host of
+      the endpoint, used by QSparqlConnection::uploadGraph().
+    - custom: "uploadChunkSize" (qint64, default 1048576), the size in bytes
+      of the requests a QSparqlConnection::uploadGraph() from a sequential
+      device is split into.
+    - custom: "endpoints" (QStringList), the URLs of replicas of the
+      endpoint. They are used instead of hostName, port and path; each read
+      query goes to the replica with the fewest requests in flight, and the
+      updates go to the first one.
+    - custom: "hedgeRequests" (bool, default false), send a read query again
+      to a second replica when the first one hasn't started answering in
+      time. The reply which starts first is used and the other one is
+      cancelled. See \ref endpointspecific "QSPARQL_ENDPOINT specific usage".
+    - custom: "hedgePercentile" (int, default 95), the percentile of the
+      recent times to the first byte of a reply after which a query is
+      hedged.
+    - custom: "hedgeDelay" (int, default 50), the time in milliseconds after
+      which a query is hedged until there are enough replies to take the
+      percentile of.
 
     QVIRTUOSO driver supports the following connection options:
     - hostName (QString)
@@ -242,6 +308,54 @@
     - userName (QString)
     - password (QString)
     - databaseName (QString)
+    - dataReadyInterval (int, default 1), controls the interval for
+      emitting the dataReady signal.
+    - maxThread (int), sets the maximum number of threads the asynchronous
+      queries are run on. If not set, the number of cores will be used.
+    - threadExpiry (int, default 2000), controls the expiry time
+      (in milliseconds) of the threads created by the thread pool.
+    - custom: "maxConnections" (int), the maximum number of ODBC connections
+      the asynchronous queries are run on in parallel. If not set, one more
+      than the maximum number of threads will be used.
+    - custom: "minConnections" (int, default 1), the number of pooled
+      connections opened with the connection and kept open when idle.
+    - custom: "connectionIdleTimeout" (int, default 60000), the time in
+      milliseconds after which an idle pooled connection above the minimum
+      is closed. A negative value keeps the connections open.
+    - custom: "statementCacheSize" (int, default 32), the number of prepared
+      asynchronous queries kept for reuse on each pooled connection. The
+      values bound to a QSparqlQuery are passed to Virtuoso as parameters
+      of the prepared query instead of being inserted in the query text.
+      Queries without bound values are not prepared.
+    - custom: "rowArraySize" (int, default 256), the number of rows of an
+      asynchronous SELECT query fetched at a time into reused buffers. With 1,
+      or when the ODBC driver can't read data from a block of rows, the rows
+      are fetched one by one.
+
+    The QVIRTUOSO driver connects to the server in the background, so that
+    creating the QSparqlConnection doesn't wait for it. Asynchronous queries
+    made meanwhile are started once the connection is up, and synchronous
+    queries wait for it. QSparqlConnection::statistics() reports
+    "connectTime", the time in milliseconds it took to open the connections
+    (-1 until they are open), and the number of "pooledConnections" and
+    "idleConnections".
+
+    QSparqlResult::waitForFinished() on an asynchronous QVIRTUOSO query which
+    is still waiting for a thread of the pool takes it out of the queue and
+    runs it in the calling thread. This needs Qt 5.9; with earlier versions
+    it waits until a thread of the pool has run the query.
+
+    QSparqlConnection::uploadGraph() loads the data with the bulk loader
+    procedures of Virtuoso, DB.DBA.TTLP for Turtle and N-Triples and
+    DB.DBA.RDF_LOAD_RDFXML for RDF/XML, streaming it to the server in pieces
+    of 64 KiB. A graph must be given, since Virtuoso has no default graph.
+    The data is read in a thread of the driver, so it must be a QFile, a
+    QBuffer or another random access device which can be read from any
+    thread, and it must not be used until the result has finished.
+    Sequential devices such as sockets and processes are rejected with an
+    error. A read error cancels the upload; a replaced graph keeps its old
+    contents. Each upload runs on a pooled
+    connection of its own, so that several files are loaded in parallel.
 
     For setting custom options, use QSparqlConnectionOptions::setOption() and
     give the option name as a string, followed by the value.
@@ -264,6 +378,8 @@
     <th>UpdateQueries</th>
     <th>SyncExec</th>
     <th>AsyncExec</th>
+    <th>GraphUpload</th>
+    <th>Transactions</th>
     </tr>
     <tr>
     <th>QTRACKER</th>
@@ -274,6 +390,8 @@
     <td>Yes</td>
     <td>No</td>
     <td>Yes</td>
+    <td>No</td>
+    <td>No</td>
     </tr>
     <tr>
     <th>QTRACKER_DIRECT</th>
@@ -284,6 +402,8 @@
     <td>Yes</td>
     <td>Yes</td>
     <td>Yes</td>
+    <td>No</td>
+    <td>No</td>
     </tr>
     <tr>
     <th>QSPARQL_ENDPOINT</th>
@@ -292,8 +412,10 @@
     <td>Yes</td>
     <td>Yes</td>
     <td>Yes</td>
-    <td>No</td>
     <td>Yes</td>
+    <td>Yes</td>
+    <td>Yes</td>
+    <td>No</td>
     </tr>
     <tr>
     <th>QVIRTUOSO</th>
@@ -304,6 +426,8 @@
     <td>Yes</td>
     <td>No (*)</td>
     <td>No</td>
+    <td>Yes</td>
+    <td>Yes</td>
     </tr>
     </table>
 
@@ -351,6 +475,49 @@
     API to execute large queries quickly, since the results will not be retrieved before QSparqlResult::finished
     is emitted.
 
+    \section endpointspecific QSPARQL_ENDPOINT specific usage
+
+    The QSPARQL_ENDPOINT driver sends the queries executed with
+    QSparqlConnection::syncExec() from a network thread of its own, so
+    the caller blocks without running a nested event loop. syncExec()
+    returns when the first rows have arrived, or for ASK and update
+    queries, when the query has finished. QSparqlResult::next() waits for
+    the next row while the rest of the reply is still being parsed.
+
+    With the "networkThread" connection option, the asynchronous queries are
+    run in the same thread, and their results emit QSparqlResult::dataReady()
+    and QSparqlResult::finished() in the thread of the connection. A
+    QSparqlResult::dataReady() signal covers all the rows which have arrived
+    since the previous one.
+
+    When QSparqlQueryOptions::setForwardOnly() is set for a synchronous
+    query, the rows are dropped after next() has passed them, and the reply
+    is paused while "syncBufferRows" rows are waiting to be read, so that
+    results of any size are read in constant memory.
+
+    With several "endpoints" and the "hedgeRequests" option, a read query
+    which has no reply after the "hedgePercentile" of the recent reply times
+    is sent to a second replica as well, which cuts the tail latency caused
+    by a slow or overloaded replica for the cost of some duplicate requests.
+    Updates are never hedged, and neither are queries when the second
+    replica already has "maxRequestsPerHost" requests in flight or waiting;
+    the hedge counts against that limit. QSparqlConnection::statistics()
+    reports the requests in flight for each replica, and how many of the
+    queries were hedged and how many of those the second replica answered
+    first.
+
+    QSparqlConnection::uploadGraph() sends the data with the SPARQL 1.1 Graph
+    Store HTTP Protocol, as a POST to add the triples to the graph or a PUT
+    to replace it. A file or other device of a known size is sent in one
+    request, read as the request is sent. The data of a sequential device,
+    such as a pipe or a socket, is sent in a series of requests of about
+    "uploadChunkSize" bytes, split at the end of a statement, which is only
+    possible for N-Triples and Turtle; the prefixes of a Turtle document are
+    repeated in each request. A replacing upload from a sequential device is
+    not atomic: the first request replaces the graph and the rest add to it.
+    The upload requests wait for a free slot of the host like the queries,
+    with the normal priority, and count against "maxRequestsPerHost".
+
     \section backendspecific Accessing backend-specific functionalities
 
     QtSparql doesn't offer backend-specific functionalities.  For that purpose,
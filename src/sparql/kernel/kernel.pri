@@ -1,5 +1,6 @@
 HEADERS +=      kernel/qsparql.h \
                 kernel/qsparqlquery.h \
+                kernel/qsparqlquery_p.h \
                 kernel/qsparqlconnection.h \
                 kernel/qsparqlconnection_p.h \
                 kernel/qsparqlconnectionoptions.h \
@@ -8,9 +9,11 @@ HEADERS +=      kernel/qsparql.h \
                 kernel/qsparqlresultrow.h \
                 kernel/qsparqldriver_p.h \
                 kernel/qsparqlnulldriver_p.h \
+                kernel/qsparqlpagedresult_p.h \
                 kernel/qsparqldriverplugin_p.h \
                 kernel/qsparqlerror.h \
                 kernel/qsparqlntriples_p.h \
+                kernel/qsparqlxmlresultsreader_p.h \
                 kernel/qsparqlresult.h 
 
 SOURCES +=      kernel/qsparqlquery.cpp \
@@ -23,5 +26,7 @@ SOURCES +=      kernel/qsparqlquery.cpp \
                 kernel/qsparqldriverplugin.cpp \
                 kernel/qsparqlerror.cpp \
                 kernel/qsparqlntriples.cpp \
-                kernel/qsparqlresult.cpp 
+                kernel/qsparqlxmlresultsreader.cpp \
+                kernel/qsparqlresult.cpp \
+                kernel/qsparqlpagedresult.cpp 
 
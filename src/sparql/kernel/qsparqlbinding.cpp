@@ -43,44 +43,327 @@
 #include <QtCore/qurl.h>
 #include <QtCore/qdatetime.h>
 #include <QtCore/qregexp.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qpair.h>
+#include <QtCore/qthreadstorage.h>
 
 #define XSD_ALL
 #include "qsparqlxsd_p.h"
 
 QT_BEGIN_NAMESPACE
 
+// The name, node type, data type and language tag of a binding. These are
+// interned and never change, so that a binding is only a value and a
+// pointer to the QSparqlBindingPrivate shared by all the bindings of a
+// column. The data type is an enum for the XSD types and an interned IRI
+// for the others, and the language tag is interned too. The interned
+// values are kept until the library is unloaded, so the memory grows with
+// the number of different names, data types and language tags seen by the
+// application, not with the number of bindings.
 class QSparqlBindingPrivate
 {
 public:
-    enum NodeType { Invalid, Uri, Literal, Blank };
+    enum NodeType { Invalid, Uri, Literal, Blank, NodeTypeCount };
+    enum DataType { NoDataType, Int, Integer, NonNegativeInteger, UnsignedInt,
+                    Decimal, Short, Long, UnsignedLong, Boolean, Double, Float,
+                    String, Date, Time, DateTime, Base64Binary,
+                    XsdDataTypeCount, CustomDataType = XsdDataTypeCount };
 
-    QSparqlBindingPrivate(const QString &name) :
-        ref(1), nm(name), nodetype(QSparqlBindingPrivate::Invalid)
-    {
-    }
+    static QSparqlBindingPrivate* named(const QString& name);
+    static DataType dataTypeId(const QUrl& dataTypeUri);
 
-    QSparqlBindingPrivate(const QSparqlBindingPrivate &other)
-        : ref(1),
-          nm(other.nm),
-          dataType(other.dataType),
-          lang(other.lang),
-          nodetype(other.nodetype)
-    {}
+    QSparqlBindingPrivate* withName(const QString& name);
+    QSparqlBindingPrivate* withNodeType(NodeType type);
+    QSparqlBindingPrivate* withDataType(DataType type);
+    QSparqlBindingPrivate* withDataType(const QUrl& dataTypeUri);
+    QSparqlBindingPrivate* withLanguageTag(const QString& lang);
 
     bool operator==(const QSparqlBindingPrivate& other) const
     {
+        // The data types and language tags are interned
         return (nodetype == other.nodetype
                 && dataType == other.dataType
                 && lang == other.lang);
     }
 
-    QAtomicInt ref;
-    QString nm;
-    QUrl dataType;
-    QString lang;
-    NodeType nodetype;
+    const QString nm;
+    const NodeType nodetype;
+    const DataType dataTypeIdx;
+    // 0 when the binding has no data type or language tag
+    const QUrl* const dataType;
+    const QString* const lang;
+
+private:
+    QSparqlBindingPrivate(const QString& name, NodeType type, DataType dataTypeIdx,
+                          const QUrl* dataType, const QString* lang)
+        : nm(name), nodetype(type), dataTypeIdx(dataTypeIdx), dataType(dataType), lang(lang)
+    {
+    }
+
+    static QSparqlBindingPrivate* intern(const QString& name, NodeType type, DataType dataTypeIdx,
+                                         const QUrl* dataType, const QString* lang);
+    static QSparqlBindingPrivate* cached(QAtomicPointer<QSparqlBindingPrivate>& transition,
+                                         const QString& name, NodeType type, DataType dataTypeIdx,
+                                         const QUrl* dataType, const QString* lang);
+    QSparqlBindingPrivate* internDataType(const QUrl& dataTypeUri);
+    QSparqlBindingPrivate* internLanguageTag(const QString& languageTag);
+
+    // The results of withNodeType() and withDataType() for the XSD types,
+    // so that setting the value of a binding doesn't need a lookup
+    QAtomicPointer<QSparqlBindingPrivate> nodeTypes[NodeTypeCount];
+    QAtomicPointer<QSparqlBindingPrivate> dataTypes[XsdDataTypeCount];
+};
+
+struct QSparqlBindingKey
+{
+    QString name;
+    int nodetype;
+    const QUrl* dataType;
+    const QString* lang;
+
+    bool operator==(const QSparqlBindingKey& other) const
+    {
+        return nodetype == other.nodetype && dataType == other.dataType
+                && lang == other.lang && name == other.name;
+    }
+};
+
+static inline uint qHash(const QSparqlBindingKey& key)
+{
+    return qHash(key.name) ^ (uint(key.nodetype) << 24)
+            ^ qHash(quintptr(key.dataType)) ^ qHash(quintptr(key.lang));
+}
+
+class QSparqlBindingInterner
+{
+public:
+    QSparqlBindingInterner()
+    {
+        const QUrl* xsd[XSDCOUNT] = { 0, XSD::Int(), XSD::Integer(), XSD::NonNegativeInteger(),
+                                      XSD::UnsignedInt(), XSD::Decimal(), XSD::Short(), XSD::Long(),
+                                      XSD::UnsignedLong(), XSD::Boolean(), XSD::Double(), XSD::Float(),
+                                      XSD::String(), XSD::Date(), XSD::Time(), XSD::DateTime(),
+                                      XSD::Base64Binary() };
+        for (int i = 0; i < XSDCOUNT; ++i) {
+            xsdTypes[i] = xsd[i];
+            if (xsd[i])
+                xsdTypeIds.insert(xsd[i]->toEncoded(), QSparqlBindingPrivate::DataType(i));
+        }
+    }
+
+    ~QSparqlBindingInterner()
+    {
+        qDeleteAll(bindings);
+        qDeleteAll(dataTypes);
+        qDeleteAll(languageTags);
+    }
+
+    const QUrl* internDataType(const QUrl& dataType)
+    {
+        const QByteArray iri = dataType.toEncoded();
+        QUrl*& interned = dataTypes[iri];
+        if (!interned)
+            interned = new QUrl(dataType);
+        return interned;
+    }
+
+    const QString* internLanguageTag(const QString& lang)
+    {
+        QString*& interned = languageTags[lang];
+        if (!interned)
+            interned = new QString(lang);
+        return interned;
+    }
+
+    enum { XSDCOUNT = QSparqlBindingPrivate::XsdDataTypeCount };
+
+    // Guards the hashes but xsdTypes and xsdTypeIds, which are not modified
+    QMutex mutex;
+    QHash<QSparqlBindingKey, QSparqlBindingPrivate*> bindings;
+    QHash<QByteArray, QUrl*> dataTypes;
+    QHash<QString, QString*> languageTags;
+    const QUrl* xsdTypes[XSDCOUNT];
+    QHash<QByteArray, QSparqlBindingPrivate::DataType> xsdTypeIds;
+};
+
+Q_GLOBAL_STATIC(QSparqlBindingInterner, bindingInterner)
+
+// The bindings without a value, by name, for each thread, so that creating a binding
+// doesn't take the lock of the interner
+typedef QHash<QString, QSparqlBindingPrivate*> QSparqlBindingNameCache;
+Q_GLOBAL_STATIC(QThreadStorage<QSparqlBindingNameCache*>, bindingNameCache)
+
+// The results of withDataType(const QUrl&) and withLanguageTag() for each
+// thread, so that the cells of a column, which mostly have the same data
+// type or language tag, don't take the lock of the interner or encode the
+// data type IRI. The language tags are emptied when there are more than
+// MaxLanguageTags of them; the data types keep the last few IRIs, since a
+// QUrl can't be hashed without encoding it.
+struct QSparqlBindingTransitionCache
+{
+    enum { MaxLanguageTags = 1024, DataTypeCount = 8 };
+
+    struct DataTypeTransition
+    {
+        const QSparqlBindingPrivate* from;
+        QUrl dataTypeUri;
+        QSparqlBindingPrivate* to;
+    };
+
+    QSparqlBindingTransitionCache() : nextDataType(0)
+    {
+        for (int i = 0; i < DataTypeCount; ++i) {
+            dataTypes[i].from = 0;
+            dataTypes[i].to = 0;
+        }
+    }
+
+    QHash<QPair<const QSparqlBindingPrivate*, QString>, QSparqlBindingPrivate*> languageTags;
+    DataTypeTransition dataTypes[DataTypeCount];
+    int nextDataType;   // the entry replaced next
 };
 
+Q_GLOBAL_STATIC(QThreadStorage<QSparqlBindingTransitionCache*>, bindingTransitionCache)
+
+static QSparqlBindingTransitionCache* transitionCache()
+{
+    QThreadStorage<QSparqlBindingTransitionCache*>* storage = bindingTransitionCache();
+    if (!storage->hasLocalData())
+        storage->setLocalData(new QSparqlBindingTransitionCache);
+    return storage->localData();
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::intern(const QString& name, NodeType type,
+                                                     DataType dataTypeIdx, const QUrl* dataType,
+                                                     const QString* lang)
+{
+    QSparqlBindingInterner* interner = bindingInterner();
+    QSparqlBindingKey key = { name, type, dataType, lang };
+    QMutexLocker locker(&interner->mutex);
+    QSparqlBindingPrivate*& interned = interner->bindings[key];
+    if (!interned)
+        interned = new QSparqlBindingPrivate(name, type, dataTypeIdx, dataType, lang);
+    return interned;
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::cached(QAtomicPointer<QSparqlBindingPrivate>& transition,
+                                                     const QString& name, NodeType type,
+                                                     DataType dataTypeIdx, const QUrl* dataType,
+                                                     const QString* lang)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QSparqlBindingPrivate* target = transition.loadAcquire();
+#else
+    QSparqlBindingPrivate* target = transition;
+#endif
+    if (!target) {
+        // Another thread may store the same interned pointer meanwhile
+        target = intern(name, type, dataTypeIdx, dataType, lang);
+        transition.testAndSetOrdered(0, target);
+    }
+    return target;
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::named(const QString& name)
+{
+    QThreadStorage<QSparqlBindingNameCache*>* storage = bindingNameCache();
+    if (!storage->hasLocalData())
+        storage->setLocalData(new QSparqlBindingNameCache);
+    QSparqlBindingPrivate*& binding = (*storage->localData())[name];
+    if (!binding)
+        binding = intern(name, Invalid, NoDataType, 0, 0);
+    return binding;
+}
+
+QSparqlBindingPrivate::DataType QSparqlBindingPrivate::dataTypeId(const QUrl& dataTypeUri)
+{
+    if (dataTypeUri.isEmpty())
+        return NoDataType;
+    return bindingInterner()->xsdTypeIds.value(dataTypeUri.toEncoded(), CustomDataType);
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::withName(const QString& name)
+{
+    if (nodetype == Invalid && !dataType && !lang)
+        return named(name);
+    return intern(name, nodetype, dataTypeIdx, dataType, lang);
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::withNodeType(NodeType type)
+{
+    if (type == nodetype)
+        return this;
+    return cached(nodeTypes[type], nm, type, dataTypeIdx, dataType, lang);
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::withDataType(DataType type)
+{
+    if (type == dataTypeIdx)
+        return this;
+    return cached(dataTypes[type], nm, nodetype, type, bindingInterner()->xsdTypes[type], lang);
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::withDataType(const QUrl& dataTypeUri)
+{
+    QSparqlBindingTransitionCache* cache = transitionCache();
+    for (int i = 0; i < QSparqlBindingTransitionCache::DataTypeCount; ++i) {
+        const QSparqlBindingTransitionCache::DataTypeTransition& transition = cache->dataTypes[i];
+        if (transition.from == this && transition.dataTypeUri == dataTypeUri)
+            return transition.to;
+    }
+
+    QSparqlBindingTransitionCache::DataTypeTransition& transition =
+            cache->dataTypes[cache->nextDataType];
+    cache->nextDataType = (cache->nextDataType + 1) % QSparqlBindingTransitionCache::DataTypeCount;
+    transition.from = this;
+    transition.dataTypeUri = dataTypeUri;
+    transition.to = internDataType(dataTypeUri);
+    return transition.to;
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::internDataType(const QUrl& dataTypeUri)
+{
+    DataType type = dataTypeId(dataTypeUri);
+    if (type != CustomDataType)
+        return withDataType(type);
+
+    QSparqlBindingInterner* interner = bindingInterner();
+    QMutexLocker locker(&interner->mutex);
+    const QUrl* interned = interner->internDataType(dataTypeUri);
+    locker.unlock();
+    if (interned == dataType)
+        return this;
+    return intern(nm, nodetype, CustomDataType, interned, lang);
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::withLanguageTag(const QString& languageTag)
+{
+    QSparqlBindingTransitionCache* cache = transitionCache();
+    const QPair<const QSparqlBindingPrivate*, QString> key(this, languageTag);
+    QSparqlBindingPrivate* target = cache->languageTags.value(key);
+    if (!target) {
+        if (cache->languageTags.count() >= QSparqlBindingTransitionCache::MaxLanguageTags)
+            cache->languageTags.clear();
+        target = internLanguageTag(languageTag);
+        cache->languageTags.insert(key, target);
+    }
+    return target;
+}
+
+QSparqlBindingPrivate* QSparqlBindingPrivate::internLanguageTag(const QString& languageTag)
+{
+    const QString* interned = 0;
+    if (!languageTag.isEmpty()) {
+        QSparqlBindingInterner* interner = bindingInterner();
+        QMutexLocker locker(&interner->mutex);
+        interned = interner->internLanguageTag(languageTag);
+    }
+    if (interned == lang)
+        return this;
+    return intern(nm, nodetype, dataTypeIdx, dataType, interned);
+}
+
 /*!
     \class QSparqlBinding
     \brief The QSparqlBinding class handles a binding between a SPARQL query variable
@@ -117,7 +400,7 @@ public:
 */
 QSparqlBinding::QSparqlBinding(const QString& name)
 {
-    d = new QSparqlBindingPrivate(name);
+    d = QSparqlBindingPrivate::named(name);
 }
 
 /*!
@@ -127,7 +410,7 @@ QSparqlBinding::QSparqlBinding(const QString& name)
 */
 QSparqlBinding::QSparqlBinding(const QString& name, const QVariant& value)
 {
-    d = new QSparqlBindingPrivate(name);
+    d = QSparqlBindingPrivate::named(name);
     setValue(value);
 }
 
@@ -136,10 +419,8 @@ QSparqlBinding::QSparqlBinding(const QString& name, const QVariant& value)
 */
 
 QSparqlBinding::QSparqlBinding(const QSparqlBinding& other)
+    : val(other.val), d(other.d)
 {
-    d = other.d;
-    d->ref.ref();
-    val = other.val;
 }
 
 /*!
@@ -148,7 +429,7 @@ QSparqlBinding::QSparqlBinding(const QSparqlBinding& other)
 
 QSparqlBinding& QSparqlBinding::operator=(const QSparqlBinding& other)
 {
-    qAtomicAssign(d, other.d);
+    d = other.d;
     val = other.val;
     return *this;
 }
@@ -175,8 +456,6 @@ bool QSparqlBinding::operator==(const QSparqlBinding& other) const
 
 QSparqlBinding::~QSparqlBinding()
 {
-    if (!d->ref.deref())
-        delete d;
 }
 
 
@@ -187,8 +466,7 @@ QSparqlBinding::~QSparqlBinding()
 */
 void QSparqlBinding::setDataTypeUri(const QUrl &dataType)
 {
-    detach();
-    d->dataType = dataType;
+    d = d->withDataType(dataType);
 }
 
 /*!
@@ -198,8 +476,7 @@ void QSparqlBinding::setDataTypeUri(const QUrl &dataType)
 */
 void QSparqlBinding::setLanguageTag(const QString &languageTag)
 {
-    detach();
-    d->lang = languageTag;
+    d = d->withLanguageTag(languageTag);
 }
 
 static int extractTimezone(QString& str)
@@ -223,75 +500,76 @@ static int extractTimezone(QString& str)
 */
 void QSparqlBinding::setValue(const QString& value, const QUrl& dataTypeUri)
 {
-    d->nodetype = QSparqlBindingPrivate::Literal;
-    QByteArray s = dataTypeUri.toString().toLatin1();
+    const QSparqlBindingPrivate::DataType type = QSparqlBindingPrivate::dataTypeId(dataTypeUri);
     bool ok = true;
 
-    if (s == "http://www.w3.org/2001/XMLSchema#int") {
-        d->dataType = *XSD::Int();
-        setValue(value.toInt(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#integer") {
-        d->dataType = *XSD::Integer();
-        setValue(value.toLongLong(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#nonNegativeInteger") {
-        d->dataType = *XSD::NonNegativeInteger();
-        setValue(value.toULongLong(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#unsignedInt") {
-        d->dataType = *XSD::UnsignedInt();
-        setValue(value.toUInt(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#decimal") {
-        d->dataType = *XSD::Decimal();
-        setValue(value.toDouble(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#short") {
-        d->dataType = *XSD::Short();
-        setValue(value.toInt(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#long") {
-        d->dataType = *XSD::Long();
-        setValue(value.toLongLong(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#unsignedLong") {
-        d->dataType = *XSD::UnsignedLong();
-        setValue(value.toULongLong(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#boolean") {
-        d->dataType = *XSD::Boolean();
-        setValue(value.toLower() == QLatin1String("true") || value.toLower() == QLatin1String("yes") || value.toInt() != 0);
-    } else if (s == "http://www.w3.org/2001/XMLSchema#double") {
-        d->dataType = *XSD::Double();
-        setValue(value.toDouble(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#float") {
-        d->dataType = *XSD::Float();
-        setValue(value.toDouble(&ok));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#string") {
-        d->dataType = *XSD::String();
-        setValue(value);
-    } else if (s == "http://www.w3.org/2001/XMLSchema#date") {
-        d->dataType = *XSD::Date();
+    switch (type) {
+    case QSparqlBindingPrivate::Int:
+        val = value.toInt(&ok);
+        break;
+    case QSparqlBindingPrivate::Integer:
+        val = value.toLongLong(&ok);
+        break;
+    case QSparqlBindingPrivate::NonNegativeInteger:
+        val = value.toULongLong(&ok);
+        break;
+    case QSparqlBindingPrivate::UnsignedInt:
+        val = value.toUInt(&ok);
+        break;
+    case QSparqlBindingPrivate::Decimal:
+        val = value.toDouble(&ok);
+        break;
+    case QSparqlBindingPrivate::Short:
+        val = value.toInt(&ok);
+        break;
+    case QSparqlBindingPrivate::Long:
+        val = value.toLongLong(&ok);
+        break;
+    case QSparqlBindingPrivate::UnsignedLong:
+        val = value.toULongLong(&ok);
+        break;
+    case QSparqlBindingPrivate::Boolean:
+        val = (value.toLower() == QLatin1String("true") || value.toLower() == QLatin1String("yes") || value.toInt() != 0);
+        break;
+    case QSparqlBindingPrivate::Double:
+    case QSparqlBindingPrivate::Float:
+        val = value.toDouble(&ok);
+        break;
+    case QSparqlBindingPrivate::Date:
+    {
         // xsd:dates can have timezones which aren't supported by QDate,
         // so convert to UTC time and use the derived date
         QString v(value);
         int adjustment = extractTimezone(v);
         QDateTime dt = QDateTime::fromString(v, Qt::ISODate);
         dt = dt.addSecs(adjustment);
-        setValue(dt.date());
-    } else if (s == "http://www.w3.org/2001/XMLSchema#time") {
-        d->dataType = *XSD::Time();
+        val = dt.date();
+        break;
+    }
+    case QSparqlBindingPrivate::Time:
+    {
         // xsd:times can have timezones which aren't supported by QTime,
         // so convert to UTC time and use that
         QString v(value);
         int adjustment = extractTimezone(v);
-        setValue(QTime::fromString(v, Qt::ISODate).addSecs(adjustment));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#dateTime") {
-        d->dataType = *XSD::DateTime();
-        setValue(QDateTime::fromString(value, Qt::ISODate));
-    } else if (s == "http://www.w3.org/2001/XMLSchema#base64Binary") {
-        d->dataType = *XSD::Base64Binary();
-        setValue(QByteArray::fromBase64(value.toLatin1()));
-    } else {
-        d->dataType = dataTypeUri;
-        setValue(value);
+        val = QTime::fromString(v, Qt::ISODate).addSecs(adjustment);
+        break;
     }
+    case QSparqlBindingPrivate::DateTime:
+        val = QDateTime::fromString(value, Qt::ISODate);
+        break;
+    case QSparqlBindingPrivate::Base64Binary:
+        val = QByteArray::fromBase64(value.toLatin1());
+        break;
+    default:
+        val = value;
+        break;
+    }
+
+    d = d->withNodeType(QSparqlBindingPrivate::Literal)->withDataType(dataTypeUri);
 
     if (!ok)
-        qWarning() << "QSparqlBinding::setValue(): Conversion error:" << value << "type:" << d->dataType.toString();
+        qWarning() << "QSparqlBinding::setValue(): Conversion error:" << value << "type:" << dataTypeUri.toString();
 }
 
 /*!
@@ -410,10 +688,10 @@ QString QSparqlBinding::toString() const
             break;
         }
 
-        if (!d->lang.isEmpty())
-            literal.append(QLatin1Char('@') + d->lang);
+        if (d->lang)
+            literal.append(QLatin1Char('@') + *d->lang);
 
-        if (!d->dataType.isEmpty()) {
+        if (d->dataType) {
             if (!quoted) {
                 literal.prepend(QLatin1String("\""));
                 literal.append(QLatin1String("\""));
@@ -444,9 +722,9 @@ void QSparqlBinding::setValue(const QVariant& value)
     val = value;
 
     if (value.type() == QVariant::Url)
-        d->nodetype = QSparqlBindingPrivate::Uri;
+        d = d->withNodeType(QSparqlBindingPrivate::Uri);
     else
-        d->nodetype = QSparqlBindingPrivate::Literal;
+        d = d->withNodeType(QSparqlBindingPrivate::Literal);
 }
 
 /*!
@@ -458,9 +736,8 @@ void QSparqlBinding::setValue(const QVariant& value)
 
 void QSparqlBinding::setBlankNodeLabel(const QString& id)
 {
-    detach();
     val = id;
-    d->nodetype = QSparqlBindingPrivate::Blank;
+    d = d->withNodeType(QSparqlBindingPrivate::Blank);
 }
 
 /*!
@@ -473,9 +750,7 @@ void QSparqlBinding::setBlankNodeLabel(const QString& id)
 void QSparqlBinding::clear()
 {
     val = QVariant();
-    d->nodetype = QSparqlBindingPrivate::Invalid;
-    d->dataType = QUrl();
-    d->lang = QString();
+    d = QSparqlBindingPrivate::named(d->nm);
 }
 
 /*!
@@ -486,8 +761,7 @@ void QSparqlBinding::clear()
 
 void QSparqlBinding::setName(const QString& name)
 {
-    detach();
-    d->nm = name;
+    d = d->withName(name);
 }
 
 /*!
@@ -520,9 +794,9 @@ QUrl QSparqlBinding::dataTypeUri() const
     if (d->nodetype != QSparqlBindingPrivate::Literal)
         return QUrl();
 
-    if (!d->dataType.isEmpty()) {
-        return d->dataType;
-    }
+    if (d->dataType)
+        return *d->dataType;
+
 
     switch (val.type()) {
     case QVariant::Int:
@@ -583,13 +857,6 @@ bool QSparqlBinding::isBlank() const
     return d->nodetype == QSparqlBindingPrivate::Blank;
 }
 
-/*! \internal
-*/
-void QSparqlBinding::detach()
-{
-    qAtomicDetach(d);
-}
-
 /*!
     Returns the binding's languageTag.
 
@@ -597,7 +864,7 @@ void QSparqlBinding::detach()
 */
 QString QSparqlBinding::languageTag() const
 {
-    return d->lang;
+    return d->lang ? *d->lang : QString();
 }
 
 
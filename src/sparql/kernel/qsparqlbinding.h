@@ -91,7 +91,6 @@ public:
     bool isValid() const;
 
 private:
-    void detach();
     QVariant val;
     QSparqlBindingPrivate* d;
 };
@@ -63,6 +63,7 @@
 #include "qsparqlqueryoptions.h"
 #include "qsparqldriver_p.h"
 #include "qsparqldriverplugin_p.h"
+#include "qsparqlpagedresult_p.h"
 #if WE_ARE_QT
 // QFactoryLoader is an internal part of Qt; we'll use it when where part of Qt
 // (or when Qt publishes it.)
@@ -74,6 +75,7 @@
 #include "qsparqlnulldriver_p.h"
 
 #include <QtCore/qhash.h>
+#include <QtCore/qiodevice.h>
 #include <QtCore/quuid.h>
 #include <QtCore/qmutex.h>
 
@@ -492,19 +494,26 @@ QSparqlResult* QSparqlConnection::exec(const  QSparqlQuery& query, const QSparql
                                     QLatin1String("Unsupported statement type"),
                                     QSparqlError::BackendError));
             qWarning() << "QSparqlConnection:" << result->lastError() << result->query();
+        } else if (options.pageSize() > 0 && query.type() == QSparqlQuery::SelectStatement
+                   && d->driver->hasFeature(AsyncExec) && QSparqlPagedResult::canPage(queryText)) {
+            // The pages are asynchronous queries also when the paged
+            // result is used synchronously
+            result = new QSparqlPagedResult(d->driver, queryText, options);
+            if (options.executionMethod() == QSparqlQueryOptions::SyncExec)
+                result->waitForFinished();
         } else {
-            if (!d->driver->hasFeature(QSparqlConnection::SyncExec) &&
-                    options.executionMethod() == QSparqlQueryOptions::SyncExec) {
-                // If the driver does not support requested synchronous execution,
-                // emulate the synchronous execution with asynchronous exec + waitForFinished
-                QSparqlQueryOptions modifiedOptions(options);
-                modifiedOptions.setExecutionMethod(QSparqlQueryOptions::AsyncExec);
-                result = d->driver->exec(queryText, query.type(), modifiedOptions);
+            QSparqlQueryOptions execOptions(options);
+            bool emulateSyncExec = !d->driver->hasFeature(QSparqlConnection::SyncExec) &&
+                    options.executionMethod() == QSparqlQueryOptions::SyncExec;
+            // If the driver does not support requested synchronous execution,
+            // emulate the synchronous execution with asynchronous exec + waitForFinished
+            if (emulateSyncExec)
+                execOptions.setExecutionMethod(QSparqlQueryOptions::AsyncExec);
+            result = d->driver->execPrepared(query, execOptions);
+            if (!result)
+                result = d->driver->exec(queryText, query.type(), execOptions);
+            if (emulateSyncExec)
                 result->waitForFinished();
-            }
-            else {
-                result = d->driver->exec(queryText, query.type(), options);
-            }
         }
     }
     result->setParent(this);
@@ -535,6 +544,138 @@ QSparqlResult* QSparqlConnection::syncExec(const QSparqlQuery& query)
     return exec(query, options);
 }
 
+/*!
+    \enum QSparqlConnection::GraphUploadMode
+
+    How uploadGraph() stores the data in the graph.
+
+    \var QSparqlConnection::GraphUploadMode QSparqlConnection::AppendToGraph
+
+    The triples are added to the graph.
+
+    \var QSparqlConnection::GraphUploadMode QSparqlConnection::ReplaceGraph
+
+    The graph is replaced by the triples.
+*/
+
+/*!
+    Starts uploading the RDF read from \a data to the \a graph of the
+    store, or to its default graph if \a graph is empty, and returns a
+    pointer to a QSparqlResult object which finishes when the upload has
+    finished. \a contentType is the MIME type of the data, for example
+    "application/n-triples" or "text/turtle". With ReplaceGraph the graph
+    is replaced by the data, with AppendToGraph the triples are added to it.
+
+    The data is read as it is sent, so that it doesn't have to fit in the
+    memory. The progress of the upload is reported by the
+    QSparqlResult::uploadProgress() signal. \a data must be open for
+    reading and stay valid until the result has finished.
+
+    Only the drivers which have the GraphUpload feature support uploads;
+    for the other drivers the result is in the error state.
+
+    \sa \ref endpointspecific "QSPARQL_ENDPOINT specific usage"
+*/
+QSparqlResult* QSparqlConnection::uploadGraph(QIODevice* data, const QString& contentType,
+                                              const QUrl& graph, GraphUploadMode mode)
+{
+    QSparqlResult* result = d->checkErrors(graph.isEmpty() ? QString::fromLatin1("default graph")
+                                                           : graph.toString());
+    if (!result) {
+        if (!d->driver->hasFeature(GraphUpload)) {
+            result = new QSparqlNullResult();
+            result->setLastError(QSparqlError(
+                                    QLatin1String("Graph uploads not supported"),
+                                    QSparqlError::BackendError));
+            qWarning() << "QSparqlConnection:" << result->lastError();
+        } else if (!data || !data->isReadable()) {
+            result = new QSparqlNullResult();
+            result->setLastError(QSparqlError(
+                                    QLatin1String("Upload data is not readable"),
+                                    QSparqlError::StatementError));
+            qWarning() << "QSparqlConnection:" << result->lastError();
+        } else {
+            result = d->driver->uploadGraph(data, contentType, graph, mode);
+        }
+    }
+    result->setParent(this);
+    return result;
+}
+
+/*!
+    Sends any update queries the driver has queued to the backend
+    immediately, instead of waiting for the driver to send them later.
+
+    Only the QTRACKER driver queues update queries, and only when the
+    "batchWindow" connection option is set. For other drivers this function
+    does nothing.
+
+    \sa \ref connectionoptions "Connection options supported by drivers"
+*/
+void QSparqlConnection::flush()
+{
+    d->driver->flush();
+}
+
+/*!
+    Begins a transaction on the connection. The update queries made with the
+    connection until commit() or rollback() is called are stored together
+    when commit() is called, or discarded by rollback(). Returns true if the
+    transaction was started, otherwise returns false.
+
+    Only the drivers which have the Transactions feature support
+    transactions; for the other drivers this function prints a warning and
+    returns false, and the queries are stored as they are executed.
+
+    \sa QSparqlTransaction, hasFeature()
+*/
+bool QSparqlConnection::transaction()
+{
+    if (!d->driver->hasFeature(Transactions)) {
+        qWarning() << "QSparqlConnection::transaction: the driver doesn't support transactions";
+        return false;
+    }
+    if (d->driver->isOpenError() || !d->driver->isOpen()) {
+        qWarning() << "QSparqlConnection::transaction: connection not open";
+        return false;
+    }
+    return d->driver->beginTransaction();
+}
+
+/*!
+    Commits the transaction begun with transaction(). The queries made
+    during the transaction which are still running are finished first.
+    Returns true if the transaction was committed, otherwise returns false;
+    the error can be read with lastError().
+
+    \sa rollback()
+*/
+bool QSparqlConnection::commit()
+{
+    if (!d->driver->hasFeature(Transactions)) {
+        qWarning() << "QSparqlConnection::commit: the driver doesn't support transactions";
+        return false;
+    }
+    return d->driver->commitTransaction();
+}
+
+/*!
+    Discards the changes made during the transaction begun with
+    transaction(). The queries made during the transaction which are still
+    running are finished first. Returns true if the transaction was rolled
+    back, otherwise returns false; the error can be read with lastError().
+
+    \sa commit()
+*/
+bool QSparqlConnection::rollback()
+{
+    if (!d->driver->hasFeature(Transactions)) {
+        qWarning() << "QSparqlConnection::rollback: the driver doesn't support transactions";
+        return false;
+    }
+    return d->driver->rollbackTransaction();
+}
+
 /*!
     Returns the connection's driver name.
 */
@@ -584,6 +725,14 @@ QString QSparqlConnection::driverName() const
     not supporting AsyncExec, QSparqlConnection::exec() will create a thread for
     executing the query synchronously.
 
+    \var QSparqlConnection::Feature QSparqlConnection::GraphUpload
+
+    The connection can upload RDF data to a graph with uploadGraph().
+
+    \var QSparqlConnection::Feature QSparqlConnection::Transactions
+
+    The connection supports transactions, see transaction().
+
     \sa hasFeature()
 */
 
@@ -630,6 +779,35 @@ bool QSparqlConnection::isValid() const
     return d->driver && d->driver != d->shared_null()->driver;
 }
 
+/*!
+    Returns the statistics the driver keeps about its work, as a map from
+    the name of each statistic to its value. The contents depend on the
+    driver; drivers which don't keep statistics return an empty map.
+
+    The QSPARQL_ENDPOINT driver returns the following values for its request
+    scheduler:
+    - "queuedRequests" (int), the number of requests waiting for a free slot
+    - "inFlightRequests" (int), the number of requests sent to the endpoints
+    - "startedRequests" (qlonglong), the number of requests sent so far
+    - "totalQueueTime" and "maxQueueTime" (qlonglong), the total and the
+      longest time in milliseconds the requests have waited in the queue
+    - "hosts" (QVariantMap), the same values for each host separately
+    - "networkThread" (QVariantMap), the same values for the queries run in
+      the network thread of the driver, once it has been started
+
+    When the connection has a network cache, it also returns:
+    - "cacheHits" and "cacheMisses" (qlonglong), the number of replies
+      served from the cache and from the network
+    - "cacheSize" and "maximumCacheSize" (qlonglong), the current and the
+      maximum size of the cache in bytes
+
+    \sa \ref connectionoptions "Connection options supported by drivers"
+*/
+QVariantMap QSparqlConnection::statistics() const
+{
+    return d->driver->statistics();
+}
+
 /*!
     Adds a prefix/uri pair to the connection. Each SPARQL query made
     with the connection will have the prefixes prepended to it.
@@ -721,6 +899,84 @@ QStringList QSparqlConnection::drivers()
     return list;
 }
 
+/*!
+    \class QSparqlTransaction
+
+    \brief The QSparqlTransaction class runs the queries of a scope in a
+    transaction.
+
+    The constructor begins a transaction on the connection, and the
+    destructor rolls it back unless commit() has been called. This way a
+    transaction isn't left open when a function returns early:
+
+    \code
+    QSparqlTransaction transaction(&conn);
+    foreach (const QSparqlQuery& insert, inserts) {
+        QSparqlResult* r = conn.syncExec(insert);
+        if (r->hasError())
+            return false; // the inserts are rolled back
+        delete r;
+    }
+    return transaction.commit();
+    \endcode
+
+    \sa QSparqlConnection::transaction()
+*/
+
+/*!
+    Begins a transaction on \a connection. Use isActive() to check whether
+    the transaction was started.
+*/
+QSparqlTransaction::QSparqlTransaction(QSparqlConnection* connection)
+    : connection(connection), active(connection->transaction())
+{
+}
+
+/*!
+    Rolls the transaction back if it hasn't been committed or rolled back.
+*/
+QSparqlTransaction::~QSparqlTransaction()
+{
+    if (active)
+        connection->rollback();
+}
+
+/*!
+    Returns true if the transaction has been started and hasn't been
+    committed or rolled back yet.
+*/
+bool QSparqlTransaction::isActive() const
+{
+    return active;
+}
+
+/*!
+    Commits the transaction. Returns true if it was committed, otherwise
+    returns false, and the transaction is rolled back when the object is
+    destroyed.
+*/
+bool QSparqlTransaction::commit()
+{
+    if (!active)
+        return false;
+    if (!connection->commit())
+        return false;
+    active = false;
+    return true;
+}
+
+/*!
+    Rolls the transaction back. Returns true if it was rolled back,
+    otherwise returns false.
+*/
+bool QSparqlTransaction::rollback()
+{
+    if (!active)
+        return false;
+    active = false;
+    return connection->rollback();
+}
+
 #ifndef QT_NO_DEBUG_STREAM
 // LCOV_EXCL_START
 QDebug operator<<(QDebug dbg, const QSparqlConnection &d)
@@ -50,6 +50,7 @@
 #include <qsparqlbinding.h>
 
 #include <QtCore/qstring.h>
+#include <QtCore/qvariant.h>
 #include <QDebug>
 QT_BEGIN_HEADER
 
@@ -63,6 +64,7 @@ class QSparqlResult;
 class QSparqlConnectionPrivate;
 class QSparqlQueryOptions;
 class SparqlConnection;
+class QIODevice;
 
 class Q_SPARQL_EXPORT QSparqlConnection : public QObject
 {
@@ -70,9 +72,11 @@ class Q_SPARQL_EXPORT QSparqlConnection : public QObject
 public:
     enum Feature {  QuerySize, DefaultGraph,
                     AskQueries, ConstructQueries, UpdateQueries,
-                    SyncExec, AsyncExec };
+                    SyncExec, AsyncExec, GraphUpload, Transactions };
     // TODO: QuerySize should be removed (API break).
 
+    enum GraphUploadMode { AppendToGraph, ReplaceGraph };
+
     explicit QSparqlConnection(QObject* parent = 0);
     QSparqlConnection(const QString& type,
                       const QSparqlConnectionOptions& options = QSparqlConnectionOptions(),
@@ -82,12 +86,20 @@ public:
     QSparqlResult* exec(const QSparqlQuery& query);
     QSparqlResult* exec(const  QSparqlQuery& query, const QSparqlQueryOptions& options);
     QSparqlResult* syncExec(const QSparqlQuery& query);
+    QSparqlResult* uploadGraph(QIODevice* data, const QString& contentType,
+                               const QUrl& graph = QUrl(), GraphUploadMode mode = AppendToGraph);
+    void flush();
+
+    bool transaction();
+    bool commit();
+    bool rollback();
 
     bool isValid() const;
     QString driverName() const;
     bool hasFeature(Feature feature) const;
     bool hasError() const;
     QSparqlError lastError() const;
+    QVariantMap statistics() const;
 
     void addPrefix(const QString& prefix, const QUrl& uri);
     void clearPrefixes();
@@ -107,6 +119,22 @@ private:
 };
 // TODO: make "validness" of a connection a QObject property
 
+class Q_SPARQL_EXPORT QSparqlTransaction
+{
+public:
+    explicit QSparqlTransaction(QSparqlConnection* connection);
+    ~QSparqlTransaction();
+
+    bool isActive() const;
+    bool commit();
+    bool rollback();
+
+private:
+    Q_DISABLE_COPY(QSparqlTransaction)
+    QSparqlConnection* connection;
+    bool active;
+};
+
 #ifndef QT_NO_DEBUG_STREAM
 Q_SPARQL_EXPORT QDebug operator<<(QDebug, const QSparqlConnection &);
 #endif
@@ -225,6 +225,71 @@ bool QSparqlDriver::rollbackTransaction()
 {
     return false;
 }
+
+/*!
+    This function is called to send any statements the driver has queued
+    to the backend immediately. The default implementation does nothing,
+    since most drivers don't queue statements.
+
+    \sa QSparqlConnection::flush()
+*/
+
+void QSparqlDriver::flush()
+{
+}
+
+/*!
+    Returns the statistics the driver keeps about its work, such as timings
+    and counters. The default implementation returns an empty map.
+
+    \sa QSparqlConnection::statistics()
+*/
+
+QVariantMap QSparqlDriver::statistics() const
+{
+    return QVariantMap();
+}
+
+/*!
+    Executes the \a query with its bound values passed to the backend
+    separately from the query text, so that the backend can reuse the
+    compiled query for other values. The query execution is controlled by
+    \a options.
+
+    Drivers which support this reimplement this function. The default
+    implementation returns 0, and the query is executed with exec() with
+    the values inserted into the query text.
+
+    \sa QSparqlQuery::bindValue()
+*/
+
+QSparqlResult* QSparqlDriver::execPrepared(const QSparqlQuery& query, const QSparqlQueryOptions& options)
+{
+    Q_UNUSED(query);
+    Q_UNUSED(options);
+    return 0;
+}
+
+/*!
+    Starts uploading the RDF in \a data, of the MIME type \a contentType,
+    to the \a graph, or to the default graph if \a graph is empty. With
+    QSparqlConnection::ReplaceGraph the graph is replaced by the data.
+
+    Drivers which have the QSparqlConnection::GraphUpload feature
+    reimplement this function. The default implementation returns 0.
+
+    \sa QSparqlConnection::uploadGraph()
+*/
+
+QSparqlResult* QSparqlDriver::uploadGraph(QIODevice* data, const QString& contentType, const QUrl& graph,
+                                          QSparqlConnection::GraphUploadMode mode)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(contentType);
+    Q_UNUSED(graph);
+    Q_UNUSED(mode);
+    return 0;
+}
 // LCOV_EXCL_STOP
 /*!
     This function is used to set the value of the last error, \a error,
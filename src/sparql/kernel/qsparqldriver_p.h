@@ -49,6 +49,7 @@
 #include <QtCore/qobject.h>
 #include <QtCore/qstring.h>
 #include <QtCore/qstringlist.h>
+#include <QtCore/qvariant.h>
 
 
 QT_BEGIN_HEADER
@@ -62,6 +63,7 @@ class QSparqlError;
 class QSparqlQueryOptions;
 class QSparqlResult;
 class QVariant;
+class QIODevice;
 
 class Q_SPARQL_EXPORT QSparqlDriver : public QObject
 {
@@ -77,6 +79,11 @@ public:
     virtual bool commitTransaction();
     virtual bool rollbackTransaction();
 
+    virtual void flush();
+    virtual QVariantMap statistics() const;
+    virtual QSparqlResult* uploadGraph(QIODevice* data, const QString& contentType, const QUrl& graph,
+                                       QSparqlConnection::GraphUploadMode mode);
+
     QSparqlError lastError() const;
 
     virtual QVariant handle() const;
@@ -84,6 +91,7 @@ public:
     virtual bool hasError() const = 0;
     virtual void close() = 0;
     virtual QSparqlResult* exec(const QString& query, QSparqlQuery::StatementType type, const QSparqlQueryOptions& options) = 0;
+    virtual QSparqlResult* execPrepared(const QSparqlQuery& query, const QSparqlQueryOptions& options);
 
     virtual bool open(const QSparqlConnectionOptions& options = QSparqlConnectionOptions()) = 0;
 
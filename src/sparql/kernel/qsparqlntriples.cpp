@@ -264,7 +264,7 @@ QSparqlBinding QSparqlNTriples::parseLiteral(QString name)
 
 QSparqlResultRow QSparqlNTriples::parseStatement() 
 {
-    QSparqlResultRow resultRow;
+    QSparqlResultRow resultRow(schema);
     
     skipWhiteSpace();
     if (i >= buffer.size())
@@ -312,6 +312,8 @@ QSparqlResultRow QSparqlNTriples::parseStatement()
         parseError(QLatin1String("Expected '.' as statement terminator"));
     }
     
+    if (schema.isEmpty() && resultRow.count() == 3)
+        schema = resultRow.schema();
     skipWhiteSpace();        
     return resultRow;
 }
@@ -336,4 +338,28 @@ QVector<QSparqlResultRow> QSparqlNTriples::parse()
     return results;
 }
 
+QVector<QSparqlResultRow> QSparqlNTriples::parseChunk(const QByteArray &chunk)
+{
+    partialLine.append(chunk);
+    const int end = qMax(partialLine.lastIndexOf('\n'), partialLine.lastIndexOf('\r'));
+    if (end == -1)
+        return QVector<QSparqlResultRow>();
+
+    // Only the complete lines are parsed, the rest waits for the next chunk
+    buffer = partialLine.left(end + 1);
+    partialLine.remove(0, end + 1);
+    i = 0;
+    results.clear();
+    return parse();
+}
+
+QVector<QSparqlResultRow> QSparqlNTriples::finish()
+{
+    buffer = partialLine;
+    partialLine.clear();
+    i = 0;
+    results.clear();
+    return parse();
+}
+
 QT_END_NAMESPACE
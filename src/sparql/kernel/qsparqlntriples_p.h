@@ -64,6 +64,7 @@ QT_MODULE(Sparql)
 
 class Q_SPARQL_EXPORT QSparqlNTriples {
 public:
+    QSparqlNTriples() : i(0), lineNumber(1) {}
     QSparqlNTriples(QByteArray &b) : buffer(b), i(0), lineNumber(1) {}
     
     void parseError(QString message);
@@ -77,10 +78,19 @@ public:
     QSparqlResultRow parseStatement();
     QVector<QSparqlResultRow> parse();
 
+    // Incremental parsing: every call to parseChunk() returns the triples
+    // on the complete lines read so far, and finish() the triple on the
+    // last line, if it didn't end with a newline
+    QVector<QSparqlResultRow> parseChunk(const QByteArray &chunk);
+    QVector<QSparqlResultRow> finish();
+
     QByteArray buffer;
+    QByteArray partialLine;
     int i;
     int lineNumber;
     QVector<QSparqlResultRow> results;
+    // The s, p and o columns, shared by all the statements
+    QSparqlResultRowSchema schema;
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,292 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (ivan.frade@nokia.com)
+**
+** This file is part of the QtSparql module (not yet part of the Qt Toolkit).
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation and
+** appearing in the file LICENSE.LGPL included in the packaging of this
+** file. Please review the following information to ensure the GNU Lesser
+** General Public License version 2.1 requirements will be met:
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain additional
+** rights. These rights are described in the Nokia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** Other Usage
+** Alternatively, this file may be used in accordance with the terms and
+** conditions contained in a signed written agreement between you and Nokia.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at ivan.frade@nokia.com.
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qsparqlpagedresult_p.h"
+#include "qsparqldriver_p.h"
+#include "qsparqlerror.h"
+#include "qsparqlbinding.h"
+
+#include <QtCore/qpointer.h>
+#include <QtCore/qregexp.h>
+#include <QtCore/qdebug.h>
+
+#include <limits.h>
+
+QT_BEGIN_NAMESPACE
+
+QSparqlPagedResult::QSparqlPagedResult(QSparqlDriver *drv, const QString &query,
+                                       const QSparqlQueryOptions &options)
+    : driver(drv), pageOptions(options), pageSize(options.pageSize()),
+      maxPages(qMax(1, options.maxConcurrentPages())), nextPage(0), appendPage(0),
+      lastPage(-1), finishedFlag(false)
+{
+    setQuery(query);
+    setStatementType(QSparqlQuery::SelectStatement);
+
+    // The pages are ordinary asynchronous queries of the driver
+    pageOptions.setPageSize(0);
+    pageOptions.setExecutionMethod(QSparqlQueryOptions::AsyncExec);
+    startPages();
+}
+
+QSparqlPagedResult::~QSparqlPagedResult()
+{
+    // The pages still in flight are children of this result
+}
+
+// Letters, digits and the characters which can start or join a variable or a
+// prefixed name, so that ?values or ex:values isn't taken for the keyword
+static inline bool isNameChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == QLatin1Char('_') || c == QLatin1Char('?')
+        || c == QLatin1Char('$') || c == QLatin1Char(':');
+}
+
+// Returns true if the query ends with a VALUES block, outside of the
+// braces of the WHERE clause. The strings, IRIs and comments are skipped.
+static bool hasTrailingValues(const QString &query)
+{
+    int depth = 0;
+    const int length = query.length();
+    for (int i = 0; i < length; ++i) {
+        const QChar c = query.at(i);
+        if (c == QLatin1Char('{')) {
+            ++depth;
+        } else if (c == QLatin1Char('}')) {
+            --depth;
+        } else if (c == QLatin1Char('#')) {
+            while (i < length && query.at(i) != QLatin1Char('\n'))
+                ++i;
+        } else if (c == QLatin1Char('"') || c == QLatin1Char('\'')) {
+            for (++i; i < length && query.at(i) != c; ++i) {
+                if (query.at(i) == QLatin1Char('\\'))
+                    ++i;
+            }
+        } else if (c == QLatin1Char('<')) {
+            // An IRI has no spaces, unlike a comparison
+            int end = i + 1;
+            while (end < length && query.at(end) != QLatin1Char('>') && !query.at(end).isSpace())
+                ++end;
+            if (end < length && query.at(end) == QLatin1Char('>'))
+                i = end;
+        } else if (depth == 0 && (c == QLatin1Char('V') || c == QLatin1Char('v'))
+                   && query.midRef(i, 6).compare(QLatin1String("VALUES"), Qt::CaseInsensitive) == 0
+                   && (i == 0 || !isNameChar(query.at(i - 1)))
+                   && (i + 6 == length || !isNameChar(query.at(i + 6)))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A query which has a LIMIT or OFFSET of its own is run as such. So is a
+// query ending with a VALUES block, since LIMIT and OFFSET would have to go
+// before it.
+bool QSparqlPagedResult::canPage(const QString &query)
+{
+    return !query.contains(QRegExp(QLatin1String("\\b(LIMIT|OFFSET)\\b"), Qt::CaseInsensitive))
+        && !hasTrailingValues(query);
+}
+
+void QSparqlPagedResult::startPages()
+{
+    while (!finishedFlag && running.count() < maxPages && lastPage < 0) {
+        const int index = nextPage++;
+        // On a line of its own, so that a comment at the end of the query
+        // doesn't hide it
+        const QString pageQuery = query()
+            + QString::fromLatin1("\nLIMIT %1 OFFSET %2").arg(pageSize).arg(qint64(index) * pageSize);
+
+        QSparqlResult *page = driver->exec(pageQuery, QSparqlQuery::SelectStatement, pageOptions);
+        page->setParent(this);
+        running.insert(page, index);
+        connect(page, SIGNAL(finished()), this, SLOT(pageFinished()));
+
+        // A page which failed at once doesn't emit finished(); it's handled
+        // when the caller has had the chance to connect to the signals
+        if (page->isFinished() || page->hasError())
+            QMetaObject::invokeMethod(this, "checkPages", Qt::QueuedConnection);
+    }
+}
+
+void QSparqlPagedResult::pageFinished()
+{
+    QSparqlResult *page = qobject_cast<QSparqlResult *>(sender());
+    if (page)
+        pageDone(page);
+}
+
+void QSparqlPagedResult::checkPages()
+{
+    foreach (QSparqlResult *page, running.keys()) {
+        if (running.contains(page) && (page->isFinished() || page->hasError()))
+            pageDone(page);
+    }
+}
+
+void QSparqlPagedResult::pageDone(QSparqlResult *page)
+{
+    QHash<QSparqlResult *, int>::iterator it = running.find(page);
+    if (it == running.end())
+        return;
+    const int index = it.value();
+    running.erase(it);
+    page->deleteLater();
+    if (finishedFlag)
+        return;
+
+    if (page->hasError()) {
+        setLastError(page->lastError());
+        qWarning() << "QSparqlPagedResult:" << lastError() << query();
+        terminate();
+        return;
+    }
+
+    QVector<QSparqlResultRow> pageRows;
+    while (page->next())
+        pageRows.append(page->current());
+
+    // The first page which isn't full is the last one; the pages after it
+    // are empty
+    if (pageRows.count() < pageSize && (lastPage < 0 || index < lastPage)) {
+        lastPage = index;
+        QMap<int, QVector<QSparqlResultRow> >::iterator later = arrived.upperBound(lastPage);
+        while (later != arrived.end())
+            later = arrived.erase(later);
+    }
+    if (lastPage < 0 || index <= lastPage)
+        arrived.insert(index, pageRows);
+
+    // The rows are only published in order
+    const int count = rows.count();
+    while (arrived.contains(appendPage)) {
+        rows += arrived.take(appendPage);
+        ++appendPage;
+    }
+    if (rows.count() > count)
+        Q_EMIT dataReady(rows.count());
+
+    if (lastPage >= 0 && appendPage > lastPage)
+        terminate();
+    else
+        startPages();
+}
+
+void QSparqlPagedResult::terminate()
+{
+    if (finishedFlag)
+        return;
+    finishedFlag = true;
+
+    // The pages after the last one, or after a failed one, aren't needed
+    foreach (QSparqlResult *page, running.keys())
+        page->deleteLater();
+    running.clear();
+    arrived.clear();
+    Q_EMIT finished();
+}
+
+void QSparqlPagedResult::waitForFinished()
+{
+    // The pages are waited for in order; the ones after them are started
+    // as the earlier ones finish
+    while (!finishedFlag) {
+        QSparqlResult *first = 0;
+        int firstIndex = INT_MAX;
+        QHash<QSparqlResult *, int>::const_iterator it;
+        for (it = running.constBegin(); it != running.constEnd(); ++it) {
+            if (it.value() < firstIndex) {
+                first = it.key();
+                firstIndex = it.value();
+            }
+        }
+        if (!first)
+            break;
+
+        QPointer<QSparqlResult> page(first);
+        page->waitForFinished();
+        if (!page || !running.contains(page))
+            continue;
+        if (!page->isFinished() && !page->hasError()) {
+            setLastError(QSparqlError(QLatin1String("Query page did not finish"),
+                                      QSparqlError::BackendError));
+            terminate();
+            break;
+        }
+        pageDone(page);
+    }
+}
+
+bool QSparqlPagedResult::isFinished() const
+{
+    return finishedFlag;
+}
+
+int QSparqlPagedResult::size() const
+{
+    return rows.count();
+}
+
+bool QSparqlPagedResult::hasFeature(QSparqlResult::Feature feature) const
+{
+    return feature == QSparqlResult::QuerySize;
+}
+
+QSparqlResultRow QSparqlPagedResult::current() const
+{
+    if (!isValid())
+        return QSparqlResultRow();
+    return rows[pos()];
+}
+
+QSparqlBinding QSparqlPagedResult::binding(int i) const
+{
+    if (!isValid())
+        return QSparqlBinding();
+    return rows[pos()].binding(i);
+}
+
+QVariant QSparqlPagedResult::value(int i) const
+{
+    if (!isValid())
+        return QVariant();
+    return rows[pos()].value(i);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (ivan.frade@nokia.com)
+**
+** This file is part of the QtSparql module (not yet part of the Qt Toolkit).
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation and
+** appearing in the file LICENSE.LGPL included in the packaging of this
+** file. Please review the following information to ensure the GNU Lesser
+** General Public License version 2.1 requirements will be met:
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain additional
+** rights. These rights are described in the Nokia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** Other Usage
+** Alternatively, this file may be used in accordance with the terms and
+** conditions contained in a signed written agreement between you and Nokia.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at ivan.frade@nokia.com.
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QSPARQLPAGEDRESULT_P_H
+#define QSPARQLPAGEDRESULT_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  This header file may
+// change from version to version without notice, or even be
+// removed.
+//
+// We mean it.
+//
+
+#include <qsparqlresult.h>
+#include <qsparqlqueryoptions.h>
+
+#include <QtCore/qhash.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QSparqlDriver;
+
+// Runs a SELECT query as LIMIT / OFFSET pages, several of them at a time,
+// through the asynchronous exec() of the driver. The pages are appended to
+// the rows in order, and dataReady() is emitted whenever the next page in
+// order has arrived.
+class QSparqlPagedResult : public QSparqlResult
+{
+    Q_OBJECT
+public:
+    QSparqlPagedResult(QSparqlDriver *driver, const QString &query,
+                       const QSparqlQueryOptions &options);
+    ~QSparqlPagedResult();
+
+    static bool canPage(const QString &query);
+
+    QSparqlResultRow current() const;
+    QSparqlBinding binding(int i) const;
+    QVariant value(int i) const;
+    int size() const;
+    void waitForFinished();
+    bool isFinished() const;
+    bool hasFeature(QSparqlResult::Feature feature) const;
+
+private Q_SLOTS:
+    void pageFinished();
+    void checkPages();
+
+private:
+    void startPages();
+    void pageDone(QSparqlResult *page);
+    void terminate();
+
+    QSparqlDriver *driver;
+    QSparqlQueryOptions pageOptions;
+    int pageSize;
+    int maxPages;
+    QHash<QSparqlResult *, int> running;    // the pages in flight
+    QMap<int, QVector<QSparqlResultRow> > arrived;  // pages out of order
+    QVector<QSparqlResultRow> rows;
+    int nextPage;       // the next page to start
+    int appendPage;     // the next page to append to the rows
+    int lastPage;       // the first page which wasn't full, -1 if not known
+    bool finishedFlag;
+};
+
+QT_END_NAMESPACE
+
+#endif // QSPARQLPAGEDRESULT_P_H
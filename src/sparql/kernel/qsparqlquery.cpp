@@ -38,6 +38,7 @@
 ****************************************************************************/
 
 #include "qsparqlquery.h"
+#include "qsparqlquery_p.h"
 
 #include "qsparqlresultrow.h"
 #include "qsparqlbinding.h"
@@ -45,6 +46,7 @@
 //#define QT_DEBUG_SQL
 
 #include "qatomic.h"
+#include "qlist.h"
 #include "qvector.h"
 #include "qmap.h"
 #include "qdebug.h"
@@ -310,6 +312,45 @@ QString QSparqlQuery::preparedQueryText() const
     return result;
 }
 
+/*!
+    \internal
+
+    Replaces the placeholders of \a query with the parameter markers of a
+    driver which passes the bound values to the backend separately from the
+    query text. The \a marker function returns the text replacing a
+    placeholder bound to a value; the value is then appended to \a
+    parameters in the order of the markers in the returned query. If \a
+    marker returns an empty string, the value is inserted in the query like
+    in QSparqlQuery::preparedQueryText().
+*/
+
+QString QSparqlParametrizedQuery::queryText(const QSparqlQuery& query, ParameterMarker marker,
+                                            QList<QSparqlBinding>* parameters)
+{
+    const QSharedDataPointer<QSparqlQueryPrivate>& d = query.d;
+    QString result(d->query);
+    parameters->clear();
+    // Iterated in the reverse order like in preparedQueryText(), so the
+    // parameters are prepended
+    for (int i = d->holders.count() - 1; i >= 0; --i) {
+        const QString holder = d->holders.at(i).holderName;
+        int ix = d->indexes.value(holder, -1);
+        if (ix == -1) {
+            qWarning() << "QSparql: Placeholder" << holder << "not replaced";
+            continue;
+        }
+        QSparqlBinding binding = d->values.value(ix);
+        QString text = marker(binding);
+        if (text.isEmpty())
+            text = binding.toString();
+        else
+            parameters->prepend(binding);
+        result = result.replace(d->holders.at(i).holderPos,
+                                holder.length() + 2, text);
+    }
+    return result;
+}
+
 /*!
   Set the placeholder \a placeholder to be bound to value \a val in the
   query. Note that the placeholder mark (\c ?: or \c $:) must not be included
@@ -89,6 +89,7 @@ public:
     QString preparedQueryText() const;
 
 private:
+    friend class QSparqlParametrizedQuery;
     QSharedDataPointer<QSparqlQueryPrivate> d;
 };
 
@@ -53,6 +53,8 @@ public:
     QSparqlQueryOptions::Priority priority;
     bool forwardOnly;
     bool fireAndForget;
+    int pageSize;
+    int maxConcurrentPages;
 };
 
 QSparqlQueryOptionsPrivate::QSparqlQueryOptionsPrivate()
@@ -61,13 +63,17 @@ QSparqlQueryOptionsPrivate::QSparqlQueryOptionsPrivate()
     , priority(QSparqlQueryOptions::NormalPriority)
     , forwardOnly(false)
     , fireAndForget(false)
+    , pageSize(0)
+    , maxConcurrentPages(4)
 {
 }
 
 bool QSparqlQueryOptionsPrivate::operator==(const QSparqlQueryOptionsPrivate& other) const
 {
     return (executionMethod == other.executionMethod &&
-            priority == other.priority);
+            priority == other.priority &&
+            pageSize == other.pageSize &&
+            maxConcurrentPages == other.maxConcurrentPages);
 }
 
 /*!
@@ -141,8 +147,10 @@ QSparqlQueryOptions::ExecutionMethod QSparqlQueryOptions::executionMethod() cons
 
 /*!
     Sets whether or not to execute asynchronous queries in a ForwardOnly manner.
-    Support for this option is currently limited to the QTRACKER_DIRECT driver.
-    \sa \ref trackerdirectspecific "QTRACKER_DIRECT specific usage"
+    Support for this option is currently limited to the QTRACKER_DIRECT driver,
+    and to synchronous queries of the QSPARQL_ENDPOINT driver.
+    \sa \ref trackerdirectspecific "QTRACKER_DIRECT specific usage",
+    \ref endpointspecific "QSPARQL_ENDPOINT specific usage"
 */
 void QSparqlQueryOptions::setForwardOnly(bool forward)
 {
@@ -207,4 +215,56 @@ QSparqlQueryOptions::Priority QSparqlQueryOptions::priority() const
     return d->priority;
 }
 
+/*!
+    Sets the number of \a rows in each page of a paged SELECT query. When
+    the page size is greater than 0, a SELECT query is executed as pages of
+    \c LIMIT \a rows with increasing \c OFFSET, several of them at the
+    same time, and the rows of the pages are returned in one QSparqlResult
+    in the order of the pages. QSparqlResult::dataReady() is emitted when
+    the next page in order has arrived, and the pages stop at the first one
+    which has fewer rows than the page size.
+
+    The query should have an \c ORDER \c BY clause, as otherwise the
+    endpoint doesn't need to return the solutions in the same order for
+    each page. Queries which have a \c LIMIT or \c OFFSET of their own are
+    not paged. Paging works with the drivers which support
+    QSparqlConnection::AsyncExec. The default page size is 0, no paging.
+
+    \sa pageSize(), setMaxConcurrentPages()
+*/
+void QSparqlQueryOptions::setPageSize(int rows)
+{
+    d->pageSize = rows;
+}
+
+/*!
+    Returns the number of rows in each page of a paged SELECT query, or 0
+    if the query isn't paged.
+    \sa setPageSize()
+*/
+int QSparqlQueryOptions::pageSize() const
+{
+    return d->pageSize;
+}
+
+/*!
+    Sets the number of \a pages of a paged SELECT query which are executed
+    at the same time. The default is 4.
+    \sa setPageSize()
+*/
+void QSparqlQueryOptions::setMaxConcurrentPages(int pages)
+{
+    d->maxConcurrentPages = pages;
+}
+
+/*!
+    Returns the number of pages of a paged SELECT query which are executed
+    at the same time.
+    \sa setMaxConcurrentPages()
+*/
+int QSparqlQueryOptions::maxConcurrentPages() const
+{
+    return d->maxConcurrentPages;
+}
+
 QT_END_NAMESPACE
@@ -88,6 +88,11 @@ public:
     void setPriority(Priority p);
     Priority priority() const;
 
+    void setPageSize(int rows);
+    int pageSize() const;
+    void setMaxConcurrentPages(int pages);
+    int maxConcurrentPages() const;
+
 private:
     QSharedDataPointer<QSparqlQueryOptionsPrivate> d;
 };
@@ -650,6 +650,15 @@ bool QSparqlResult::hasFeature(QSparqlResult::Feature) const
     data or when there was an error.
 */
 
+/*!
+    \fn void QSparqlResult::uploadProgress(qint64 bytesSent, qint64 bytesTotal)
+
+    This signal is emitted by the results of QSparqlConnection::uploadGraph()
+    as the data is sent. \a bytesSent is the amount of data read and sent
+    so far, and \a bytesTotal the size of the whole data, or -1 if the size
+    isn't known, as for sequential devices.
+*/
+
 /*!
     \fn void QSparqlResult::dataReady(int totalRows)
 
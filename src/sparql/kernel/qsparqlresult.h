@@ -114,6 +114,7 @@ public:
 Q_SIGNALS:
     void dataReady(int totalCount);
     void finished();
+    void uploadProgress(qint64 bytesSent, qint64 bytesTotal);
 
 protected:
     QSparqlResult();
@@ -45,29 +45,220 @@
 #include "qsparqlbinding.h"
 #include "qstring.h"
 #include "qvector.h"
+#include "qhash.h"
 
 QT_BEGIN_NAMESPACE
 
+class QSparqlResultRowSchemaPrivate
+{
+public:
+    QSparqlResultRowSchemaPrivate();
+    QSparqlResultRowSchemaPrivate(const QSparqlResultRowSchemaPrivate &other, int count);
+
+    void append(const QString &name);
+
+    inline bool isShared() const
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+        return ref.load() != 1;
+#else
+        return ref != 1;
+#endif
+    }
+
+    QVector<QString> names;
+    // The first column of each name, which is what indexOf() returns
+    QHash<QString, int> columns;
+    QAtomicInt ref;
+};
+
+QSparqlResultRowSchemaPrivate::QSparqlResultRowSchemaPrivate()
+{
+    ref = 1;
+}
+
+QSparqlResultRowSchemaPrivate::QSparqlResultRowSchemaPrivate(const QSparqlResultRowSchemaPrivate &other,
+                                                             int count)
+{
+    ref = 1;
+    names.reserve(count);
+    for (int i = 0; i < count; ++i)
+        append(other.names.at(i));
+}
+
+void QSparqlResultRowSchemaPrivate::append(const QString &name)
+{
+    if (!columns.contains(name))
+        columns.insert(name, names.count());
+    names.append(name);
+}
+
+// The schemas can be null, for the rows without any columns
+static inline void qSchemaRef(QSparqlResultRowSchemaPrivate *schema)
+{
+    if (schema)
+        schema->ref.ref();
+}
+
+static inline void qSchemaDeref(QSparqlResultRowSchemaPrivate *schema)
+{
+    if (schema && !schema->ref.deref())
+        delete schema;
+}
+
 class QSparqlResultRowPrivate
 {
 public:
     QSparqlResultRowPrivate();
     QSparqlResultRowPrivate(const QSparqlResultRowPrivate &other);
+    ~QSparqlResultRowPrivate();
 
     inline bool contains(int index) { return index >= 0 && index < bindings.count(); }
+    void appendColumn(const QSparqlBinding &binding);
 
     QVector<QSparqlBinding> bindings;
+    // The names of the bindings, usually shared by all the rows of a
+    // result. Only the first bindings.count() columns describe this row.
+    QSparqlResultRowSchemaPrivate *schema;
     QAtomicInt ref;
 };
 
 QSparqlResultRowPrivate::QSparqlResultRowPrivate()
+    : schema(0)
 {
     ref = 1;
 }
 
-QSparqlResultRowPrivate::QSparqlResultRowPrivate(const QSparqlResultRowPrivate &other): bindings(other.bindings)
+QSparqlResultRowPrivate::QSparqlResultRowPrivate(const QSparqlResultRowPrivate &other)
+    : bindings(other.bindings), schema(other.schema)
 {
     ref = 1;
+    qSchemaRef(schema);
+}
+
+QSparqlResultRowPrivate::~QSparqlResultRowPrivate()
+{
+    qSchemaDeref(schema);
+}
+
+void QSparqlResultRowPrivate::appendColumn(const QSparqlBinding &binding)
+{
+    const int column = bindings.count();
+    const QString name = binding.name();
+
+    // The usual case: the row follows the schema of its result
+    if (schema && column < schema->names.count() && schema->names.at(column) == name)
+        return;
+
+    // Other rows may be using the schema, or it has different columns after
+    // this one; continue with a copy of the columns of this row
+    if (!schema || schema->isShared() || schema->names.count() != column) {
+        QSparqlResultRowSchemaPrivate *own = schema
+            ? new QSparqlResultRowSchemaPrivate(*schema, column)
+            : new QSparqlResultRowSchemaPrivate();
+        qSchemaDeref(schema);
+        schema = own;
+    }
+    schema->append(name);
+}
+
+/*!
+    \class QSparqlResultRowSchema
+
+    \brief The QSparqlResultRowSchema class describes the columns of the
+    rows of a result.
+
+    A QSparqlResultRowSchema holds the names of the bindings of a
+    QSparqlResultRow.  The datatypes are not part of it, since the same
+    binding can have a different datatype in each row of a result; see
+    QSparqlBinding::dataTypeUri().  It can't be modified;
+    QSparqlResultRow::schema() returns the schema of a row, and the rows
+    constructed with it use it for the lookups by name instead of keeping
+    their own copy.  Looking up a
+    binding by name with indexOf() takes constant time.
+
+    QSparqlResultRowSchema is implicitly shared.
+
+    \sa QSparqlResultRow
+*/
+
+/*!
+    Constructs an empty schema, with no columns.
+*/
+
+QSparqlResultRowSchema::QSparqlResultRowSchema()
+    : d(0)
+{
+}
+
+/*!
+    Constructs a copy of \a other.
+*/
+
+QSparqlResultRowSchema::QSparqlResultRowSchema(const QSparqlResultRowSchema& other)
+    : d(other.d)
+{
+    qSchemaRef(d);
+}
+
+/*!
+    Sets the schema equal to \a other.
+*/
+
+QSparqlResultRowSchema& QSparqlResultRowSchema::operator=(const QSparqlResultRowSchema& other)
+{
+    qSchemaRef(other.d);
+    qSchemaDeref(d);
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Destroys the object and frees any allocated resources.
+*/
+
+QSparqlResultRowSchema::~QSparqlResultRowSchema()
+{
+    qSchemaDeref(d);
+}
+
+/*!
+    Returns the position of the column called \a name, or -1 if it cannot
+    be found. If more than one column has the name, the position of the
+    first one is returned.
+*/
+
+int QSparqlResultRowSchema::indexOf(const QString &name) const
+{
+    return d ? d->columns.value(name, -1) : -1;
+}
+
+/*!
+    Returns the name of the column at position \a i. If the column does
+    not exist, an empty string is returned.
+*/
+
+QString QSparqlResultRowSchema::variableName(int i) const
+{
+    return d ? d->names.value(i) : QString();
+}
+
+/*!
+    Returns true if the schema has no columns; otherwise returns false.
+*/
+
+bool QSparqlResultRowSchema::isEmpty() const
+{
+    return count() == 0;
+}
+
+/*!
+    Returns the number of columns in the schema.
+*/
+
+int QSparqlResultRowSchema::count() const
+{
+    return d ? d->names.count() : 0;
 }
 
 /*!
@@ -95,6 +286,12 @@ QSparqlResultRowPrivate::QSparqlResultRowPrivate(const QSparqlResultRowPrivate &
     removed with clear(). The number of bindings is given by count(); all their
     values can be cleared (to null) using clearValues().
 
+    The names of the bindings are kept in a QSparqlResultRowSchema, which
+    the rows of a result share. A row constructed with the schema() of
+    another row uses that schema for as long as the bindings appended to
+    it have the same names, and then indexOf() doesn't compare any
+    strings.
+
     \sa QSparqlBinding, QSparqlResult
 */
 
@@ -110,6 +307,22 @@ QSparqlResultRow::QSparqlResultRow()
     d = new QSparqlResultRowPrivate();
 }
 
+/*!
+    Constructs an empty result row which will use \a schema for its
+    bindings. The bindings are still added with append(); as long as they
+    are named like the columns of \a schema, the row refers to it instead
+    of keeping the names itself.
+
+    \sa schema()
+*/
+
+QSparqlResultRow::QSparqlResultRow(const QSparqlResultRowSchema& schema)
+{
+    d = new QSparqlResultRowPrivate();
+    d->schema = schema.d;
+    qSchemaRef(d->schema);
+}
+
 /*!
     Constructs a copy of \a other.
 
@@ -189,11 +402,10 @@ QString QSparqlResultRow::variableName(int index) const
 
 int QSparqlResultRow::indexOf(const QString& name) const
 {
-    for (int i = 0; i < count(); ++i) {
-        if (d->bindings.at(i).name() == name)
-            return i;
-    }
-    return -1;
+    if (!d->schema)
+        return -1;
+    const int i = d->schema->columns.value(name, -1);
+    return i < d->bindings.count() ? i : -1;
 }
 
 /*!
@@ -240,11 +452,13 @@ QVariant QSparqlResultRow::value(const QString &name) const
 void QSparqlResultRow::append(const QSparqlBinding& binding)
 {
     detach();
+    d->appendColumn(binding);
     d->bindings.append(binding);
 }
 
 /*!
-    Removes all the result row's bindings.
+    Removes all the result row's bindings. The schema of the row is kept,
+    so that the row can be filled again with the same bindings.
 
     \sa clearValues() isEmpty()
 */
@@ -304,6 +518,25 @@ int QSparqlResultRow::count() const
     return d->bindings.count();
 }
 
+/*!
+    Returns the schema of the row: the names of its bindings. Pass it to QSparqlResultRow(const QSparqlResultRowSchema&)
+    to construct other rows with the same bindings.
+*/
+
+QSparqlResultRowSchema QSparqlResultRow::schema() const
+{
+    QSparqlResultRowSchema s;
+    if (!d->schema || d->bindings.isEmpty())
+        return s;
+
+    if (d->schema->names.count() == d->bindings.count()) {
+        s.d = d->schema;
+        qSchemaRef(s.d);
+    } else {
+        s.d = new QSparqlResultRowSchemaPrivate(*d->schema, d->bindings.count());
+    }
+    return s;
+}
 
 /*! \internal
 */
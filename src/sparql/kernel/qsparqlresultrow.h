@@ -59,11 +59,32 @@ class QSparqlBinding;
 class QStringList;
 class QVariant;
 class QSparqlResultRowPrivate;
+class QSparqlResultRowSchemaPrivate;
+
+class Q_SPARQL_EXPORT QSparqlResultRowSchema
+{
+public:
+    QSparqlResultRowSchema();
+    QSparqlResultRowSchema(const QSparqlResultRowSchema& other);
+    QSparqlResultRowSchema& operator=(const QSparqlResultRowSchema& other);
+    ~QSparqlResultRowSchema();
+
+    int indexOf(const QString &name) const;
+    QString variableName(int i) const;
+
+    bool isEmpty() const;
+    int count() const;
+
+private:
+    friend class QSparqlResultRow;
+    QSparqlResultRowSchemaPrivate* d;
+};
 
 class Q_SPARQL_EXPORT QSparqlResultRow
 {
 public:
     QSparqlResultRow();
+    explicit QSparqlResultRow(const QSparqlResultRowSchema& schema);
     QSparqlResultRow(const QSparqlResultRow& other);
     QSparqlResultRow& operator=(const QSparqlResultRow& other);
     ~QSparqlResultRow();
@@ -87,6 +108,8 @@ public:
     void clearValues();
     int count() const;
 
+    QSparqlResultRowSchema schema() const;
+
 private:
     void detach();
     QSparqlResultRowPrivate* d;
@@ -0,0 +1,640 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (ivan.frade@nokia.com)
+**
+** This file is part of the QtSparql module (not yet part of the Qt Toolkit).
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation and
+** appearing in the file LICENSE.LGPL included in the packaging of this
+** file. Please review the following information to ensure the GNU Lesser
+** General Public License version 2.1 requirements will be met:
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain additional
+** rights. These rights are described in the Nokia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** Other Usage
+** Alternatively, this file may be used in accordance with the terms and
+** conditions contained in a signed written agreement between you and Nokia.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at ivan.frade@nokia.com.
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qsparqlxmlresultsreader_p.h"
+
+#include <qsparqlbinding.h>
+
+#include <QtCore/qhash.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qvariant.h>
+
+#include <string.h>
+
+QT_BEGIN_NAMESPACE
+
+#define IS_XML_SPACE(c) ((c) == ' ' || (c) == '\n' || (c) == '\r' || (c) == '\t')
+
+class QSparqlXmlResultsReaderPrivate
+{
+public:
+    enum Element {
+        Unknown,
+        Sparql,
+        Head,
+        Variable,
+        Link,
+        Results,
+        Result,
+        Binding,
+        Uri,
+        BNode,
+        Literal,
+        Boolean
+    };
+
+    QSparqlXmlResultsReaderPrivate()
+        : collectText(false), complete(false), failed(false),
+          hasBoolean(false), boolValue(false)
+    {
+    }
+
+    int tokenize(const char *data, int len);
+    int appendText(const char *p, const char *end, bool final);
+    bool startElement(const char *p, const char *end);
+    void endElement(Element element);
+    bool closeElement(const char *name, int len);
+    bool setError(const char *message);
+
+    static Element element(const char *name, int len);
+    static bool decodeEntity(const char *p, const char *end, QByteArray &out);
+    static void appendUtf8(QByteArray &out, uint codePoint);
+    const QString &internName(const char *p, int len);
+    const QUrl &internDatatype(const QByteArray &datatype);
+
+    QByteArray pending;         // unfinished token from the previous chunk
+    QByteArray text;            // raw UTF-8 of the current value element
+    bool collectText;
+    // The qualified names of the elements which have not ended yet, one
+    // after another, and where each of them starts
+    QByteArray openNames;
+    QVector<int> openElements;
+    bool complete;
+    bool failed;
+    QString error;
+
+    QByteArray datatype;
+    QByteArray lang;
+    QSparqlBinding binding;
+    QSparqlResultRow row;
+    QVector<QSparqlResultRow> rows;
+    // The bindings of the previous result; the rows with the same ones
+    // share it instead of each keeping the names
+    QSparqlResultRowSchema schema;
+    bool hasBoolean;
+    bool boolValue;
+
+    // The same few variable names and datatypes appear in every result,
+    // share them instead of allocating new ones for every binding
+    QHash<QByteArray, QString> names;
+    QHash<QByteArray, QUrl> datatypes;
+};
+
+static const char *findSequence(const char *p, const char *end, const char *seq, int len)
+{
+    while (end - p >= len) {
+        p = static_cast<const char *>(memchr(p, seq[0], end - p - len + 1));
+        if (!p)
+            return 0;
+        if (memcmp(p, seq, len) == 0)
+            return p;
+        ++p;
+    }
+    return 0;
+}
+
+bool QSparqlXmlResultsReaderPrivate::setError(const char *message)
+{
+    error = QString::fromLatin1(message);
+    failed = true;
+    return false;
+}
+
+QSparqlXmlResultsReaderPrivate::Element QSparqlXmlResultsReaderPrivate::element(const char *name, int len)
+{
+    // The element names are compared by their length first; the namespace
+    // prefix, if any, has already been stripped
+    switch (len) {
+    case 3:
+        if (memcmp(name, "uri", 3) == 0)
+            return Uri;
+        break;
+    case 4:
+        if (memcmp(name, "head", 4) == 0)
+            return Head;
+        if (memcmp(name, "link", 4) == 0)
+            return Link;
+        break;
+    case 5:
+        if (memcmp(name, "bnode", 5) == 0)
+            return BNode;
+        break;
+    case 6:
+        if (memcmp(name, "result", 6) == 0)
+            return Result;
+        if (memcmp(name, "sparql", 6) == 0)
+            return Sparql;
+        break;
+    case 7:
+        if (memcmp(name, "binding", 7) == 0)
+            return Binding;
+        if (memcmp(name, "literal", 7) == 0)
+            return Literal;
+        if (memcmp(name, "results", 7) == 0)
+            return Results;
+        if (memcmp(name, "boolean", 7) == 0)
+            return Boolean;
+        break;
+    case 8:
+        if (memcmp(name, "variable", 8) == 0)
+            return Variable;
+        break;
+    default:
+        break;
+    }
+    return Unknown;
+}
+
+const QString &QSparqlXmlResultsReaderPrivate::internName(const char *p, int len)
+{
+    const QByteArray key = QByteArray::fromRawData(p, len);
+    QHash<QByteArray, QString>::iterator it = names.find(key);
+    if (it == names.end())
+        it = names.insert(QByteArray(p, len), QString::fromUtf8(p, len));
+    return it.value();
+}
+
+const QUrl &QSparqlXmlResultsReaderPrivate::internDatatype(const QByteArray &dt)
+{
+    QHash<QByteArray, QUrl>::iterator it = datatypes.find(dt);
+    if (it == datatypes.end())
+        it = datatypes.insert(dt, QUrl(QString::fromUtf8(dt.constData(), dt.size())));
+    return it.value();
+}
+
+void QSparqlXmlResultsReaderPrivate::appendUtf8(QByteArray &out, uint codePoint)
+{
+    if (codePoint < 0x80) {
+        out.append(char(codePoint));
+    } else if (codePoint < 0x800) {
+        out.append(char(0xc0 | (codePoint >> 6)));
+        out.append(char(0x80 | (codePoint & 0x3f)));
+    } else if (codePoint < 0x10000) {
+        out.append(char(0xe0 | (codePoint >> 12)));
+        out.append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        out.append(char(0x80 | (codePoint & 0x3f)));
+    } else {
+        out.append(char(0xf0 | (codePoint >> 18)));
+        out.append(char(0x80 | ((codePoint >> 12) & 0x3f)));
+        out.append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        out.append(char(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+// Decodes the entity between '&' at p and ';' at end
+bool QSparqlXmlResultsReaderPrivate::decodeEntity(const char *p, const char *end, QByteArray &out)
+{
+    ++p;
+    const int len = end - p;
+    if (len == 2 && memcmp(p, "lt", 2) == 0) {
+        out.append('<');
+    } else if (len == 2 && memcmp(p, "gt", 2) == 0) {
+        out.append('>');
+    } else if (len == 3 && memcmp(p, "amp", 3) == 0) {
+        out.append('&');
+    } else if (len == 4 && memcmp(p, "quot", 4) == 0) {
+        out.append('"');
+    } else if (len == 4 && memcmp(p, "apos", 4) == 0) {
+        out.append('\'');
+    } else if (len >= 2 && *p == '#') {
+        bool ok;
+        uint codePoint;
+        if (p[1] == 'x')
+            codePoint = QByteArray(p + 2, len - 2).toUInt(&ok, 16);
+        else
+            codePoint = QByteArray(p + 1, len - 1).toUInt(&ok, 10);
+        if (!ok || codePoint > 0x10ffff)
+            return false;
+        appendUtf8(out, codePoint);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Appends the character data between p and end to the text, and returns how
+// much of it was used. An entity which isn't finished in this chunk is left
+// for the next one, unless this is the final piece of the text.
+int QSparqlXmlResultsReaderPrivate::appendText(const char *p, const char *end, bool final)
+{
+    const char *start = p;
+    while (p < end) {
+        const char *amp = static_cast<const char *>(memchr(p, '&', end - p));
+        if (!amp) {
+            text.append(p, end - p);
+            return end - start;
+        }
+        text.append(p, amp - p);
+        const char *semicolon = static_cast<const char *>(memchr(amp, ';', end - amp));
+        if (!semicolon) {
+            if (final) {
+                setError("Unterminated entity reference");
+                return -1;
+            }
+            return amp - start;
+        }
+        if (!decodeEntity(amp, semicolon, text)) {
+            setError("Unknown entity reference");
+            return -1;
+        }
+        p = semicolon + 1;
+    }
+    return p - start;
+}
+
+bool QSparqlXmlResultsReaderPrivate::startElement(const char *p, const char *end)
+{
+    const char *nameStart = p;
+    while (p < end && !IS_XML_SPACE(*p))
+        ++p;
+    const char *nameEnd = p;
+    openElements.append(openNames.size());
+    openNames.append(nameStart, nameEnd - nameStart);
+    const char *colon = static_cast<const char *>(memchr(nameStart, ':', nameEnd - nameStart));
+    if (colon)
+        nameStart = colon + 1;
+
+    const Element e = element(nameStart, nameEnd - nameStart);
+
+    switch (e) {
+    case Result:
+        row = QSparqlResultRow(schema);
+        return true;
+    case Uri:
+    case BNode:
+    case Boolean:
+        text.resize(0);
+        collectText = true;
+        return true;
+    case Binding:
+        binding = QSparqlBinding();
+        break;
+    case Literal:
+        datatype.resize(0);
+        lang.resize(0);
+        text.resize(0);
+        collectText = true;
+        break;
+    default:
+        return true;
+    }
+
+    // Read the attributes of <binding> and <literal>
+    while (p < end) {
+        while (p < end && IS_XML_SPACE(*p))
+            ++p;
+        if (p == end)
+            break;
+        const char *attrStart = p;
+        while (p < end && *p != '=' && !IS_XML_SPACE(*p))
+            ++p;
+        const char *attrEnd = p;
+        while (p < end && IS_XML_SPACE(*p))
+            ++p;
+        if (p == end || *p != '=')
+            return setError("Malformed attribute");
+        ++p;
+        while (p < end && IS_XML_SPACE(*p))
+            ++p;
+        if (p == end || (*p != '"' && *p != '\''))
+            return setError("Malformed attribute");
+        const char quote = *p++;
+        const char *valueStart = p;
+        p = static_cast<const char *>(memchr(p, quote, end - p));
+        if (!p)
+            return setError("Malformed attribute");
+        const char *valueEnd = p++;
+
+        QByteArray value;
+        if (memchr(valueStart, '&', valueEnd - valueStart)) {
+            // Rare; decode the entities through the text buffer
+            QByteArray saved = text;
+            text.resize(0);
+            if (appendText(valueStart, valueEnd, true) < 0)
+                return false;
+            value = text;
+            text = saved;
+        } else {
+            value = QByteArray::fromRawData(valueStart, valueEnd - valueStart);
+        }
+
+        const int attrLen = attrEnd - attrStart;
+        if (e == Binding && attrLen == 4 && memcmp(attrStart, "name", 4) == 0) {
+            binding.setName(internName(value.constData(), value.size()));
+        } else if (e == Literal && attrLen == 8 && memcmp(attrStart, "datatype", 8) == 0) {
+            datatype = QByteArray(value.constData(), value.size());
+        } else if (e == Literal && attrLen == 8 && memcmp(attrStart, "xml:lang", 8) == 0) {
+            lang = QByteArray(value.constData(), value.size());
+        }
+    }
+    return true;
+}
+
+void QSparqlXmlResultsReaderPrivate::endElement(Element e)
+{
+    switch (e) {
+    case Uri:
+        binding.setValue(QVariant(QUrl(QString::fromUtf8(text.constData(), text.size()))));
+        collectText = false;
+        break;
+    case BNode: {
+        // Some endpoints give the labels as nodeID://label or _:label
+        const char *label = text.constData();
+        int len = text.size();
+        if (len >= 9 && memcmp(label, "nodeID://", 9) == 0) {
+            label += 9;
+            len -= 9;
+        }
+        if (len >= 2 && memcmp(label, "_:", 2) == 0) {
+            label += 2;
+            len -= 2;
+        }
+        binding.setBlankNodeLabel(QString::fromUtf8(label, len));
+        collectText = false;
+        break;
+    }
+    case Literal: {
+        const QString value = QString::fromUtf8(text.constData(), text.size());
+        if (!datatype.isEmpty()) {
+            binding.setValue(value, internDatatype(datatype));
+        } else {
+            binding.setValue(QVariant(value));
+            if (!lang.isEmpty())
+                binding.setLanguageTag(QString::fromUtf8(lang.constData(), lang.size()));
+        }
+        collectText = false;
+        break;
+    }
+    case Boolean: {
+        boolValue = text.trimmed().toLower() == "true";
+        hasBoolean = true;
+        QSparqlBinding b;
+        b.setValue(QVariant(boolValue));
+        QSparqlResultRow r;
+        r.append(b);
+        rows.append(r);
+        collectText = false;
+        break;
+    }
+    case Binding:
+        row.append(binding);
+        break;
+    case Result:
+        if (row.count() >= schema.count())
+            schema = row.schema();
+        rows.append(row);
+        break;
+    default:
+        break;
+    }
+}
+
+// Ends the innermost open element, which must be called name
+bool QSparqlXmlResultsReaderPrivate::closeElement(const char *name, int len)
+{
+    if (openElements.isEmpty())
+        return setError("Unexpected end tag");
+    const int start = openElements.last();
+    if (openNames.size() - start != len || memcmp(openNames.constData() + start, name, len) != 0)
+        return setError("Mismatched end tag");
+
+    const char *colon = static_cast<const char *>(memchr(name, ':', len));
+    const char *localName = colon ? colon + 1 : name;
+    endElement(element(localName, name + len - localName));
+    openNames.resize(start);
+    openElements.resize(openElements.size() - 1);
+    if (openElements.isEmpty())
+        complete = true;
+    return true;
+}
+
+// Returns the number of bytes used, or -1 on error
+int QSparqlXmlResultsReaderPrivate::tokenize(const char *data, int len)
+{
+    const char *p = data;
+    const char *end = data + len;
+
+    while (p < end) {
+        if (*p != '<') {
+            const char *lt = static_cast<const char *>(memchr(p, '<', end - p));
+            const char *textEnd = lt ? lt : end;
+            if (collectText) {
+                const int used = appendText(p, textEnd, false);
+                if (used < 0)
+                    return -1;
+                p += used;
+                if (p != textEnd)
+                    break; // unfinished entity
+            } else {
+                if (openElements.isEmpty()) {
+                    for (const char *c = p; c < textEnd; ++c) {
+                        if (!IS_XML_SPACE(*c)) {
+                            setError("Content outside of the document element");
+                            return -1;
+                        }
+                    }
+                }
+                p = textEnd;
+            }
+            continue;
+        }
+
+        if (end - p < 2)
+            break;
+
+        if (p[1] == '?') {
+            // XML declaration or processing instruction
+            const char *close = findSequence(p + 2, end, "?>", 2);
+            if (!close)
+                break;
+            p = close + 2;
+            continue;
+        }
+
+        if (p[1] == '!') {
+            if (end - p < 4)
+                break;
+            if (memcmp(p, "<!--", 4) == 0) {
+                const char *close = findSequence(p + 4, end, "-->", 3);
+                if (!close)
+                    break;
+                p = close + 3;
+                continue;
+            }
+            if (end - p < 9)
+                break;
+            if (memcmp(p, "<![CDATA[", 9) == 0) {
+                const char *close = findSequence(p + 9, end, "]]>", 3);
+                if (!close)
+                    break;
+                if (collectText)
+                    text.append(p + 9, close - p - 9);
+                p = close + 3;
+                continue;
+            }
+            // Document type declaration
+            const char *close = static_cast<const char *>(memchr(p, '>', end - p));
+            if (!close)
+                break;
+            p = close + 1;
+            continue;
+        }
+
+        // Find the end of the tag; '>' is allowed inside attribute values
+        const char *close = p + 1;
+        char quote = 0;
+        for (; close < end; ++close) {
+            if (quote) {
+                if (*close == quote)
+                    quote = 0;
+            } else if (*close == '"' || *close == '\'') {
+                quote = *close;
+            } else if (*close == '>') {
+                break;
+            }
+        }
+        if (close == end)
+            break;
+
+        if (p[1] == '/') {
+            const char *nameStart = p + 2;
+            const char *nameEnd = close;
+            while (nameEnd > nameStart && IS_XML_SPACE(nameEnd[-1]))
+                --nameEnd;
+            if (!closeElement(nameStart, nameEnd - nameStart))
+                return -1;
+        } else {
+            if (complete) {
+                setError("Content outside of the document element");
+                return -1;
+            }
+            const bool selfClosing = close[-1] == '/';
+            const char *tagEnd = selfClosing ? close - 1 : close;
+            if (!startElement(p + 1, tagEnd))
+                return -1;
+            if (selfClosing) {
+                // Only the name is needed to end it
+                const char *nameEnd = p + 1;
+                while (nameEnd < tagEnd && !IS_XML_SPACE(*nameEnd))
+                    ++nameEnd;
+                if (!closeElement(p + 1, nameEnd - (p + 1)))
+                    return -1;
+            }
+        }
+        p = close + 1;
+    }
+
+    return p - data;
+}
+
+/*!
+    \class QSparqlXmlResultsReader
+    \internal
+*/
+
+QSparqlXmlResultsReader::QSparqlXmlResultsReader()
+    : d(new QSparqlXmlResultsReaderPrivate)
+{
+}
+
+QSparqlXmlResultsReader::~QSparqlXmlResultsReader()
+{
+    delete d;
+}
+
+/*!
+    Parses the next \a len bytes of the results document at \a data. Returns
+    false if the document is malformed; errorString() tells why.
+*/
+bool QSparqlXmlResultsReader::parse(const char *data, int len)
+{
+    if (d->failed)
+        return false;
+
+    if (d->pending.isEmpty()) {
+        const int used = d->tokenize(data, len);
+        if (used < 0)
+            return false;
+        if (used < len)
+            d->pending = QByteArray(data + used, len - used);
+    } else {
+        d->pending.append(data, len);
+        const int used = d->tokenize(d->pending.constData(), d->pending.size());
+        if (used < 0)
+            return false;
+        d->pending.remove(0, used);
+    }
+    return true;
+}
+
+/*!
+    Returns the rows which have been completely read since the previous
+    call.
+*/
+QVector<QSparqlResultRow> QSparqlXmlResultsReader::takeRows()
+{
+    QVector<QSparqlResultRow> rows = d->rows;
+    d->rows.clear();
+    return rows;
+}
+
+bool QSparqlXmlResultsReader::hasBoolean() const
+{
+    return d->hasBoolean;
+}
+
+bool QSparqlXmlResultsReader::boolValue() const
+{
+    return d->boolValue;
+}
+
+/*!
+    Returns true if the end of the document element has been read.
+*/
+bool QSparqlXmlResultsReader::isComplete() const
+{
+    return d->complete;
+}
+
+QString QSparqlXmlResultsReader::errorString() const
+{
+    return d->error;
+}
+
+QT_END_NAMESPACE
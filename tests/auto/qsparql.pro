@@ -8,6 +8,7 @@ SUBDIRS = \
     qsparql \
     qsparql_endpoint \
     qsparql_ntriples \
+    qsparql_xmlresults \
     qsparql_threading \
     qsparql_tracker \
     qsparql_tracker_direct \
@@ -22,7 +23,7 @@ SUBDIRS = \
 contains(sparql-plugins, tracker_direct): SUBDIRS += qsparql_benchmark
 
 QSPARQL_TESTS = qsparql qsparqlquery qsparqlbinding qsparql_api qsparql_tracker \
-                qsparql_tracker_direct qsparql_tracker_direct_sync qsparql_ntriples \
+                qsparql_tracker_direct qsparql_tracker_direct_sync qsparql_ntriples qsparql_xmlresults \
                 qsparql_tracker_direct_crashes qsparql_threading \
                 qsparqlresultrow qsparql_qmlbindings qsparql_endpoint
 
@@ -142,8 +142,25 @@ class MockDriver : public QSparqlDriver
     {
         if (f == QSparqlConnection::SyncExec || f == QSparqlConnection::AsyncExec)
             return true;
+        if (f == QSparqlConnection::Transactions)
+            return transactions;
         return false;
     }
+    bool beginTransaction()
+    {
+        ++beginCount;
+        return true;
+    }
+    bool commitTransaction()
+    {
+        ++commitCount;
+        return true;
+    }
+    bool rollbackTransaction()
+    {
+        ++rollbackCount;
+        return true;
+    }
     bool hasError() const
     {
         return !openRetVal;
@@ -163,6 +180,10 @@ class MockDriver : public QSparqlDriver
     static int openCount;
     static int closeCount;
     static bool openRetVal;
+    static bool transactions;
+    static int beginCount;
+    static int commitCount;
+    static int rollbackCount;
 };
 
 int MockResult::size_ = 0;
@@ -171,6 +192,10 @@ int MockSyncFwOnlyResult::size_ = 0;
 int MockDriver::openCount = 0;
 int MockDriver::closeCount = 0;
 bool MockDriver::openRetVal = true;
+bool MockDriver::transactions = false;
+int MockDriver::beginCount = 0;
+int MockDriver::commitCount = 0;
+int MockDriver::rollbackCount = 0;
 
 MockResult::MockResult(const MockDriver*)
     : QSparqlResult()
@@ -205,6 +230,9 @@ private slots:
     void iterate_error_result();
     void open_fails();
     void connection_scope();
+    void transaction_not_supported();
+    void transaction_commit_and_rollback();
+    void scoped_transaction();
     void drivers_list();
 
     void iterate_empty_result();
@@ -253,6 +281,10 @@ void tst_QSparql::init()
     MockDriver::openCount = 0;
     MockDriver::closeCount = 0;
     MockDriver::openRetVal = true;
+    MockDriver::transactions = false;
+    MockDriver::beginCount = 0;
+    MockDriver::commitCount = 0;
+    MockDriver::rollbackCount = 0;
     MockResult::size_ = 0;
     MockSyncFwOnlyResult::size_ = 0;
 }
@@ -304,6 +336,58 @@ void tst_QSparql::connection_scope()
     QCOMPARE(MockDriver::closeCount, 1);
 }
 
+void tst_QSparql::transaction_not_supported()
+{
+    QSparqlConnection conn("MOCK");
+    QVERIFY(!conn.hasFeature(QSparqlConnection::Transactions));
+    QVERIFY(!conn.transaction());
+    QVERIFY(!conn.commit());
+    QVERIFY(!conn.rollback());
+    QCOMPARE(MockDriver::beginCount, 0);
+
+    QSparqlTransaction transaction(&conn);
+    QVERIFY(!transaction.isActive());
+    QVERIFY(!transaction.commit());
+    QCOMPARE(MockDriver::commitCount, 0);
+}
+
+void tst_QSparql::transaction_commit_and_rollback()
+{
+    MockDriver::transactions = true;
+    QSparqlConnection conn("MOCK");
+    QVERIFY(conn.hasFeature(QSparqlConnection::Transactions));
+    QVERIFY(conn.transaction());
+    QVERIFY(conn.commit());
+    QVERIFY(conn.transaction());
+    QVERIFY(conn.rollback());
+    QCOMPARE(MockDriver::beginCount, 2);
+    QCOMPARE(MockDriver::commitCount, 1);
+    QCOMPARE(MockDriver::rollbackCount, 1);
+}
+
+void tst_QSparql::scoped_transaction()
+{
+    MockDriver::transactions = true;
+    QSparqlConnection conn("MOCK");
+    {
+        QSparqlTransaction transaction(&conn);
+        QVERIFY(transaction.isActive());
+    }
+    // Not committed, so rolled back
+    QCOMPARE(MockDriver::beginCount, 1);
+    QCOMPARE(MockDriver::rollbackCount, 1);
+    QCOMPARE(MockDriver::commitCount, 0);
+
+    {
+        QSparqlTransaction transaction(&conn);
+        QVERIFY(transaction.commit());
+        QVERIFY(!transaction.isActive());
+    }
+    QCOMPARE(MockDriver::beginCount, 2);
+    QCOMPARE(MockDriver::commitCount, 1);
+    QCOMPARE(MockDriver::rollbackCount, 1);
+}
+
 void tst_QSparql::drivers_list()
 {
     QStringList expectedDrivers;
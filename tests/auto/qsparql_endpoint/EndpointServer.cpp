@@ -41,6 +41,30 @@
 #include <QTextStream>
 #include <QTcpSocket>
 #include <QStringList>
+#include <QTimer>
+#include <QRegExp>
+#include <QUrl>
+
+#include <zlib.h>
+
+// windowBits for deflateInit2(): gzip, zlib wrapped deflate or raw deflate
+static QByteArray compress(const QByteArray& data, int windowBits)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return QByteArray();
+
+    QByteArray out(deflateBound(&stream, data.size()) + 32, 0);
+    stream.next_in = (Bytef*)data.constData();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef*)out.data();
+    stream.avail_out = out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(out.size() - stream.avail_out);
+    deflateEnd(&stream);
+    return out;
+}
 
 EndpointServer::EndpointServer(int _port) : port(_port), disabled(true)
 {
@@ -75,10 +99,100 @@ void EndpointServer::incomingConnection(int socket)
     s->setSocketDescriptor(socket);
 }
 
-QString EndpointServer::sparqlData(QString url)
+QString EndpointServer::sparqlData(QString url, bool post)
 {
+    if (!post && (url.contains("post only", Qt::CaseInsensitive)
+                  || url.contains("post%20only", Qt::CaseInsensitive))) {
+        return QString( "HTTP/1.1 400 Bad Request\r\n"
+        "Connection: close\r\n"
+        "Content-Type: text/html; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "Expected a POST request");
+    }
+
     // returned data is based on http://www.w3.org/TR/rdf-sparql-protocol/
-    if (url.contains("select", Qt::CaseInsensitive)) {
+    // and http://www.w3.org/TR/sparql11-results-json/
+    if (url.contains("json select", Qt::CaseInsensitive)
+        || url.contains("json%20select", Qt::CaseInsensitive)) {
+        return QString( "HTTP/1.0 200 Ok\r\n"
+        "Content-Type: application/sparql-results+json; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "{ \"head\": { \"vars\": [ \"book\", \"who\", \"title\" ] },\n"
+        "  \"results\": { \"bindings\": [\n"
+        "    { \"book\": { \"type\": \"uri\", \"value\": \"http://www.example/book/book5\" },\n"
+        "      \"who\": { \"type\": \"bnode\", \"value\": \"r29392923r2922\" },\n"
+        "      \"title\": { \"type\": \"literal\", \"xml:lang\": \"en\", \"value\": \"Book \\\"5\\\" \\u00e9\" } },\n"
+        "    { \"book\": { \"type\": \"uri\", \"value\": \"http://www.example/book/book6\" },\n"
+        "      \"who\": { \"type\": \"bnode\", \"value\": \"r8484882r49593\" },\n"
+        "      \"title\": { \"datatype\": \"http://www.w3.org/2001/XMLSchema#integer\", \"type\": \"literal\", \"value\": \"6\" } }\n"
+        "  ] }\n"
+        "}\n");
+    } else if (url.contains("json ask", Qt::CaseInsensitive)
+        || url.contains("json%20ask", Qt::CaseInsensitive)) {
+        return QString( "HTTP/1.0 200 Ok\r\n"
+        "Content-Type: application/sparql-results+json; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "{ \"head\": { }, \"boolean\": true }\n");
+    } else if (url.contains("json broken", Qt::CaseInsensitive)
+        || url.contains("json%20broken", Qt::CaseInsensitive)) {
+        return QString( "HTTP/1.0 200 Ok\r\n"
+        "Content-Type: application/sparql-results+json; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "{ \"head\": { \"vars\": [ \"book\" ] },\n"
+        "  \"results\": { \"bindings\": [\n"
+        "    { \"book\": { \"type\": \"uri\", \"value\": \"http://www.example/book/book5\" } },\n");
+    } else if (url.contains("tsv select", Qt::CaseInsensitive)
+        || url.contains("tsv%20select", Qt::CaseInsensitive)) {
+        // http://www.w3.org/TR/sparql11-results-csv-tsv/, without a newline
+        // after the last row
+        return QString( "HTTP/1.0 200 Ok\r\n"
+        "Content-Type: text/tab-separated-values; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "?book\t?title\t?count\t?who\n"
+        "<http://www.example/book/book5>\t\"Book \\\"5\\\" \\u00E9\\tx\"@en\t42\t_:r29392923r2922\n"
+        "<http://www.example/book/book6>\t\"2.5\"^^<http://www.w3.org/2001/XMLSchema#decimal>\t\t_:r8484882r49593");
+    } else if (url.contains("tsv broken", Qt::CaseInsensitive)
+        || url.contains("tsv%20broken", Qt::CaseInsensitive)) {
+        return QString( "HTTP/1.0 200 Ok\r\n"
+        "Content-Type: text/tab-separated-values; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "?book\n"
+        "<http://www.example/book/book5>\n"
+        "\"Book 6\n");
+    } else if (url.contains("construct", Qt::CaseInsensitive)) {
+        return QString( "HTTP/1.0 200 Ok\r\n"
+        "Content-Type: text/plain; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "<http://www.example/book/book5> <http://www.example/Author> _:r29392923r2922 .\n"
+        "# a comment\n"
+        "<http://www.example/book/book6> <http://www.example/Author> _:r8484882r49593 .\n"
+        "<http://www.example/book/book6> <http://www.example/Title> \"Book 6\"@en .");
+    } else if (url.contains("large select", Qt::CaseInsensitive)
+               || url.contains("large%20select", Qt::CaseInsensitive)) {
+        QString response( "HTTP/1.0 200 Ok\r\n"
+        "Content-Type: application/sparql-results+xml; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "<?xml version=\"1.0\"?>\n"
+        "<sparql xmlns=\"http://www.w3.org/2005/sparql-results#\">\n"
+        "<head><variable name=\"book\"/><variable name=\"title\"/></head>\n"
+        "<results distinct=\"false\" ordered=\"false\">\n");
+        // A page of the rows, for the paged queries
+        int first = 0;
+        int end = largeResultRows;
+        QRegExp page("LIMIT\\s+(\\d+)\\s+OFFSET\\s+(\\d+)");
+        if (page.indexIn(QUrl::fromPercentEncoding(url.toLatin1())) != -1) {
+            first = qMin(page.cap(2).toInt(), largeResultRows);
+            end = qMin(first + page.cap(1).toInt(), largeResultRows);
+        }
+        for (int i = first; i < end; ++i) {
+            response += QString("<result>\n"
+            "  <binding name=\"book\"><uri>http://www.example/book/book%1</uri></binding>\n"
+            "  <binding name=\"title\"><literal xml:lang=\"en\">Book number %1</literal></binding>\n"
+            "</result>\n").arg(i);
+        }
+        response += "</results>\n</sparql>\n";
+        return response;
+    } else if (url.contains("select", Qt::CaseInsensitive)) {
         return QString( "HTTP/1.0 200 Ok\r\n"
         "Content-Type: text/html; charset=\"utf-8\"\r\n"
         "\r\n"
@@ -127,6 +241,12 @@ QString EndpointServer::sparqlData(QString url)
         "<results distinct=\"false\" ordered=\"false\">"
         "<result>"
         "    <binding name=\"book\"><uri>http://www.example/book/book5</uri></binding>\n");
+    } else if (url.contains("plain-update", Qt::CaseInsensitive)) {
+        // The reply to an update isn't specified by the protocol
+        return QString( "HTTP/1.0 200 Ok\r\n"
+        "Content-Type: text/plain; charset=\"utf-8\"\r\n"
+        "\r\n"
+        "Insert into <http://www.example/plain-update>, 1 triples -- done\n");
     } else if (url.contains("insert", Qt::CaseInsensitive)) {
         return QString( "HTTP/1.0 200 Ok\r\n"
         "Content-Type: text/html; charset=\"utf-8\"\r\n"
@@ -145,28 +265,174 @@ void EndpointServer::readClient()
         return;
 
     // This slot is called when the client sent data to the server. The
-    // server looks if it was a get request and sends a very simple HTML
-    // document back.
+    // server waits for the whole request, and answers GET requests based on
+    // the url, and POST requests based on the body.
     QTcpSocket* socket = (QTcpSocket*)sender();
-    if (socket->canReadLine()) {
-        QStringList tokens = QString(socket->readLine()).split(QRegExp("[ \r\n][ \r\n]*"));
-        if (tokens[0] == "GET") {
-            QString url = tokens[1];
-            QTextStream os(socket);
-            os.setAutoDetectUnicode(true);
-            os << sparqlData(url);
-            socket->close();
-
-            if (socket->state() == QTcpSocket::UnconnectedState) {
-                delete socket;
-            }
+    QByteArray& request = requests[socket];
+    request += socket->readAll();
+
+    const int headerEnd = request.indexOf("\r\n\r\n");
+    if (headerEnd == -1)
+        return;
+
+    QStringList tokens = QString(request.left(request.indexOf("\r\n"))).split(QRegExp("[ \r\n][ \r\n]*"));
+
+    // Graph Store Protocol uploads are kept for the test to check
+    if ((tokens[0] == "POST" || tokens[0] == "PUT") && tokens[1].contains("sparql-graph-crud")) {
+        QRegExp contentLength("\r\ncontent-length: *(\\d+)", Qt::CaseInsensitive);
+        int length = 0;
+        if (contentLength.indexIn(QString(request.left(headerEnd))) != -1)
+            length = contentLength.cap(1).toInt();
+        if (request.size() < headerEnd + 4 + length)
+            return;
+        {
+            QMutexLocker locker(&uploadMutex);
+            uploads << tokens[0] + " " + tokens[1];
+            bodies << request.mid(headerEnd + 4, length);
+        }
+        requests.remove(socket);
+        servedRequests.ref();
+        writeResponse(socket, "HTTP/1.0 204 No Content\r\n\r\n");
+        return;
+    }
+
+    QString data;
+    if (tokens[0] == "GET") {
+        data = sparqlData(tokens[1]);
+    } else if (tokens[0] == "POST") {
+        QRegExp contentLength("\r\ncontent-length: *(\\d+)", Qt::CaseInsensitive);
+        int length = 0;
+        if (contentLength.indexIn(QString(request.left(headerEnd))) != -1)
+            length = contentLength.cap(1).toInt();
+        if (request.size() < headerEnd + 4 + length)
+            return;
+        data = sparqlData(QString::fromUtf8(request.mid(headerEnd + 4, length)), true);
+    } else {
+        return;
+    }
+    QByteArray response = data.toUtf8();
+
+    // Queries containing "gzip" or "deflate" get a compressed reply, as long
+    // as the client asked for one
+    const QString query = tokens[0] == "GET" ? tokens[1]
+        : QString::fromUtf8(request.mid(headerEnd + 4));
+    int windowBits = 0;
+    QByteArray encoding;
+    if (query.contains("gzip", Qt::CaseInsensitive)) {
+        windowBits = MAX_WBITS + 16;
+        encoding = "gzip";
+    } else if (query.contains("raw deflate", Qt::CaseInsensitive)
+               || query.contains("raw%20deflate", Qt::CaseInsensitive)) {
+        windowBits = -MAX_WBITS;
+        encoding = "deflate";
+    } else if (query.contains("deflate", Qt::CaseInsensitive)) {
+        windowBits = MAX_WBITS;
+        encoding = "deflate";
+    }
+
+    // Queries containing "auth required" are only answered when the
+    // credentials came with the request
+    if ((query.contains("auth required", Qt::CaseInsensitive)
+         || query.contains("auth%20required", Qt::CaseInsensitive))
+        && !QString(request.left(headerEnd)).contains("\r\nAuthorization: Basic ", Qt::CaseInsensitive)) {
+        response = "HTTP/1.1 401 Unauthorized\r\n"
+                   "Connection: close\r\n"
+                   "\r\n";
+    }
+
+    // Queries containing "cacheable" get an ETag which must be revalidated
+    // each time; a matching If-None-Match is answered with 304 Not Modified
+    if (query.contains("cacheable", Qt::CaseInsensitive)) {
+        QRegExp ifNoneMatch("\r\nif-none-match: *\"v1\"", Qt::CaseInsensitive);
+        if (ifNoneMatch.indexIn(QString(request.left(headerEnd))) != -1) {
+            response = "HTTP/1.1 304 Not Modified\r\n"
+                       "ETag: \"v1\"\r\n"
+                       "Cache-Control: max-age=0\r\n"
+                       "Connection: close\r\n"
+                       "\r\n";
+        } else {
+            const int headersEnd = response.indexOf("\r\n\r\n");
+            if (headersEnd != -1)
+                response.insert(headersEnd, "\r\nETag: \"v1\"\r\nCache-Control: max-age=0\r\nConnection: close");
+            response.replace("HTTP/1.0 ", "HTTP/1.1 ");
+        }
+    }
+
+    const int bodyStart = response.indexOf("\r\n\r\n");
+    if (windowBits != 0 && bodyStart != -1) {
+        QRegExp acceptEncoding("\r\naccept-encoding:[^\r]*" + QString(encoding), Qt::CaseInsensitive);
+        if (acceptEncoding.indexIn(QString(request.left(headerEnd))) == -1) {
+            response = "HTTP/1.1 400 Bad Request\r\n"
+                       "Connection: close\r\n"
+                       "\r\n"
+                       "Expected Accept-Encoding: " + encoding;
+        } else {
+            response = response.left(bodyStart) + "\r\nContent-Encoding: " + encoding + "\r\n\r\n"
+                + compress(response.mid(bodyStart + 4), windowBits);
         }
     }
+
+    requests.remove(socket);
+    servedRequests.ref();
+
+    // All the replies have the same delay, so they are written in order
+    const int ms = delay.fetchAndAddRelaxed(0);
+    if (ms > 0) {
+        delayed.enqueue(qMakePair(QPointer<QTcpSocket>(socket), response));
+        QTimer::singleShot(ms, this, SLOT(writeDelayed()));
+        return;
+    }
+
+    writeResponse(socket, response);
+}
+
+void EndpointServer::writeDelayed()
+{
+    if (delayed.isEmpty())
+        return;
+
+    // The client may have given up waiting
+    QPair<QPointer<QTcpSocket>, QByteArray> reply = delayed.dequeue();
+    if (reply.first)
+        writeResponse(reply.first, reply.second);
+}
+
+void EndpointServer::writeResponse(QTcpSocket *socket, const QByteArray &response)
+{
+    socket->write(response);
+    socket->close();
+
+    if (socket->state() == QTcpSocket::UnconnectedState) {
+        delete socket;
+    }
+}
+
+void EndpointServer::setDelay(int ms)
+{
+    delay.fetchAndStoreRelaxed(ms);
+}
+
+int EndpointServer::requestCount()
+{
+    return servedRequests.fetchAndAddRelaxed(0);
+}
+
+QStringList EndpointServer::uploadRequests()
+{
+    QMutexLocker locker(&uploadMutex);
+    return uploads;
+}
+
+QList<QByteArray> EndpointServer::uploadBodies()
+{
+    QMutexLocker locker(&uploadMutex);
+    return bodies;
 }
 
 void EndpointServer::discardClient()
 {
     QTcpSocket* socket = (QTcpSocket*)sender();
+    requests.remove(socket);
     socket->deleteLater();
 }
 
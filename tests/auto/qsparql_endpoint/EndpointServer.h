@@ -43,27 +43,56 @@
 #include <QTcpServer>
 #include <QEventLoop>
 #include <QString>
+#include <QHash>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+#include <QPair>
+#include <QPointer>
+#include <QQueue>
+
+class QTcpSocket;
 
 class EndpointServer : public QTcpServer
 {
     Q_OBJECT
 
 public:
+    // Number of rows in the reply to a "large select" query
+    static const int largeResultRows = 5000;
+
     EndpointServer(int port);
     ~EndpointServer();
     bool isRunning() const;
     void pause();
     bool resume();
     void stop();
+    // Replies are written after this many milliseconds
+    void setDelay(int ms);
+    int requestCount();
+    // The Graph Store Protocol requests, as "METHOD url", and their bodies
+    QStringList uploadRequests();
+    QList<QByteArray> uploadBodies();
 private:
     void incomingConnection(int socket);
-    QString sparqlData(QString url);
+    void writeResponse(QTcpSocket *socket, const QByteArray &response);
+    QString sparqlData(QString url, bool post = false);
 private Q_SLOTS:
     void readClient();
     void discardClient();
+    void writeDelayed();
 private:
     int port;
     bool disabled;
+    QHash<QTcpSocket*, QByteArray> requests;
+    QAtomicInt delay;
+    QAtomicInt servedRequests;
+    QQueue<QPair<QPointer<QTcpSocket>, QByteArray> > delayed;
+    QMutex uploadMutex;
+    QStringList uploads;
+    QList<QByteArray> bodies;
 };
 
 #endif // QSPARQL_ENDPOINT_SERVER_H
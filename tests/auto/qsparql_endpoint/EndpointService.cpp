@@ -77,6 +77,36 @@ bool EndpointService::resume()
         return false;
 }
 
+void EndpointService::setDelay(int ms)
+{
+    if (server)
+        server->setDelay(ms);
+}
+
+int EndpointService::requestCount()
+{
+    if (server)
+        return server->requestCount();
+    else
+        return 0;
+}
+
+QStringList EndpointService::uploadRequests()
+{
+    if (server)
+        return server->uploadRequests();
+    else
+        return QStringList();
+}
+
+QList<QByteArray> EndpointService::uploadBodies()
+{
+    if (server)
+        return server->uploadBodies();
+    else
+        return QList<QByteArray>();
+}
+
 bool EndpointService::isRunning()
 {
     if (server)
@@ -56,6 +56,10 @@ public:
     void pause();
     bool resume();
     bool isRunning();
+    void setDelay(int ms);
+    int requestCount();
+    QStringList uploadRequests();
+    QList<QByteArray> uploadBodies();
 private:
     int port;
     EndpointServer *server;
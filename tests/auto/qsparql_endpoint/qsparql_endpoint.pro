@@ -6,6 +6,7 @@ HEADERS += EndpointService.h \
 SOURCES  += tst_qsparql_endpoint.cpp \
             EndpointService.cpp \
             EndpointServer.cpp
+LIBS += -lz
 
 #QT = sparql # enable this later
 
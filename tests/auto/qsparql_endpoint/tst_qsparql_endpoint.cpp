@@ -40,6 +40,7 @@
 #include <QtTest/QtTest>
 #include <QtSparql>
 #include "EndpointService.h"
+#include "EndpointServer.h"
 
 class tst_QSparqlEndpoint : public QObject
 {
@@ -64,10 +65,80 @@ private slots:
     void destroy_connection();
     void broken_result();
     void update_query();
+    void update_query_plain_text_reply();
+    void construct_query();
+    void long_query_over_post();
+    void update_query_over_get();
+    void compressed_select_query_data();
+    void compressed_select_query();
+    void request_priorities();
+    void request_host_default_port();
+    void preemptive_credentials();
+    void cached_select_query();
+    void benchmark_large_select_data();
+    void benchmark_large_select();
+    void json_select_query();
+    void json_ask_query();
+    void json_fallback_to_xml();
+    void json_broken_result();
+    void tsv_select_query();
+    void tsv_fallback_to_xml();
+    void tsv_broken_result();
+    void sync_select_query();
+    void sync_ask_query();
+    void sync_query_with_error();
+    void sync_forward_only_large_select();
+    void network_thread_select_query();
+    void network_thread_wait_for_finished();
+    void network_thread_statistics_while_queued();
+    void replica_load_balancing();
+    void hedged_request();
+    void hedged_request_host_saturated();
+    void paged_select_query();
+    void sync_paged_select_query();
+    void upload_graph();
+    void upload_graph_queued();
+    void upload_graph_from_sequential_device();
+    void upload_turtle_from_sequential_device();
 private:
     EndpointService *endpointService;
 };
 
+// Gives its data in pieces and has no size, like a pipe
+class SequentialDevice : public QIODevice
+{
+public:
+    SequentialDevice(const QByteArray& data) : data(data), offset(0)
+    {
+        open(QIODevice::ReadOnly);
+    }
+    bool isSequential() const
+    {
+        return true;
+    }
+    qint64 bytesAvailable() const
+    {
+        return data.size() - offset + QIODevice::bytesAvailable();
+    }
+
+protected:
+    qint64 readData(char* out, qint64 maxSize)
+    {
+        const qint64 size = qMin(maxSize, qint64(data.size() - offset));
+        memcpy(out, data.constData() + offset, size);
+        offset += size;
+        return size;
+    }
+    qint64 writeData(const char*, qint64)
+    {
+        return -1;
+    }
+
+private:
+    QByteArray data;
+    qint64 offset;
+};
+
 tst_QSparqlEndpoint::tst_QSparqlEndpoint()
 {
 }
@@ -286,5 +357,1085 @@ void tst_QSparqlEndpoint::update_query()
     delete r;
 }
 
+void tst_QSparqlEndpoint::update_query_plain_text_reply()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    // A successful update answered with text instead of a results document
+    QSparqlQuery q("INSERT DATA { GRAPH <http://www.example/plain-update> "
+                   "{ <http://www.example/book/book15> a <http://www.example/Book> } }",
+                   QSparqlQuery::InsertStatement);
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 0);
+    delete r;
+}
+
+
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("CONSTRUCT { ?book <http://www.example/Author> ?who } "
+                   "WHERE { ?who <http://www.example/Author> ?book . }",
+                   QSparqlQuery::ConstructStatement);
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    QSignalSpy dataReadySpy(r, SIGNAL(dataReady(int)));
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 3);
+    QVERIFY(dataReadySpy.count() > 0);
+
+    QVERIFY(r->next());
+    QCOMPARE(r->binding(0).toString(), QString("<http://www.example/book/book5>"));
+    QCOMPARE(r->binding(2).toString(), QString("_:r29392923r2922"));
+    QVERIFY(r->next());
+    QVERIFY(r->next());
+    // The last line has no newline
+    QCOMPARE(r->binding(2).toString(), QString("\"Book 6\"@en"));
+
+    delete r;
+}
+
+void tst_QSparqlEndpoint::long_query_over_post()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("postThreshold", 100);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    // The server only answers this query when it comes in a POST
+    QSparqlQuery shortQuery("SELECT ?book ?who # post only");
+    QSparqlResult* r = conn.exec(shortQuery);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), true);
+    delete r;
+
+    QSparqlQuery longQuery("SELECT ?book ?who "
+                           "WHERE { "
+                           "?book a <http://www.example/Book> . "
+                           "?who <http://www.example/Author> ?book . } "
+                           "# post only " + QString(200, QLatin1Char('x')));
+    r = conn.exec(longQuery);
+    QVERIFY(r != 0);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::update_query_over_get()
+{
+    // Updates go in a POST by default (see update_query), but can be sent
+    // in the url for old endpoints
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("updateOverPost", false);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("INSERT {<http://www.example/book/book15> a <http://www.example/Book>}",
+                   QSparqlQuery::InsertStatement);
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), false);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::compressed_select_query_data()
+{
+    QTest::addColumn<QString>("encoding");
+    QTest::newRow("gzip") << "gzip";
+    QTest::newRow("deflate") << "deflate";
+    QTest::newRow("raw deflate") << "raw deflate";
+}
+
+void tst_QSparqlEndpoint::compressed_select_query()
+{
+    QFETCH(QString, encoding);
+
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q(QString("SELECT ?book ?who # %1").arg(encoding));
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+    QVERIFY(r->next());
+    QCOMPARE(r->binding(0).toString(), QString("<http://www.example/book/book5>"));
+    delete r;
+
+    // A big reply comes in several chunks, which are decompressed as they
+    // arrive
+    QSparqlQuery large(QString("SELECT ?book ?title # large select %1").arg(encoding));
+    r = conn.exec(large);
+    QVERIFY(r != 0);
+    QSignalSpy dataReadySpy(r, SIGNAL(dataReady(int)));
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), EndpointServer::largeResultRows);
+    QVERIFY(r->last());
+    QCOMPARE(r->binding(1).value().toString(),
+             QString("Book number %1").arg(EndpointServer::largeResultRows - 1));
+    QVERIFY(dataReadySpy.count() > 0);
+    delete r;
+
+    // Without compression the server refuses to answer
+    options.setOption("compression", false);
+    QSparqlConnection plainConn("QSPARQL_ENDPOINT", options);
+    r = plainConn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), true);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::request_priorities()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("maxRequestsPerHost", 1);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("SELECT ?book ?who "
+                   "WHERE { "
+                   "?book a <http://www.example/Book> . "
+                   "?who <http://www.example/Author> ?book . }");
+    QSparqlQueryOptions low;
+    low.setPriority(QSparqlQueryOptions::LowPriority);
+    QSparqlQueryOptions high;
+    high.setPriority(QSparqlQueryOptions::HighPriority);
+
+    QSparqlResult* r1 = conn.exec(q, low);
+    QSparqlResult* r2 = conn.exec(q, low);
+    QSparqlResult* r3 = conn.exec(q, high);
+    QVERIFY(r1 != 0 && r2 != 0 && r3 != 0);
+
+    QVariantMap stats = conn.statistics();
+    QCOMPARE(stats["inFlightRequests"].toInt(), 1);
+    QCOMPARE(stats["queuedRequests"].toInt(), 2);
+
+    // The high priority query goes before the low priority one which was
+    // queued earlier
+    r3->waitForFinished();
+    QCOMPARE(r3->hasError(), false);
+    QVERIFY(r1->isFinished());
+    QVERIFY(!r2->isFinished());
+    r2->waitForFinished();
+    QCOMPARE(r2->hasError(), false);
+    QCOMPARE(r2->size(), 2);
+
+    stats = conn.statistics();
+    QCOMPARE(stats["inFlightRequests"].toInt(), 0);
+    QCOMPARE(stats["queuedRequests"].toInt(), 0);
+    QCOMPARE(stats["startedRequests"].toLongLong(), 3LL);
+    QVERIFY(stats["maxQueueTime"].toLongLong() >= 0);
+    QCOMPARE(stats["hosts"].toMap().count(), 1);
+    QVERIFY(stats["hosts"].toMap().contains("127.0.0.1:8080"));
+
+    delete r1;
+    delete r2;
+    delete r3;
+}
+
+void tst_QSparqlEndpoint::request_host_default_port()
+{
+    // The requests to an https url without a port share the slots of port 443
+    QSparqlConnectionOptions options;
+    options.setOption("endpoints", QStringList() << "https://127.0.0.1/sparql");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlResult* r = conn.exec(QSparqlQuery("SELECT ?book ?who"));
+    QVERIFY(r != 0);
+    const QVariantMap hosts = conn.statistics()["hosts"].toMap();
+    QCOMPARE(hosts.count(), 1);
+    QVERIFY(hosts.contains("127.0.0.1:443"));
+    r->waitForFinished();
+    delete r;
+}
+
+void tst_QSparqlEndpoint::preemptive_credentials()
+{
+    // The server doesn't ask for the credentials, they must come with the
+    // request
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("SELECT ?book ?who # auth required");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), true);
+    delete r;
+
+    options.setUserName("user");
+    options.setPassword("secret");
+    QSparqlConnection authConn("QSPARQL_ENDPOINT", options);
+    r = authConn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+    delete r;
+}
+
+static void removeDirectory(const QString& path)
+{
+    QDir dir(path);
+    foreach (const QFileInfo& info, dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot)) {
+        if (info.isDir())
+            removeDirectory(info.absoluteFilePath());
+        else
+            dir.remove(info.fileName());
+    }
+    dir.rmdir(path);
+}
+
+void tst_QSparqlEndpoint::cached_select_query()
+{
+    const QString cacheDirectory = QDir::tempPath()
+        + QString("/tst_qsparql_endpoint_cache_%1").arg(QCoreApplication::applicationPid());
+    removeDirectory(cacheDirectory);
+
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("cacheDirectory", cacheDirectory);
+    options.setOption("cacheSize", 1024 * 1024);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("SELECT ?book ?who # cacheable");
+
+    // The first reply comes from the network, the second one is revalidated
+    // and replayed from the cache
+    for (int i = 0; i < 2; ++i) {
+        QSparqlResult* r = conn.exec(q);
+        QVERIFY(r != 0);
+        r->waitForFinished();
+        QCOMPARE(r->hasError(), false);
+        QCOMPARE(r->size(), 2);
+        QVERIFY(r->next());
+        QCOMPARE(r->value(0).toString(), QString("http://www.example/book/book5"));
+        delete r;
+    }
+
+    const QVariantMap stats = conn.statistics();
+    QCOMPARE(stats["cacheMisses"].toLongLong(), 1LL);
+    QCOMPARE(stats["cacheHits"].toLongLong(), 1LL);
+    QVERIFY(stats["cacheSize"].toLongLong() > 0);
+    QCOMPARE(stats["maximumCacheSize"].toLongLong(), 1024LL * 1024);
+
+    conn.close();
+    removeDirectory(cacheDirectory);
+}
+
+void tst_QSparqlEndpoint::benchmark_large_select_data()
+{
+    QTest::addColumn<QString>("encoding");
+    QTest::newRow("uncompressed") << "";
+    QTest::newRow("gzip") << "gzip";
+}
+
+void tst_QSparqlEndpoint::benchmark_large_select()
+{
+    QFETCH(QString, encoding);
+
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+    QSparqlQuery q(QString("SELECT ?book ?title # large select %1").arg(encoding));
+
+    QBENCHMARK {
+        QSparqlResult* r = conn.exec(q);
+        r->waitForFinished();
+        QCOMPARE(r->hasError(), false);
+        QCOMPARE(r->size(), EndpointServer::largeResultRows);
+        delete r;
+    }
+}
+
+void tst_QSparqlEndpoint::json_select_query()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("resultsFormat", "json");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("JSON SELECT ?book ?who ?title "
+                   "WHERE { "
+                   "?book a <http://www.example/Book> . "
+                   "?who <http://www.example/Author> ?book . "
+                   "?book <http://www.example/Title> ?title . }");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), false);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+
+    QVERIFY(r->next());
+    QCOMPARE(r->current().count(), 3);
+    QCOMPARE(r->binding(0).name(), QString("book"));
+    QCOMPARE(r->binding(0).toString(), QString("<http://www.example/book/book5>"));
+    QCOMPARE(r->binding(1).toString(), QString("_:r29392923r2922"));
+    QCOMPARE(r->binding(2).value().toString(), QString::fromUtf8("Book \"5\" \xc3\xa9"));
+    QCOMPARE(r->binding(2).languageTag(), QString("en"));
+
+    QVERIFY(r->next());
+    QCOMPARE(r->binding(0).toString(), QString("<http://www.example/book/book6>"));
+    QCOMPARE(r->binding(1).toString(), QString("_:r8484882r49593"));
+    QCOMPARE(r->binding(2).value().type(), QVariant::LongLong);
+    QCOMPARE(r->binding(2).value().toLongLong(), 6LL);
+    QVERIFY(!r->next());
+
+    delete r;
+}
+
+void tst_QSparqlEndpoint::json_ask_query()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("resultsFormat", "json");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("JSON ASK WHERE { ?book <http://www.example/Author> \"J.K. Rowling\"} ", QSparqlQuery::AskStatement);
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->isBool(), true);
+    QCOMPARE(r->boolValue(), true);
+
+    delete r;
+}
+
+void tst_QSparqlEndpoint::json_fallback_to_xml()
+{
+    // The endpoint answers with XML although JSON was asked for
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("resultsFormat", "json");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("SELECT ?book ?who "
+                   "WHERE { "
+                   "?book a <http://www.example/Book> . "
+                   "?who <http://www.example/Author> ?book . }");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+
+    delete r;
+}
+
+void tst_QSparqlEndpoint::json_broken_result()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("resultsFormat", "json");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("json broken result");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), true);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::tsv_select_query()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("resultsFormat", "tsv");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("TSV SELECT ?book ?title ?count ?who "
+                   "WHERE { "
+                   "?book a <http://www.example/Book> . "
+                   "?who <http://www.example/Author> ?book . "
+                   "?book <http://www.example/Title> ?title . "
+                   "OPTIONAL { ?book <http://www.example/Count> ?count } }");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+
+    QVERIFY(r->next());
+    QCOMPARE(r->current().count(), 4);
+    QCOMPARE(r->binding(0).name(), QString("book"));
+    QCOMPARE(r->binding(0).toString(), QString("<http://www.example/book/book5>"));
+    QCOMPARE(r->binding(1).value().toString(), QString::fromUtf8("Book \"5\" \xc3\xa9\tx"));
+    QCOMPARE(r->binding(1).languageTag(), QString("en"));
+    QCOMPARE(r->binding(2).value().type(), QVariant::LongLong);
+    QCOMPARE(r->binding(2).value().toLongLong(), 42LL);
+    QCOMPARE(r->binding(3).toString(), QString("_:r29392923r2922"));
+
+    // ?count is unbound on the last row, which doesn't end with a newline
+    QVERIFY(r->next());
+    QCOMPARE(r->current().count(), 3);
+    QCOMPARE(r->binding(0).toString(), QString("<http://www.example/book/book6>"));
+    QCOMPARE(r->binding(1).dataTypeUri().toString(), QString("http://www.w3.org/2001/XMLSchema#decimal"));
+    QCOMPARE(r->binding(1).value().toDouble(), 2.5);
+    QCOMPARE(r->binding(2).name(), QString("who"));
+    QVERIFY(r->binding(2).isBlank());
+    QVERIFY(!r->next());
+
+    delete r;
+}
+
+void tst_QSparqlEndpoint::tsv_fallback_to_xml()
+{
+    // The endpoint answers with XML although TSV was asked for
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("resultsFormat", "tsv");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("SELECT ?book ?who "
+                   "WHERE { "
+                   "?book a <http://www.example/Book> . "
+                   "?who <http://www.example/Author> ?book . }");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+    delete r;
+
+    // TSV has no form for ASK results
+    q = QSparqlQuery("ASK WHERE { ?book <http://www.example/Author> \"J.K. Rowling\"} ",
+                     QSparqlQuery::AskStatement);
+    r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->isBool(), true);
+    QCOMPARE(r->boolValue(), false);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::tsv_broken_result()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("resultsFormat", "tsv");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("tsv broken result");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished(); // this test is synchronous only
+    QCOMPARE(r->hasError(), true);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::sync_select_query()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+    QVERIFY(conn.hasFeature(QSparqlConnection::SyncExec));
+
+    QSparqlQuery q("SELECT ?book ?who "
+                   "WHERE { "
+                   "?book a <http://www.example/Book> . "
+                   "?who <http://www.example/Author> ?book . }");
+    QSparqlResult* r = conn.syncExec(q);
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), false);
+    QVERIFY(r->hasFeature(QSparqlResult::Sync));
+    QVERIFY(!r->hasFeature(QSparqlResult::ForwardOnly));
+
+    QVERIFY(r->next());
+    QCOMPARE(r->value(0).toString(), QString("http://www.example/book/book5"));
+    QVERIFY(r->next());
+    QCOMPARE(r->value(0).toString(), QString("http://www.example/book/book6"));
+    QVERIFY(!r->next());
+    QVERIFY(r->isFinished());
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+
+    // The rows are kept when the result isn't forward only
+    QVERIFY(r->first());
+    QCOMPARE(r->binding(1).toString(), QString("_:r29392923r2922"));
+
+    delete r;
+}
+
+void tst_QSparqlEndpoint::sync_ask_query()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQuery q("ASK WHERE { ?book <http://www.example/Author> \"J.K. Rowling\"} ", QSparqlQuery::AskStatement);
+    QSparqlResult* r = conn.syncExec(q);
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->isBool(), true);
+    QCOMPARE(r->boolValue(), false);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::sync_query_with_error()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlResult* r = conn.syncExec(QSparqlQuery("bad query"));
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), true);
+    QCOMPARE(r->lastError().type(), QSparqlError::ConnectionError);
+    QVERIFY(!r->next());
+    delete r;
+}
+
+void tst_QSparqlEndpoint::sync_forward_only_large_select()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    // Read ahead only a few rows, so that the reply is paused and resumed
+    options.setOption("syncBufferRows", 100);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQueryOptions queryOptions;
+    queryOptions.setExecutionMethod(QSparqlQueryOptions::SyncExec);
+    queryOptions.setForwardOnly(true);
+    QSparqlResult* r = conn.exec(QSparqlQuery("SELECT ?book ?title # large select gzip"), queryOptions);
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), false);
+    QVERIFY(r->hasFeature(QSparqlResult::ForwardOnly));
+    QCOMPARE(r->size(), -1);
+
+    int count = 0;
+    while (r->next()) {
+        QCOMPARE(r->value(0).toString(),
+                 QString("http://www.example/book/book%1").arg(count));
+        ++count;
+    }
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(count, EndpointServer::largeResultRows);
+    QVERIFY(r->isFinished());
+
+    // Forward only results can't go back
+    QVERIFY(!r->first());
+    delete r;
+
+    // A result deleted before it's read cancels its request
+    r = conn.exec(QSparqlQuery("SELECT ?book ?title # large select"), queryOptions);
+    QVERIFY(r != 0);
+    QVERIFY(r->next());
+    delete r;
+}
+
+void tst_QSparqlEndpoint::network_thread_select_query()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("networkThread", true);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlResult* r = conn.exec(QSparqlQuery("SELECT ?book ?title # large select"));
+    QVERIFY(r != 0);
+    QVERIFY(!r->hasFeature(QSparqlResult::Sync));
+    QSignalSpy dataReadySpy(r, SIGNAL(dataReady(int)));
+    QSignalSpy finishedSpy(r, SIGNAL(finished()));
+
+    // The signals come from the event loop of this thread
+    for (int i = 0; i < 100 && finishedSpy.count() == 0; ++i)
+        QTest::qWait(100);
+    QCOMPARE(finishedSpy.count(), 1);
+    QVERIFY(r->isFinished());
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), EndpointServer::largeResultRows);
+
+    // The rows arrive in blocks
+    QVERIFY(dataReadySpy.count() >= 1);
+    QVERIFY(dataReadySpy.count() < EndpointServer::largeResultRows);
+    QCOMPARE(dataReadySpy.last().at(0).toInt(), EndpointServer::largeResultRows);
+
+    QVERIFY(r->next());
+    QCOMPARE(r->value(0).toString(), QString("http://www.example/book/book0"));
+    QVERIFY(r->last());
+    QCOMPARE(r->value(0).toString(),
+             QString("http://www.example/book/book%1").arg(EndpointServer::largeResultRows - 1));
+    delete r;
+
+    const QVariantMap stats = conn.statistics()["networkThread"].toMap();
+    QCOMPARE(stats["startedRequests"].toLongLong(), 1LL);
+}
+
+void tst_QSparqlEndpoint::network_thread_wait_for_finished()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("networkThread", true);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlResult* r = conn.exec(QSparqlQuery("SELECT ?book ?who"));
+    QVERIFY(r != 0);
+    QSignalSpy finishedSpy(r, SIGNAL(finished()));
+    r->waitForFinished();
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+
+    // No second finished() from the rows published later
+    QTest::qWait(100);
+    QCOMPARE(finishedSpy.count(), 1);
+    delete r;
+
+    r = conn.exec(QSparqlQuery("bad query"));
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), true);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::network_thread_statistics_while_queued()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("networkThread", true);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    // The network thread has the queries queued, but hasn't started them
+    QList<QSparqlResult*> results;
+    for (int i = 0; i < 10; ++i)
+        results.append(conn.exec(QSparqlQuery("SELECT ?book ?who")));
+    QVariantMap stats = conn.statistics()["networkThread"].toMap();
+    QVERIFY(stats.contains("startedRequests"));
+
+    foreach (QSparqlResult* r, results) {
+        r->waitForFinished();
+        QCOMPARE(r->hasError(), false);
+        delete r;
+    }
+    stats = conn.statistics()["networkThread"].toMap();
+    QCOMPARE(stats["startedRequests"].toLongLong(), 10LL);
+}
+
+void tst_QSparqlEndpoint::replica_load_balancing()
+{
+    EndpointService replica1(8081);
+    EndpointService replica2(8082);
+    replica1.start();
+    replica2.start();
+    while (!replica1.isRunning() || !replica2.isRunning())
+        QTest::qWait(100);
+    // Keep the requests in flight while the others are sent
+    replica1.setDelay(300);
+    replica2.setDelay(300);
+
+    QSparqlConnectionOptions options;
+    options.setOption("endpoints", QStringList() << "http://127.0.0.1:8081/sparql"
+                                                 << "http://127.0.0.1:8082/sparql");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QList<QSparqlResult*> results;
+    for (int i = 0; i < 4; ++i)
+        results << conn.exec(QSparqlQuery("SELECT ?book ?who"));
+
+    QVariantMap outstanding = conn.statistics()["outstandingRequests"].toMap();
+    QCOMPARE(outstanding.count(), 2);
+    QCOMPARE(outstanding["http://127.0.0.1:8081/sparql"].toInt(), 2);
+    QCOMPARE(outstanding["http://127.0.0.1:8082/sparql"].toInt(), 2);
+
+    foreach (QSparqlResult* r, results) {
+        r->waitForFinished();
+        QCOMPARE(r->hasError(), false);
+        QCOMPARE(r->size(), 2);
+    }
+    qDeleteAll(results);
+    QCOMPARE(replica1.requestCount(), 2);
+    QCOMPARE(replica2.requestCount(), 2);
+
+    outstanding = conn.statistics()["outstandingRequests"].toMap();
+    QCOMPARE(outstanding["http://127.0.0.1:8081/sparql"].toInt(), 0);
+    QCOMPARE(outstanding["http://127.0.0.1:8082/sparql"].toInt(), 0);
+
+    // The updates go to the first replica
+    QSparqlResult* r = conn.exec(QSparqlQuery("INSERT {<http://www.example/book/book15> a <http://www.example/Book>}",
+                                              QSparqlQuery::InsertStatement));
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+    QCOMPARE(replica1.requestCount(), 3);
+    QCOMPARE(replica2.requestCount(), 2);
+
+    replica1.stopService(2000);
+    replica2.stopService(2000);
+}
+
+void tst_QSparqlEndpoint::hedged_request()
+{
+    EndpointService slowReplica(8081);
+    EndpointService fastReplica(8082);
+    slowReplica.start();
+    fastReplica.start();
+    while (!slowReplica.isRunning() || !fastReplica.isRunning())
+        QTest::qWait(100);
+    slowReplica.setDelay(5000);
+
+    QSparqlConnectionOptions options;
+    options.setOption("endpoints", QStringList() << "http://127.0.0.1:8081/sparql"
+                                                 << "http://127.0.0.1:8082/sparql");
+    options.setOption("hedgeRequests", true);
+    options.setOption("hedgeDelay", 100);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    // The query goes to the slow replica first, and after the hedge delay
+    // to the fast one, which answers
+    QElapsedTimer timer;
+    timer.start();
+    QSparqlResult* r = conn.exec(QSparqlQuery("SELECT ?book ?who"));
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QVERIFY(timer.elapsed() < 4000);
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 2);
+    QVERIFY(r->next());
+    QCOMPARE(r->current().count(), 2);
+    delete r;
+
+    QCOMPARE(slowReplica.requestCount(), 1);
+    QCOMPARE(fastReplica.requestCount(), 1);
+    QVariantMap stats = conn.statistics();
+    QCOMPARE(stats["hedgedRequests"].toLongLong(), 1LL);
+    QCOMPARE(stats["hedgeWins"].toLongLong(), 1LL);
+
+    // The cancelled request doesn't count as outstanding any more
+    const QVariantMap outstanding = stats["outstandingRequests"].toMap();
+    QCOMPARE(outstanding["http://127.0.0.1:8081/sparql"].toInt(), 0);
+    QCOMPARE(outstanding["http://127.0.0.1:8082/sparql"].toInt(), 0);
+    QCOMPARE(stats["inFlightRequests"].toInt(), 0);
+
+    slowReplica.stopService(2000);
+    fastReplica.stopService(2000);
+}
+
+void tst_QSparqlEndpoint::hedged_request_host_saturated()
+{
+    EndpointService replica1(8081);
+    EndpointService replica2(8082);
+    replica1.start();
+    replica2.start();
+    while (!replica1.isRunning() || !replica2.isRunning())
+        QTest::qWait(100);
+    replica1.setDelay(1000);
+    replica2.setDelay(1000);
+
+    QSparqlConnectionOptions options;
+    options.setOption("endpoints", QStringList() << "http://127.0.0.1:8081/sparql"
+                                                 << "http://127.0.0.1:8082/sparql");
+    options.setOption("hedgeRequests", true);
+    options.setOption("hedgeDelay", 100);
+    options.setOption("maxRequestsPerHost", 1);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    // One query goes to each replica, and then neither has a free slot for
+    // the hedge of the other one
+    QSparqlResult* r1 = conn.exec(QSparqlQuery("SELECT ?book ?who"));
+    QSparqlResult* r2 = conn.exec(QSparqlQuery("SELECT ?book ?who"));
+    QVERIFY(r1 != 0);
+    QVERIFY(r2 != 0);
+    r1->waitForFinished();
+    r2->waitForFinished();
+    QCOMPARE(r1->hasError(), false);
+    QCOMPARE(r2->hasError(), false);
+    delete r1;
+    delete r2;
+
+    QCOMPARE(replica1.requestCount(), 1);
+    QCOMPARE(replica2.requestCount(), 1);
+    const QVariantMap stats = conn.statistics();
+    QCOMPARE(stats["hedgedRequests"].toLongLong(), 0LL);
+    QCOMPARE(stats["inFlightRequests"].toInt(), 0);
+
+    replica1.stopService(2000);
+    replica2.stopService(2000);
+}
+
+void tst_QSparqlEndpoint::paged_select_query()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QSparqlQueryOptions queryOptions;
+    queryOptions.setPageSize(1500);
+    queryOptions.setMaxConcurrentPages(3);
+    QSparqlResult* r = conn.exec(QSparqlQuery("SELECT ?book ?title # large select"), queryOptions);
+    QVERIFY(r != 0);
+    QSignalSpy dataReadySpy(r, SIGNAL(dataReady(int)));
+    QSignalSpy finishedSpy(r, SIGNAL(finished()));
+    r->waitForFinished();
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), EndpointServer::largeResultRows);
+
+    // The pages are published in order, the last one isn't full
+    QVERIFY(dataReadySpy.count() >= 1);
+    for (int i = 0; i < dataReadySpy.count(); ++i) {
+        const int count = dataReadySpy.at(i).at(0).toInt();
+        QVERIFY(count % 1500 == 0 || count == EndpointServer::largeResultRows);
+    }
+    QCOMPARE(dataReadySpy.last().at(0).toInt(), EndpointServer::largeResultRows);
+
+    int i = 0;
+    while (r->next()) {
+        QCOMPARE(r->value(0).toString(), QString("http://www.example/book/book%1").arg(i));
+        ++i;
+    }
+    QCOMPARE(i, EndpointServer::largeResultRows);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::sync_paged_select_query()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    // An exact number of pages ends with an empty page
+    QSparqlQueryOptions queryOptions;
+    queryOptions.setExecutionMethod(QSparqlQueryOptions::SyncExec);
+    queryOptions.setPageSize(EndpointServer::largeResultRows / 4);
+    QSparqlResult* r = conn.exec(QSparqlQuery("SELECT ?book ?title # large select"), queryOptions);
+    QVERIFY(r != 0);
+    QVERIFY(r->isFinished());
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), EndpointServer::largeResultRows);
+    QVERIFY(r->last());
+    QCOMPARE(r->value(0).toString(),
+             QString("http://www.example/book/book%1").arg(EndpointServer::largeResultRows - 1));
+    delete r;
+
+    // A query with a LIMIT of its own isn't paged
+    QSparqlQueryOptions pagedOptions;
+    pagedOptions.setPageSize(5);
+    r = conn.exec(QSparqlQuery("SELECT ?book ?title # large select\nLIMIT 10 OFFSET 20"), pagedOptions);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 10);
+    QVERIFY(r->first());
+    QCOMPARE(r->value(0).toString(), QString("http://www.example/book/book20"));
+    delete r;
+
+    // Nor is a query ending with a VALUES block, which LIMIT can't follow
+    const int served = endpointService->requestCount();
+    r = conn.exec(QSparqlQuery("SELECT ?book ?title { ?book ?p ?title } "
+                               "VALUES ?title { \"a\" } # large select"), pagedOptions);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), EndpointServer::largeResultRows);
+    QCOMPARE(endpointService->requestCount(), served + 1);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::upload_graph()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+    QVERIFY(conn.hasFeature(QSparqlConnection::GraphUpload));
+
+    QByteArray triples;
+    for (int i = 0; i < 100; ++i)
+        triples += QString("<http://www.example/book/book%1> <http://www.example/Title> \"Book %1\" .\n")
+                   .arg(i).toUtf8();
+    QBuffer buffer(&triples);
+    buffer.open(QIODevice::ReadOnly);
+
+    // A device with a size is sent in one request
+    const int before = endpointService->uploadRequests().count();
+    QSparqlResult* r = conn.uploadGraph(&buffer, "application/n-triples",
+                                        QUrl("http://www.example/books"));
+    QVERIFY(r != 0);
+    QSignalSpy finishedSpy(r, SIGNAL(finished()));
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(finishedSpy.count(), 1);
+    delete r;
+
+    const QStringList uploads = endpointService->uploadRequests().mid(before);
+    QCOMPARE(uploads.count(), 1);
+    QVERIFY(uploads[0].startsWith("POST "));
+    QVERIFY(uploads[0].contains("graph=http"));
+    QCOMPARE(endpointService->uploadBodies().last(), triples);
+
+    // Replacing the default graph
+    buffer.seek(0);
+    r = conn.uploadGraph(&buffer, "application/n-triples", QUrl(), QSparqlConnection::ReplaceGraph);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+    QVERIFY(endpointService->uploadRequests().last().startsWith("PUT "));
+    QVERIFY(endpointService->uploadRequests().last().contains("default"));
+}
+
+void tst_QSparqlEndpoint::upload_graph_queued()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("maxRequestsPerHost", 1);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QByteArray triples("<http://www.example/book/book1> <http://www.example/Title> \"Book 1\" .\n");
+    QBuffer buffer(&triples);
+    buffer.open(QIODevice::ReadOnly);
+
+    // The upload waits for the query to free the only slot of the host
+    QSparqlResult* q = conn.exec(QSparqlQuery("SELECT ?book ?who "
+                                              "WHERE { ?book a <http://www.example/Book> . }"));
+    QSparqlResult* r = conn.uploadGraph(&buffer, "application/n-triples",
+                                        QUrl("http://www.example/books"));
+    QVERIFY(q != 0);
+    QVERIFY(r != 0);
+    QVariantMap stats = conn.statistics();
+    QCOMPARE(stats["inFlightRequests"].toInt(), 1);
+    QCOMPARE(stats["queuedRequests"].toInt(), 1);
+
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QVERIFY(q->isFinished());
+    QCOMPARE(q->hasError(), false);
+    delete q;
+    delete r;
+
+    stats = conn.statistics();
+    QCOMPARE(stats["inFlightRequests"].toInt(), 0);
+    QCOMPARE(stats["queuedRequests"].toInt(), 0);
+    QCOMPARE(stats["startedRequests"].toLongLong(), 2LL);
+}
+
+void tst_QSparqlEndpoint::upload_graph_from_sequential_device()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("uploadChunkSize", 1000);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QByteArray triples;
+    for (int i = 0; i < 100; ++i)
+        triples += QString("<http://www.example/book/book%1> <http://www.example/Title> \"Book %1\" .\n")
+                   .arg(i).toUtf8();
+    SequentialDevice device(triples);
+
+    const int before = endpointService->uploadRequests().count();
+    QSparqlResult* r = conn.uploadGraph(&device, "application/n-triples",
+                                        QUrl("http://www.example/books"),
+                                        QSparqlConnection::ReplaceGraph);
+    QVERIFY(r != 0);
+    QSignalSpy progressSpy(r, SIGNAL(uploadProgress(qint64, qint64)));
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+
+    // The data is sent in chunks of whole lines; the first one replaces the
+    // graph and the others add to it
+    const QStringList uploads = endpointService->uploadRequests().mid(before);
+    const QList<QByteArray> bodies = endpointService->uploadBodies().mid(before);
+    QVERIFY(uploads.count() > 1);
+    QVERIFY(uploads[0].startsWith("PUT "));
+    QByteArray received;
+    for (int i = 0; i < bodies.count(); ++i) {
+        if (i > 0)
+            QVERIFY(uploads[i].startsWith("POST "));
+        QVERIFY(bodies[i].size() <= 1000);
+        QVERIFY(bodies[i].endsWith('\n'));
+        received += bodies[i];
+    }
+    QCOMPARE(received, triples);
+
+    QVERIFY(progressSpy.count() >= uploads.count());
+    QCOMPARE(progressSpy.last().at(0).toLongLong(), qint64(triples.size()));
+    QCOMPARE(progressSpy.last().at(1).toLongLong(), -1LL);
+
+    // Other formats can't be split
+    SequentialDevice rdfXml("<rdf:RDF/>");
+    r = conn.uploadGraph(&rdfXml, "application/rdf+xml");
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), true);
+    delete r;
+}
+
+void tst_QSparqlEndpoint::upload_turtle_from_sequential_device()
+{
+    QSparqlConnectionOptions options;
+    options.setPort(8080);
+    options.setHostName("127.0.0.1");
+    options.setOption("uploadChunkSize", 200);
+    QSparqlConnection conn("QSPARQL_ENDPOINT", options);
+
+    QByteArray turtle = "@prefix ex: <http://www.example/> .\n";
+    for (int i = 0; i < 20; ++i)
+        turtle += QString("ex:book%1 a ex:Book ;\n"
+                          "    ex:Title \"\"\"Book %1.\nSecond line.\"\"\" .\n").arg(i).toUtf8();
+    SequentialDevice device(turtle);
+
+    const int before = endpointService->uploadRequests().count();
+    QSparqlResult* r = conn.uploadGraph(&device, "text/turtle");
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+
+    // Each chunk is whole statements, and has the prefix
+    const QList<QByteArray> bodies = endpointService->uploadBodies().mid(before);
+    QVERIFY(bodies.count() > 1);
+    QByteArray received;
+    for (int i = 0; i < bodies.count(); ++i) {
+        QVERIFY(bodies[i].startsWith("@prefix ex: <http://www.example/> .\n"));
+        QVERIFY(bodies[i].endsWith("\"\"\" .\n"));
+        received += i == 0 ? bodies[i] : bodies[i].mid(bodies[i].indexOf('\n') + 1);
+    }
+    QCOMPARE(received, turtle);
+}
+
 QTEST_MAIN( tst_QSparqlEndpoint )
 #include "tst_qsparql_endpoint.moc"
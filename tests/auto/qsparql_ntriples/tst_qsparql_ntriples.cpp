@@ -57,6 +57,8 @@ public slots:
 
 private slots:
     void parse_file();
+    void parse_chunks_data();
+    void parse_chunks();
 };
 
 tst_QSparqlNTriples::tst_QSparqlNTriples()
@@ -217,5 +219,49 @@ void tst_QSparqlNTriples::parse_file()
 
 }
 
+void tst_QSparqlNTriples::parse_chunks_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::newRow("1 byte") << 1;
+    QTest::newRow("7 bytes") << 7;
+    QTest::newRow("64 bytes") << 64;
+    QTest::newRow("whole file") << 100000;
+}
+
+void tst_QSparqlNTriples::parse_chunks()
+{
+    QFETCH(int, chunkSize);
+
+    QFile file("test.nt");
+    QCOMPARE(file.open(QIODevice::ReadOnly), true);
+    QByteArray buffer = file.readAll();
+    QSparqlNTriples wholeParser(buffer);
+    QVector<QSparqlResultRow> expected = wholeParser.parse();
+
+    // Feeding the file in chunks gives the same triples, and the triples on
+    // the complete lines are available right away
+    QSparqlNTriples parser;
+    QVector<QSparqlResultRow> results;
+    for (int i = 0; i < buffer.size(); i += chunkSize) {
+        const QByteArray chunk = buffer.mid(i, chunkSize);
+        results += parser.parseChunk(chunk);
+        if (chunk.endsWith('\n'))
+            QVERIFY(parser.partialLine.isEmpty());
+    }
+    results += parser.finish();
+
+    QCOMPARE(results.count(), expected.count());
+    for (int i = 0; i < results.count(); ++i) {
+        QCOMPARE(results[i].count(), expected[i].count());
+        for (int j = 0; j < results[i].count(); ++j)
+            QCOMPARE(results[i].binding(j).toString(), expected[i].binding(j).toString());
+    }
+
+    // The last line doesn't need a newline
+    QSparqlNTriples lastLine;
+    QCOMPARE(lastLine.parseChunk("<http://example.org/a> <http://example.org/p> \"x\" .").count(), 0);
+    QCOMPARE(lastLine.finish().count(), 1);
+}
+
 QTEST_MAIN(tst_QSparqlNTriples)
 #include "tst_qsparql_ntriples.moc"
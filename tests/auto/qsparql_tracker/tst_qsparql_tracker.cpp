@@ -59,8 +59,12 @@ private slots:
     void insert_new_urn();
 
     void batch_update();
+    void batch_window_update();
+    void batch_window_update_separators();
 
     void iterate_result();
+    void column_names_and_types();
+    void large_result();
 
     void delete_unfinished_result();
 
@@ -288,6 +292,155 @@ void tst_QSparqlTracker::batch_update()
     delete r;
 }
 
+void tst_QSparqlTracker::batch_window_update()
+{
+    QSparqlConnectionOptions opts;
+    opts.setOption(QString::fromLatin1("batchWindow"), QVariant(1000));
+    // This test will leave unclean test data into tracker if it crashes.
+    QSparqlConnection conn("QTRACKER", opts);
+    QSparqlQuery add1("insert { <addeduri003> a nco:PersonContact; "
+                      "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                      "nco:nameGiven \"addedname003\" .}",
+                      QSparqlQuery::InsertStatement);
+    QSparqlQuery add2("insert { <addeduri004> a nco:PersonContact; "
+                      "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                      "nco:nameGiven \"addedname004\" .}",
+                      QSparqlQuery::InsertStatement);
+
+    QSparqlResult* r1 = conn.exec(add1);
+    CHECK_QSPARQL_RESULT(r1);
+    QSparqlResult* r2 = conn.exec(add2);
+    CHECK_QSPARQL_RESULT(r2);
+    // The updates wait for the batch window to pass
+    QVERIFY(!r1->isFinished());
+    QVERIFY(!r2->isFinished());
+    QSignalSpy spy1(r1, SIGNAL(finished()));
+    QSignalSpy spy2(r2, SIGNAL(finished()));
+
+    conn.flush();
+    r2->waitForFinished();
+    CHECK_QSPARQL_RESULT(r2);
+    // Both were sent in the same batch
+    QVERIFY(r1->isFinished());
+    CHECK_QSPARQL_RESULT(r1);
+    QCOMPARE(spy1.count(), 1);
+    QCOMPARE(spy2.count(), 1);
+    delete r1;
+    delete r2;
+
+    // Verify that the insertions succeeded
+    QSparqlQuery q("select ?u ?ng {?u a nco:PersonContact; "
+                   "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                   "nco:nameGiven ?ng .}");
+    QSparqlResult* r = conn.exec(q);
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    QCOMPARE(r->size(), 5);
+    delete r;
+
+    // Delete the uris; waitForFinished() sends the batch without waiting
+    // for the window to pass
+    QSparqlQuery del("delete { <addeduri003> a rdfs:Resource. "
+                     "<addeduri004> a rdfs:Resource. }",
+                     QSparqlQuery::DeleteStatement);
+    r = conn.exec(del);
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    delete r;
+
+    r = conn.exec(q);
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    QCOMPARE(r->size(), 3);
+    delete r;
+
+    // A query sends the updates queued before it, and sees them
+    r1 = conn.exec(add1);
+    CHECK_QSPARQL_RESULT(r1);
+    QVERIFY(!r1->isFinished());
+    r = conn.exec(q);
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    QCOMPARE(r->size(), 4);
+    delete r;
+    r1->waitForFinished();
+    CHECK_QSPARQL_RESULT(r1);
+    delete r1;
+
+    r = conn.exec(QSparqlQuery("delete { <addeduri003> a rdfs:Resource. }",
+                               QSparqlQuery::DeleteStatement));
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    delete r;
+}
+
+void tst_QSparqlTracker::batch_window_update_separators()
+{
+    QSparqlConnectionOptions opts;
+    opts.setOption(QString::fromLatin1("batchWindow"), QVariant(1000));
+    // This test will leave unclean test data into tracker if it crashes.
+    QSparqlConnection conn("QTRACKER", opts);
+    // Updates ending with a separator or a comment, and one with a prologue
+    // of its own, in the same batch window
+    QList<QSparqlQuery> adds;
+    adds << QSparqlQuery("insert { <addeduri005> a nco:PersonContact; "
+                         "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                         "nco:nameGiven \"addedname005\" .} ;",
+                         QSparqlQuery::InsertStatement)
+         << QSparqlQuery("insert { <addeduri006> a nco:PersonContact; "
+                         "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                         "nco:nameGiven \"addedname006\" .} # no separator",
+                         QSparqlQuery::InsertStatement)
+         << QSparqlQuery("PREFIX contact: <http://www.semanticdesktop.org/ontologies/2007/03/22/nco#> "
+                         "insert { <addeduri007> a contact:PersonContact; "
+                         "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                         "contact:nameGiven \"addedname007\" .}",
+                         QSparqlQuery::InsertStatement)
+         << QSparqlQuery("insert { <addeduri008> a nco:PersonContact; "
+                         "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                         "nco:nameGiven \"addedname008\" .}",
+                         QSparqlQuery::InsertStatement);
+
+    QList<QSparqlResult*> results;
+    foreach (const QSparqlQuery& add, adds) {
+        QSparqlResult* r = conn.exec(add);
+        CHECK_QSPARQL_RESULT(r);
+        results.append(r);
+    }
+    conn.flush();
+    foreach (QSparqlResult* r, results) {
+        r->waitForFinished();
+        CHECK_QSPARQL_RESULT(r);
+    }
+    qDeleteAll(results);
+
+    QSparqlQuery q("select ?u ?ng {?u a nco:PersonContact; "
+                   "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                   "nco:nameGiven ?ng .}");
+    QSparqlResult* r = conn.exec(q);
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    QCOMPARE(r->size(), 7);
+    delete r;
+
+    QSparqlQuery del("delete { <addeduri005> a rdfs:Resource. "
+                     "<addeduri006> a rdfs:Resource. "
+                     "<addeduri007> a rdfs:Resource. "
+                     "<addeduri008> a rdfs:Resource. }",
+                     QSparqlQuery::DeleteStatement);
+    r = conn.exec(del);
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    delete r;
+}
+
 void tst_QSparqlTracker::iterate_result()
 {
     // This test will print out warnings
@@ -336,6 +489,73 @@ void tst_QSparqlTracker::iterate_result()
     delete r;
 }
 
+void tst_QSparqlTracker::column_names_and_types()
+{
+    QSparqlConnection conn("QTRACKER");
+    QSparqlQuery q("select ?u ?ng fn:string-length(?ng) {?u a nco:PersonContact; "
+                   "nie:isLogicalPartOf <qsparql-tracker-tests> ;"
+                   "nco:nameGiven ?ng .}");
+    QSparqlResult* r = conn.exec(q);
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished(); // this test is syncronous only
+    CHECK_QSPARQL_RESULT(r);
+    QCOMPARE(r->size(), 3);
+
+    while (r->next()) {
+        QSparqlResultRow row = r->current();
+        QCOMPARE(row.count(), 3);
+        QCOMPARE(row.indexOf("u"), 0);
+        QCOMPARE(row.indexOf("ng"), 1);
+        QCOMPARE(row.binding("u").isUri(), true);
+        QCOMPARE(row.value("ng").type(), QVariant::String);
+        QCOMPARE(row.value("ng").toString().mid(0, 6), QString("name00"));
+        QCOMPARE(r->binding(1).name(), QString("ng"));
+        QCOMPARE(r->value(2).type(), QVariant::LongLong);
+        QCOMPARE(r->value(2).toLongLong(), 7LL);
+    }
+    delete r;
+}
+
+void tst_QSparqlTracker::large_result()
+{
+    // Results bigger than the pipe buffer are written by Tracker in many
+    // chunks, which waitForFinished() has to read while it waits
+    QSparqlConnection conn("QTRACKER");
+    const QString title(1000, QChar('x'));
+    QString insertQuery = "insert { ";
+    for (int item = 1; item <= 200; ++item) {
+        insertQuery.append(QString("<large%1> a nie:InformationElement ; "
+                                   "nie:isLogicalPartOf <qsparql-tracker-tests> ; "
+                                   "nie:title \"%2\" . ").arg(item).arg(title));
+    }
+    insertQuery.append("}");
+    QSparqlResult* r = conn.exec(QSparqlQuery(insertQuery, QSparqlQuery::InsertStatement));
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    delete r;
+
+    r = conn.exec(QSparqlQuery("select ?u ?t {?u a nie:InformationElement ; "
+                               "nie:isLogicalPartOf <qsparql-tracker-tests> ; "
+                               "nie:title ?t .}"));
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    QCOMPARE(r->size(), 200);
+    while (r->next())
+        QCOMPARE(r->value(1).toString(), title);
+    delete r;
+
+    r = conn.exec(QSparqlQuery("delete { ?u a rdfs:Resource . } "
+                               "where { ?u nie:isLogicalPartOf <qsparql-tracker-tests> ; "
+                               "nie:title ?t . }",
+                               QSparqlQuery::DeleteStatement));
+    CHECK_QSPARQL_RESULT(r);
+    r->waitForFinished();
+    CHECK_QSPARQL_RESULT(r);
+    delete r;
+}
+
 void tst_QSparqlTracker::delete_unfinished_result()
 {
     QSparqlConnection conn("QTRACKER");
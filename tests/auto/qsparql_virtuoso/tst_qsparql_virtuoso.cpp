@@ -43,6 +43,34 @@
 #define TEST_PORT 1234
 // #define TEST_PORT 1111
 
+// Gives a few lines of N-Triples, and then fails to read
+class FailingDevice : public QIODevice
+{
+public:
+    FailingDevice(bool sequential) : sequential(sequential), lines(0) {}
+    bool isSequential() const { return sequential; }
+    qint64 size() const { return sequential ? 0 : 1024 * 1024; }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize)
+    {
+        if (lines++ >= 10) {
+            setErrorString("Broken device");
+            return -1;
+        }
+        const QByteArray line = QString("<http://www.example/book/book%1> <http://www.example/Title> \"Book\" .\n")
+                                .arg(lines).toUtf8();
+        const qint64 length = qMin(maxSize, qint64(line.size()));
+        memcpy(data, line.constData(), length);
+        return length;
+    }
+    qint64 writeData(const char*, qint64) { return -1; }
+
+private:
+    bool sequential;
+    int lines;
+};
+
 class tst_QSparqlVirtuoso : public QObject
 {
     Q_OBJECT
@@ -67,6 +95,26 @@ private slots:
     void select_datatypes();
     void select_blanknode();
     void iterate_on_dataready();
+    void async_queries_on_pooled_threads();
+    void async_queries_on_pooled_connections();
+    void async_queries_on_pooled_connections_data();
+    void prepared_queries_with_bound_values();
+    void row_array_fetch();
+    void row_array_fetch_data();
+    void construct_non_latin1_literals();
+    void construct_on_dataready();
+    void queries_before_connection_open();
+    void connection_open_error();
+    void inserts_in_transaction();
+    void inserts_in_transaction_data();
+    void upload_graphs_in_parallel();
+    void upload_graph_read_error();
+
+    // Benchmarks
+    void small_query_throughput();
+    void small_query_throughput_data();
+    // Reference benchmarks
+    void thread_creating_overhead();
 
 private:
     int previousTotalResults;
@@ -434,5 +482,582 @@ void tst_QSparqlVirtuoso::iterate_on_dataready()
     QCOMPARE(r->hasError(), false);
 }
 
+namespace {
+
+const int NO_SMALL_QUERIES = 200;
+
+class IdleThread : public QThread
+{
+public:
+    IdleThread() : hasRun(false) { }
+    void run() { hasRun = true; }
+    bool hasRun;
+};
+
+} // end unnamed namespace
+
+void tst_QSparqlVirtuoso::async_queries_on_pooled_threads()
+{
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    options.setMaxThreadCount(2);
+    QSparqlConnection conn("QVIRTUOSO", options);
+    conn.addPrefix("nco", QUrl("http://www.semanticdesktop.org/ontologies/2007/03/22/nco#"));
+    conn.addPrefix("nie", QUrl("http://www.semanticdesktop.org/ontologies/2007/01/19/nie#"));
+
+    QSparqlQuery q("ask from <http://virtuoso/testgraph> { "
+                   " ?u a nco:PersonContact; "
+                   " nie:isLogicalPartOf <qsparql-virtuoso-tests> ; "
+                   "nco:nameGiven \"name001\" . }", QSparqlQuery::AskStatement);
+
+    // More results than pooled threads; the rest wait in the queue of the
+    // pool until a thread is free
+    QList<QSparqlResult*> results;
+    for (int i = 0; i < 10; ++i) {
+        QSparqlResult* r = conn.exec(q);
+        QVERIFY(r != 0);
+        QCOMPARE(r->hasError(), false);
+        results.append(r);
+    }
+    // The fetchers are queued on the pool from the event loop
+    QTest::qWait(10);
+    // Deleting a result which is queued but not run must not block
+    delete results.takeLast();
+
+    foreach (QSparqlResult* r, results) {
+        r->waitForFinished();
+        QCOMPARE(r->hasError(), false);
+        QCOMPARE(r->isFinished(), true);
+        QCOMPARE(r->boolValue(), true);
+    }
+    qDeleteAll(results);
+}
+
+void tst_QSparqlVirtuoso::async_queries_on_pooled_connections()
+{
+    QFETCH(int, minConnections);
+    QFETCH(int, maxConnections);
+    QFETCH(int, idleTimeout);
+
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    options.setMaxThreadCount(4);
+    options.setOption("minConnections", minConnections);
+    options.setOption("maxConnections", maxConnections);
+    options.setOption("connectionIdleTimeout", idleTimeout);
+    QSparqlConnection conn("QVIRTUOSO", options);
+
+    QSparqlQuery q("select ?u ?ng "
+                   "from <http://virtuoso/testgraph> "
+                   " {?u a <http://www.semanticdesktop.org/ontologies/2007/03/22/nco#PersonContact>; "
+                   "<http://www.semanticdesktop.org/ontologies/2007/01/19/nie#isLogicalPartOf> <qsparql-virtuoso-tests> ;"
+                   "<http://www.semanticdesktop.org/ontologies/2007/03/22/nco#nameGiven> ?ng .}");
+
+    QList<QSparqlResult*> results;
+    for (int i = 0; i < 8; ++i) {
+        QSparqlResult* r = conn.exec(q);
+        QVERIFY(r != 0);
+        QCOMPARE(r->hasError(), false);
+        results.append(r);
+    }
+    // Let the pooled threads pick up the queries before waiting for them
+    QTest::qWait(100);
+
+    foreach (QSparqlResult* r, results) {
+        r->waitForFinished();
+        QCOMPARE(r->hasError(), false);
+        QCOMPARE(r->size(), 3);
+    }
+    qDeleteAll(results);
+}
+
+void tst_QSparqlVirtuoso::async_queries_on_pooled_connections_data()
+{
+    QTest::addColumn<int>("minConnections");
+    QTest::addColumn<int>("maxConnections");
+    QTest::addColumn<int>("idleTimeout");
+
+    QTest::newRow("oneConnection") << 1 << 1 << 60000;
+    QTest::newRow("lazyConnections") << 0 << 4 << 60000;
+    QTest::newRow("expiringConnections") << 0 << 4 << 0;
+    QTest::newRow("moreThreadsThanConnections") << 1 << 2 << 60000;
+}
+
+void tst_QSparqlVirtuoso::prepared_queries_with_bound_values()
+{
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    // One connection, so the second query reuses the prepared statement
+    options.setOption("minConnections", 1);
+    options.setOption("maxConnections", 1);
+    QSparqlConnection conn("QVIRTUOSO", options);
+    conn.addPrefix("nco", QUrl("http://www.semanticdesktop.org/ontologies/2007/03/22/nco#"));
+    conn.addPrefix("nie", QUrl("http://www.semanticdesktop.org/ontologies/2007/01/19/nie#"));
+
+    QSparqlQuery q("select ?u from <http://virtuoso/testgraph> "
+                   " {?u a nco:PersonContact; "
+                   "nie:isLogicalPartOf ?:part ;"
+                   "nco:nameGiven ?:name .}");
+    q.bindValue("part", QUrl("qsparql-virtuoso-tests"));
+
+    QStringList names;
+    names << "name001" << "name002" << "name005";
+    QList<int> expected;
+    expected << 1 << 1 << 0;
+
+    for (int i = 0; i < names.count(); ++i) {
+        q.bindValue("name", names[i]);
+        QSparqlResult* r = conn.exec(q);
+        QVERIFY(r != 0);
+        QCOMPARE(r->hasError(), false);
+        r->waitForFinished();
+        QCOMPARE(r->hasError(), false);
+        QCOMPARE(r->size(), expected[i]);
+        // The query of the result has the values in it
+        QVERIFY(r->query().contains(names[i]));
+        delete r;
+    }
+}
+
+void tst_QSparqlVirtuoso::row_array_fetch()
+{
+    QFETCH(int, rowArraySize);
+    QFETCH(int, dataReadyInterval);
+
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    options.setDataReadyInterval(dataReadyInterval);
+    options.setOption("rowArraySize", rowArraySize);
+    QSparqlConnection conn("QVIRTUOSO", options);
+
+    QSparqlConnectionOptions rowByRowOptions;
+    rowByRowOptions.setDatabaseName(driverPath);
+    rowByRowOptions.setPort(portNumber);
+    rowByRowOptions.setOption("rowArraySize", 1);
+    QSparqlConnection rowByRowConn("QVIRTUOSO", rowByRowOptions);
+
+    QSparqlQuery q("SELECT ?s ?p ?o WHERE { ?s ?p ?o . } ORDER BY ?s ?p ?o LIMIT 500");
+
+    QSparqlResult* expected = rowByRowConn.exec(q);
+    expected->waitForFinished();
+    QCOMPARE(expected->hasError(), false);
+
+    QSparqlResult* r = conn.exec(q);
+    QSignalSpy dataReadySpy(r, SIGNAL(dataReady(int)));
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), expected->size());
+
+    // The blocks don't change the values nor their types
+    while (r->next()) {
+        QVERIFY(expected->next());
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(r->binding(i).toString(), expected->binding(i).toString());
+            QCOMPARE(r->binding(i).name(), expected->binding(i).name());
+        }
+    }
+
+    // The last dataReady has the total count, and the counts grow
+    QVERIFY(dataReadySpy.count() > 0);
+    QCOMPARE(dataReadySpy.last().at(0).toInt(), r->size());
+    int previous = 0;
+    for (int i = 0; i < dataReadySpy.count(); ++i) {
+        QVERIFY(dataReadySpy.at(i).at(0).toInt() > previous);
+        previous = dataReadySpy.at(i).at(0).toInt();
+    }
+
+    delete r;
+    delete expected;
+}
+
+void tst_QSparqlVirtuoso::row_array_fetch_data()
+{
+    QTest::addColumn<int>("rowArraySize");
+    QTest::addColumn<int>("dataReadyInterval");
+
+    QTest::newRow("default") << 256 << 1;
+    QTest::newRow("blocksNotMultipleOfInterval") << 7 << 10;
+    QTest::newRow("intervalLargerThanBlocks") << 16 << 100;
+    QTest::newRow("rowByRow") << 1 << 1;
+}
+
+void tst_QSparqlVirtuoso::construct_non_latin1_literals()
+{
+    // This test will leave unclean test data into virtuoso if it crashes.
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    QSparqlConnection conn("QVIRTUOSO", options);
+    conn.addPrefix("nco", QUrl("http://www.semanticdesktop.org/ontologies/2007/03/22/nco#"));
+
+    const QString name = QString::fromUtf8("N\xc3\xa4m\xc3\xa9 \xe6\xbc\xa2\xe5\xad\x97 \xd0\x98\xd0\xbc\xd1\x8f");
+    QSparqlQuery add("insert into <http://virtuoso/testgraph> "
+                     "{ <addeduri002> nco:nameGiven ?:name . }",
+                     QSparqlQuery::InsertStatement);
+    add.bindValue("name", name);
+    QSparqlResult* r = conn.exec(add);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+
+    QSparqlQuery q("construct { <addeduri002> nco:nameGiven ?ng } "
+                   "from <http://virtuoso/testgraph> "
+                   "where { <addeduri002> nco:nameGiven ?ng . }",
+                   QSparqlQuery::ConstructStatement);
+    r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 1);
+    QVERIFY(r->next());
+    QCOMPARE(r->value(2).toString(), name);
+    delete r;
+
+    QSparqlQuery del("DELETE FROM GRAPH <http://virtuoso/testgraph> "
+                     "{ <addeduri002> ?p ?o . } "
+                     "FROM <http://virtuoso/testgraph> "
+                     "WHERE { <addeduri002> ?p ?o . }",
+                     QSparqlQuery::DeleteStatement);
+    r = conn.exec(del);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+}
+
+void tst_QSparqlVirtuoso::construct_on_dataready()
+{
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    options.setDataReadyInterval(100);
+    QSparqlConnection conn("QVIRTUOSO", options);
+
+    QSparqlQuery q("construct { ?s ?p ?o } where { ?s ?p ?o . } limit 5000",
+                   QSparqlQuery::ConstructStatement);
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    QSignalSpy dataReadySpy(r, SIGNAL(dataReady(int)));
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QVERIFY(r->size() > 0);
+
+    // The triples are published as they are parsed, and every row is a
+    // complete triple
+    QVERIFY(dataReadySpy.count() > 0);
+    QCOMPARE(dataReadySpy.last().at(0).toInt(), r->size());
+    while (r->next())
+        QCOMPARE(r->current().count(), 3);
+    delete r;
+}
+
+void tst_QSparqlVirtuoso::queries_before_connection_open()
+{
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    QSparqlConnection conn("QVIRTUOSO", options);
+
+    // The query is queued until the connection is up
+    QSparqlQuery q("select ?u ?ng "
+                   "from <http://virtuoso/testgraph> "
+                   " {?u a <http://www.semanticdesktop.org/ontologies/2007/03/22/nco#PersonContact>; "
+                   "<http://www.semanticdesktop.org/ontologies/2007/01/19/nie#isLogicalPartOf> <qsparql-virtuoso-tests> ;"
+                   "<http://www.semanticdesktop.org/ontologies/2007/03/22/nco#nameGiven> ?ng .}");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), false);
+    QSignalSpy finishedSpy(r, SIGNAL(finished()));
+    for (int i = 0; i < 100 && finishedSpy.isEmpty(); ++i)
+        QTest::qWait(100);
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 3);
+    delete r;
+
+    QVERIFY(conn.statistics()["connectTime"].toLongLong() >= 0);
+    QVERIFY(conn.statistics()["pooledConnections"].toInt() >= 1);
+
+    // A sync query waits for the connection instead
+    QSparqlConnection syncConn("QVIRTUOSO", options);
+    r = syncConn.syncExec(q);
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 3);
+    delete r;
+}
+
+void tst_QSparqlVirtuoso::connection_open_error()
+{
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    // Nothing listens here; the connection doesn't fail until it's tried
+    options.setPort(1);
+    QSparqlConnection conn("QVIRTUOSO", options);
+
+    QSparqlResult* r = conn.exec(QSparqlQuery("ask {?s ?p ?o}", QSparqlQuery::AskStatement));
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), true);
+    QCOMPARE(r->lastError().type(), QSparqlError::ConnectionError);
+    delete r;
+
+    QTest::qWait(100);
+    QCOMPARE(conn.statistics()["connectTime"].toLongLong(), -1LL);
+    r = conn.exec(QSparqlQuery("ask {?s ?p ?o}", QSparqlQuery::AskStatement));
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), true);
+    delete r;
+}
+
+void tst_QSparqlVirtuoso::inserts_in_transaction()
+{
+    QFETCH(bool, commit);
+
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    QSparqlConnection conn("QVIRTUOSO", options);
+    QVERIFY(conn.hasFeature(QSparqlConnection::Transactions));
+    conn.addPrefix("nco", QUrl("http://www.semanticdesktop.org/ontologies/2007/03/22/nco#"));
+    conn.addPrefix("nie", QUrl("http://www.semanticdesktop.org/ontologies/2007/01/19/nie#"));
+
+    // The async inserts are still running when the transaction ends; if it
+    // isn't committed, it is rolled back at the end of the scope
+    QList<QSparqlResult*> results;
+    {
+        QSparqlTransaction transaction(&conn);
+        QVERIFY(transaction.isActive());
+        for (int i = 0; i < 5; ++i) {
+            QSparqlQuery add(QString("insert into <http://virtuoso/testgraph> "
+                                     "{ <transactionuri%1> a nco:PersonContact; "
+                                     "nie:isLogicalPartOf <qsparql-virtuoso-transaction-tests> ;"
+                                     "nco:nameGiven \"transactionname%1\" . }").arg(i),
+                             QSparqlQuery::InsertStatement);
+            QSparqlResult* r = conn.exec(add);
+            QVERIFY(r != 0);
+            QCOMPARE(r->hasError(), false);
+            results.append(r);
+        }
+        if (commit)
+            QVERIFY(transaction.commit());
+    }
+    foreach (QSparqlResult* r, results) {
+        QVERIFY(r->isFinished());
+        QCOMPARE(r->hasError(), false);
+    }
+    qDeleteAll(results);
+
+    QSparqlQuery q("select ?u from <http://virtuoso/testgraph> { "
+                   "?u a nco:PersonContact; "
+                   "nie:isLogicalPartOf <qsparql-virtuoso-transaction-tests> .}");
+    QSparqlResult* r = conn.exec(q);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), commit ? 5 : 0);
+    delete r;
+
+    QSparqlQuery del("DELETE FROM GRAPH <http://virtuoso/testgraph> "
+                     "{ ?u ?p ?o . } "
+                     "FROM <http://virtuoso/testgraph> "
+                     "WHERE { ?u nie:isLogicalPartOf <qsparql-virtuoso-transaction-tests> ; ?p ?o . }",
+                     QSparqlQuery::DeleteStatement);
+    r = conn.exec(del);
+    QVERIFY(r != 0);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+}
+
+void tst_QSparqlVirtuoso::inserts_in_transaction_data()
+{
+    QTest::addColumn<bool>("commit");
+
+    QTest::newRow("committed") << true;
+    QTest::newRow("rolledBack") << false;
+}
+
+void tst_QSparqlVirtuoso::upload_graphs_in_parallel()
+{
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    QSparqlConnection conn("QVIRTUOSO", options);
+    QVERIFY(conn.hasFeature(QSparqlConnection::GraphUpload));
+
+    // Files which don't fit in one piece of the upload
+    const int graphs = 3;
+    const int triples = 5000;
+    QList<QTemporaryFile*> files;
+    for (int g = 0; g < graphs; ++g) {
+        QTemporaryFile* file = new QTemporaryFile;
+        QVERIFY(file->open());
+        for (int i = 0; i < triples; ++i)
+            file->write(QString("<http://www.example/book/book%1> <http://www.example/Title> \"Book %1 \\u00e9\" .\n")
+                        .arg(i).toUtf8());
+        file->seek(0);
+        files.append(file);
+    }
+
+    QList<QSparqlResult*> results;
+    QList<QSignalSpy*> progressSpies;
+    for (int g = 0; g < graphs; ++g) {
+        QSparqlResult* r = conn.uploadGraph(files[g], "application/n-triples",
+                                            QUrl(QString("http://virtuoso/uploadgraph%1").arg(g)),
+                                            QSparqlConnection::ReplaceGraph);
+        QVERIFY(r != 0);
+        QCOMPARE(r->hasError(), false);
+        results.append(r);
+        progressSpies.append(new QSignalSpy(r, SIGNAL(uploadProgress(qint64, qint64))));
+    }
+    for (int g = 0; g < graphs; ++g) {
+        results[g]->waitForFinished();
+        QCOMPARE(results[g]->hasError(), false);
+        QTest::qWait(100);
+        QVERIFY(progressSpies[g]->count() > 1);
+        QCOMPARE(progressSpies[g]->last().at(0).toLongLong(), files[g]->size());
+        QCOMPARE(progressSpies[g]->last().at(1).toLongLong(), files[g]->size());
+    }
+    qDeleteAll(progressSpies);
+    qDeleteAll(results);
+    qDeleteAll(files);
+
+    for (int g = 0; g < graphs; ++g) {
+        QSparqlResult* r = conn.syncExec(QSparqlQuery(QString("select ?s from <http://virtuoso/uploadgraph%1> "
+                                                              "{ ?s <http://www.example/Title> ?t . }").arg(g)));
+        QVERIFY(r != 0);
+        QCOMPARE(r->hasError(), false);
+        QCOMPARE(r->size(), triples);
+        delete r;
+
+        r = conn.exec(QSparqlQuery(QString("clear graph <http://virtuoso/uploadgraph%1>").arg(g),
+                                   QSparqlQuery::DeleteStatement));
+        r->waitForFinished();
+        QCOMPARE(r->hasError(), false);
+        delete r;
+    }
+
+    // Virtuoso has no default graph
+    QBuffer buffer;
+    buffer.setData("<http://www.example/book/book1> <http://www.example/Title> \"Book 1\" .\n");
+    buffer.open(QIODevice::ReadOnly);
+    QSparqlResult* r = conn.uploadGraph(&buffer, "application/n-triples");
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), true);
+    delete r;
+}
+
+void tst_QSparqlVirtuoso::upload_graph_read_error()
+{
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    QSparqlConnection conn("QVIRTUOSO", options);
+    const QUrl graph("http://virtuoso/uploadgraph-error");
+
+    QBuffer buffer;
+    buffer.setData("<http://www.example/book/book0> <http://www.example/Title> \"Book\" .\n");
+    buffer.open(QIODevice::ReadOnly);
+    QSparqlResult* r = conn.uploadGraph(&buffer, "application/n-triples", graph,
+                                        QSparqlConnection::ReplaceGraph);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+
+    // The data read before the error isn't loaded, and the graph isn't cleared
+    FailingDevice failing(false);
+    failing.open(QIODevice::ReadOnly);
+    r = conn.uploadGraph(&failing, "application/n-triples", graph, QSparqlConnection::ReplaceGraph);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), true);
+    delete r;
+
+    // Sequential devices can't be waited on from the threads of the driver
+    FailingDevice sequential(true);
+    sequential.open(QIODevice::ReadOnly);
+    r = conn.uploadGraph(&sequential, "application/n-triples", graph, QSparqlConnection::ReplaceGraph);
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), true);
+    QCOMPARE(r->lastError().type(), QSparqlError::StatementError);
+    delete r;
+
+    r = conn.syncExec(QSparqlQuery(QString("select ?s from <%1> { ?s ?p ?o . }").arg(graph.toString())));
+    QVERIFY(r != 0);
+    QCOMPARE(r->hasError(), false);
+    QCOMPARE(r->size(), 1);
+    QVERIFY(r->next());
+    QCOMPARE(r->value(0).toString(), QString("http://www.example/book/book0"));
+    delete r;
+
+    r = conn.exec(QSparqlQuery(QString("clear graph <%1>").arg(graph.toString()),
+                               QSparqlQuery::DeleteStatement));
+    r->waitForFinished();
+    QCOMPARE(r->hasError(), false);
+    delete r;
+}
+
+void tst_QSparqlVirtuoso::small_query_throughput()
+{
+    QFETCH(int, maxThreads);
+
+    QSparqlConnectionOptions options;
+    options.setDatabaseName(driverPath);
+    options.setPort(portNumber);
+    if (maxThreads > 0)
+        options.setMaxThreadCount(maxThreads);
+    QSparqlConnection conn("QVIRTUOSO", options);
+    conn.addPrefix("nco", QUrl("http://www.semanticdesktop.org/ontologies/2007/03/22/nco#"));
+    conn.addPrefix("nie", QUrl("http://www.semanticdesktop.org/ontologies/2007/01/19/nie#"));
+
+    QSparqlQuery q("ask from <http://virtuoso/testgraph> { "
+                   " ?u a nco:PersonContact; "
+                   " nie:isLogicalPartOf <qsparql-virtuoso-tests> ; "
+                   "nco:nameGiven \"name001\" . }", QSparqlQuery::AskStatement);
+
+    QBENCHMARK {
+        QList<QSparqlResult*> results;
+        for (int i = 0; i < NO_SMALL_QUERIES; ++i)
+            results.append(conn.exec(q));
+        QSignalSpy lastFinished(results.last(), SIGNAL(finished()));
+        // Let the results be picked up by the pooled threads
+        for (int i = 0; i < 100 && lastFinished.count() == 0; ++i)
+            QTest::qWait(10);
+        foreach (QSparqlResult* r, results) {
+            r->waitForFinished();
+            QCOMPARE(r->hasError(), false);
+        }
+        qDeleteAll(results);
+    }
+}
+
+void tst_QSparqlVirtuoso::small_query_throughput_data()
+{
+    QTest::addColumn<int>("maxThreads");
+
+    QTest::newRow("oneThread") << 1;
+    QTest::newRow("defaultThreads") << 0;
+    QTest::newRow("eightThreads") << 8;
+}
+
+void tst_QSparqlVirtuoso::thread_creating_overhead()
+{
+    // What the driver paid on top of the queries in
+    // small_query_throughput when it started a thread per result
+    QBENCHMARK {
+        for (int i = 0; i < NO_SMALL_QUERIES; ++i) {
+            IdleThread thread;
+            thread.start();
+            thread.wait();
+            QVERIFY(thread.hasRun);
+        }
+    }
+}
+
 QTEST_MAIN( tst_QSparqlVirtuoso )
 #include "tst_qsparql_virtuoso.moc"
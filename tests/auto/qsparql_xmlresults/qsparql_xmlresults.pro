@@ -0,0 +1,14 @@
+include(../sparqltest.pri)
+CONFIG += qt warn_on console depend_includepath
+QT += testlib xml
+
+SOURCES  += tst_qsparql_xmlresults.cpp ../../../src/sparql/kernel/qsparqlxmlresultsreader.cpp
+HEADERS  += ../../../src/sparql/kernel/qsparqlxmlresultsreader_p.h
+
+check.depends = $$TARGET
+check.commands = ./tst_qsparql_xmlresults
+
+memcheck.depends = $$TARGET
+memcheck.commands = $$VALGRIND $$VALGRIND_OPT ./tst_qsparql_xmlresults
+
+QMAKE_EXTRA_TARGETS += check memcheck
@@ -0,0 +1,396 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (ivan.frade@nokia.com)
+**
+** This file is part of the QtSparql module (not yet part of the Qt Toolkit).
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation and
+** appearing in the file LICENSE.LGPL included in the packaging of this
+** file. Please review the following information to ensure the GNU Lesser
+** General Public License version 2.1 requirements will be met:
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain additional
+** rights. These rights are described in the Nokia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** Other Usage
+** Alternatively, this file may be used in accordance with the terms and
+** conditions contained in a signed written agreement between you and Nokia.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at ivan.frade@nokia.com.
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QtSparql>
+#include <QtXml/QXmlDefaultHandler>
+#include <QtXml/QXmlInputSource>
+#include <private/qsparqlxmlresultsreader_p.h>
+
+// The QXmlSimpleReader based parser the endpoint driver used before, kept
+// here as the baseline for the benchmarks
+class BaselineXmlResultsParser : public QXmlDefaultHandler
+{
+public:
+    bool startElement(const QString &, const QString &, const QString &qName,
+                      const QXmlAttributes &attributes)
+    {
+        currentText = QString();
+        if (qName == QLatin1String("result")) {
+            resultRow = QSparqlResultRow();
+        } else if (qName == QLatin1String("binding")) {
+            binding = QSparqlBinding();
+            binding.setName(attributes.value(QString::fromLatin1("name")));
+        } else if (qName == QLatin1String("literal")) {
+            lattrs = attributes;
+        }
+        return true;
+    }
+
+    bool endElement(const QString &, const QString &, const QString &qName)
+    {
+        if (qName == QLatin1String("result")) {
+            results.append(resultRow);
+        } else if (qName == QLatin1String("binding")) {
+            resultRow.append(binding);
+        } else if (qName == QLatin1String("bnode")) {
+            currentText.replace(QRegExp(QString::fromLatin1("^nodeID://")), QString::fromLatin1(""));
+            currentText.replace(QRegExp(QString::fromLatin1("^_:")), QString::fromLatin1(""));
+            binding.setBlankNodeLabel(currentText);
+        } else if (qName == QLatin1String("uri")) {
+            binding.setValue(QVariant(QUrl(currentText)));
+        } else if (qName == QLatin1String("literal")) {
+            if (lattrs.index(QString::fromLatin1("datatype")) != -1) {
+                binding.setValue(currentText, QUrl(lattrs.value(QString::fromLatin1("datatype"))));
+            } else if (lattrs.index(QString::fromLatin1("xml:lang")) != -1) {
+                binding.setValue(QVariant(currentText));
+                binding.setLanguageTag(lattrs.value(QString::fromLatin1("xml:lang")));
+            } else {
+                binding.setValue(QVariant(currentText));
+            }
+        }
+        return true;
+    }
+
+    bool characters(const QString &str)
+    {
+        currentText += str;
+        return true;
+    }
+
+    QVector<QSparqlResultRow> results;
+
+private:
+    QString currentText;
+    QXmlAttributes lattrs;
+    QSparqlBinding binding;
+    QSparqlResultRow resultRow;
+};
+
+class tst_QSparqlXmlResults : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_QSparqlXmlResults();
+    virtual ~tst_QSparqlXmlResults();
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+private slots:
+    void select_results();
+    void ask_results();
+    void split_at_every_byte();
+    void entities_and_cdata();
+    void malformed_results();
+    void incomplete_results();
+
+    void benchmark_reader();
+    void benchmark_reader_chunked();
+    void benchmark_qxmlsimplereader();
+
+private:
+    QByteArray generateResults(int rows);
+    QVector<QSparqlResultRow> readAll(const QByteArray &data, int chunkSize);
+};
+
+static const char selectResults[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<!-- a comment -->\n"
+    "<sparql xmlns=\"http://www.w3.org/2005/sparql-results#\">"
+    "<head><variable name=\"s\"/><variable name=\"o\"/><link href=\"x\"/></head>"
+    "<results distinct=\"false\" ordered=\"false\">"
+    "<result>"
+    "<binding name=\"s\"><uri>http://www.example/book/book5</uri></binding>"
+    "<binding name=\"o\"><literal xml:lang=\"fi\">kirja \xc3\xa4</literal></binding>"
+    "</result>"
+    "<result>"
+    "<binding name='s'><bnode>nodeID://b1</bnode></binding>"
+    "<binding name=\"o\"><literal datatype=\"http://www.w3.org/2001/XMLSchema#integer\">42</literal></binding>"
+    "</result>"
+    "<result>"
+    "<binding name=\"s\"><bnode>_:b2</bnode></binding>"
+    "<binding name=\"o\"><literal/></binding>"
+    "</result>"
+    "</results>"
+    "</sparql>\n";
+
+static QString rowString(const QSparqlResultRow &row)
+{
+    QStringList bindings;
+    for (int i = 0; i < row.count(); ++i)
+        bindings << row.binding(i).name() + QLatin1Char('=') + row.binding(i).toString();
+    return bindings.join(QLatin1String(" "));
+}
+
+tst_QSparqlXmlResults::tst_QSparqlXmlResults()
+{
+}
+
+tst_QSparqlXmlResults::~tst_QSparqlXmlResults()
+{
+}
+
+void tst_QSparqlXmlResults::initTestCase()
+{
+}
+
+void tst_QSparqlXmlResults::cleanupTestCase()
+{
+}
+
+void tst_QSparqlXmlResults::init()
+{
+}
+
+void tst_QSparqlXmlResults::cleanup()
+{
+}
+
+QByteArray tst_QSparqlXmlResults::generateResults(int rows)
+{
+    QByteArray data("<?xml version=\"1.0\"?>\n"
+                    "<sparql xmlns=\"http://www.w3.org/2005/sparql-results#\">\n"
+                    "<head><variable name=\"s\"/><variable name=\"label\"/>"
+                    "<variable name=\"population\"/><variable name=\"b\"/></head>\n"
+                    "<results distinct=\"false\" ordered=\"true\">\n");
+    for (int i = 0; i < rows; ++i) {
+        data += "<result>\n"
+                "  <binding name=\"s\"><uri>http://dbpedia.org/resource/Place_";
+        data += QByteArray::number(i);
+        data += "</uri></binding>\n"
+                "  <binding name=\"label\"><literal xml:lang=\"en\">Place &amp; number ";
+        data += QByteArray::number(i);
+        data += "</literal></binding>\n"
+                "  <binding name=\"population\"><literal datatype=\"http://www.w3.org/2001/XMLSchema#integer\">";
+        data += QByteArray::number(i * 7);
+        data += "</literal></binding>\n"
+                "  <binding name=\"b\"><bnode>nodeID://b";
+        data += QByteArray::number(i);
+        data += "</bnode></binding>\n"
+                "</result>\n";
+    }
+    data += "</results>\n</sparql>\n";
+    return data;
+}
+
+QVector<QSparqlResultRow> tst_QSparqlXmlResults::readAll(const QByteArray &data, int chunkSize)
+{
+    QSparqlXmlResultsReader reader;
+    QVector<QSparqlResultRow> rows;
+    for (int i = 0; i < data.size(); i += chunkSize) {
+        if (!reader.parse(data.constData() + i, qMin(chunkSize, data.size() - i)))
+            return QVector<QSparqlResultRow>();
+        rows += reader.takeRows();
+    }
+    if (!reader.isComplete())
+        return QVector<QSparqlResultRow>();
+    return rows;
+}
+
+void tst_QSparqlXmlResults::select_results()
+{
+    QSparqlXmlResultsReader reader;
+    QVERIFY(reader.parse(QByteArray(selectResults)));
+    QVERIFY(reader.isComplete());
+    QVERIFY(!reader.hasBoolean());
+
+    QVector<QSparqlResultRow> rows = reader.takeRows();
+    QCOMPARE(rows.count(), 3);
+    QCOMPARE(rows[0].count(), 2);
+    QCOMPARE(rows[0].binding(0).name(), QString("s"));
+    QCOMPARE(rows[0].binding(0).toString(), QString("<http://www.example/book/book5>"));
+    QCOMPARE(rows[0].binding(1).name(), QString("o"));
+    QCOMPARE(rows[0].value(1).toString(), QString::fromUtf8("kirja \xc3\xa4"));
+    QCOMPARE(rows[0].binding(1).languageTag(), QString("fi"));
+    QCOMPARE(rows[1].binding(0).toString(), QString("_:b1"));
+    QCOMPARE(rows[1].value(1).type(), QVariant::LongLong);
+    QCOMPARE(rows[1].value(1).toLongLong(), 42LL);
+    QCOMPARE(rows[2].binding(0).toString(), QString("_:b2"));
+    QCOMPARE(rows[2].value(1).toString(), QString());
+
+    // The rows are only returned once
+    QCOMPARE(reader.takeRows().count(), 0);
+}
+
+void tst_QSparqlXmlResults::ask_results()
+{
+    QSparqlXmlResultsReader reader;
+    QVERIFY(reader.parse(QByteArray("<?xml version=\"1.0\"?>"
+                                    "<sparql xmlns=\"http://www.w3.org/2005/sparql-results#\">"
+                                    "<head></head><boolean> true </boolean></sparql>")));
+    QVERIFY(reader.isComplete());
+    QVERIFY(reader.hasBoolean());
+    QCOMPARE(reader.boolValue(), true);
+    QVector<QSparqlResultRow> rows = reader.takeRows();
+    QCOMPARE(rows.count(), 1);
+    QCOMPARE(rows[0].value(0).toBool(), true);
+}
+
+void tst_QSparqlXmlResults::split_at_every_byte()
+{
+    // Feeding the document in any two pieces, or byte by byte, gives the
+    // same rows as reading it at once
+    const QByteArray data(selectResults);
+    const QVector<QSparqlResultRow> expected = readAll(data, data.size());
+    QCOMPARE(expected.count(), 3);
+
+    for (int split = 1; split < data.size(); ++split) {
+        QSparqlXmlResultsReader reader;
+        QVERIFY(reader.parse(data.constData(), split));
+        QVector<QSparqlResultRow> rows = reader.takeRows();
+        QVERIFY(reader.parse(data.constData() + split, data.size() - split));
+        rows += reader.takeRows();
+        QVERIFY(reader.isComplete());
+        QCOMPARE(rows.count(), expected.count());
+        for (int i = 0; i < rows.count(); ++i)
+            QCOMPARE(rowString(rows[i]), rowString(expected[i]));
+    }
+
+    const QVector<QSparqlResultRow> rows = readAll(data, 1);
+    QCOMPARE(rows.count(), expected.count());
+    for (int i = 0; i < rows.count(); ++i)
+        QCOMPARE(rowString(rows[i]), rowString(expected[i]));
+}
+
+void tst_QSparqlXmlResults::entities_and_cdata()
+{
+    QSparqlXmlResultsReader reader;
+    QVERIFY(reader.parse(QByteArray(
+        "<sparql><results><result>"
+        "<binding name=\"a&amp;b\"><literal>&lt;&gt;&amp;&quot;&apos;&#65;&#x42;&#xe4;</literal></binding>"
+        "<binding name=\"c\"><literal><![CDATA[<x> & y]]></literal></binding>"
+        "<binding name=\"d\"><uri>http://www.example/?a=1&amp;b=2</uri></binding>"
+        "</result></results></sparql>")));
+    QVERIFY(reader.isComplete());
+    QVector<QSparqlResultRow> rows = reader.takeRows();
+    QCOMPARE(rows.count(), 1);
+    QCOMPARE(rows[0].binding(0).name(), QString("a&b"));
+    QCOMPARE(rows[0].value(0).toString(), QString::fromUtf8("<>&\"'AB\xc3\xa4"));
+    QCOMPARE(rows[0].value(1).toString(), QString("<x> & y"));
+    QCOMPARE(rows[0].value(2).toUrl(), QUrl("http://www.example/?a=1&b=2"));
+}
+
+void tst_QSparqlXmlResults::malformed_results()
+{
+    QSparqlXmlResultsReader reader;
+    QVERIFY(!reader.parse(QByteArray("4:syntax error, unknown bad command")));
+    QVERIFY(!reader.errorString().isEmpty());
+
+    QSparqlXmlResultsReader reader2;
+    QVERIFY(!reader2.parse(QByteArray("<sparql><results><result><binding name=\"a\">"
+                                      "<literal>&unknown;</literal>")));
+
+    QSparqlXmlResultsReader reader3;
+    QVERIFY(!reader3.parse(QByteArray("<sparql></sparql></sparql>")));
+
+    // The end tags must close the open elements in order
+    QSparqlXmlResultsReader reader4;
+    QVERIFY(!reader4.parse(QByteArray("<sparql><results><result><binding name=\"a\">"
+                                      "<uri>http://www.example/a</literal></binding>")));
+    QCOMPARE(reader4.errorString(), QString("Mismatched end tag"));
+    QCOMPARE(reader4.takeRows().count(), 0);
+
+    QSparqlXmlResultsReader reader5;
+    QVERIFY(!reader5.parse(QByteArray("<sparql><results></sparql></results>")));
+    QVERIFY(!reader5.isComplete());
+
+    QSparqlXmlResultsReader reader6;
+    QVERIFY(!reader6.parse(QByteArray("<res:sparql><res:results/></sparql>")));
+
+    // Namespace prefixes and self closing elements
+    QSparqlXmlResultsReader reader7;
+    QVERIFY(reader7.parse(QByteArray("<res:sparql xmlns:res=\"http://www.w3.org/2005/sparql-results#\">"
+                                     "<res:head><res:variable name=\"a\"/></res:head>"
+                                     "<res:results/></res:sparql >")));
+    QVERIFY(reader7.isComplete());
+}
+
+void tst_QSparqlXmlResults::incomplete_results()
+{
+    QSparqlXmlResultsReader reader;
+    QVERIFY(reader.parse(QByteArray("<?xml version=\"1.0\"?><sparql><results><result>"
+                                    "<binding name=\"a\"><uri>http://www.example/a</uri></binding>"
+                                    "</result><result><binding name=\"a\"><uri>http://www.ex")));
+    QVERIFY(!reader.isComplete());
+    // The finished row is available already
+    QCOMPARE(reader.takeRows().count(), 1);
+}
+
+void tst_QSparqlXmlResults::benchmark_reader()
+{
+    const QByteArray data = generateResults(10000);
+    QBENCHMARK {
+        QSparqlXmlResultsReader reader;
+        reader.parse(data);
+        QCOMPARE(reader.takeRows().count(), 10000);
+    }
+}
+
+void tst_QSparqlXmlResults::benchmark_reader_chunked()
+{
+    // The way the endpoint driver uses it, with network sized chunks
+    const QByteArray data = generateResults(10000);
+    QBENCHMARK {
+        QCOMPARE(readAll(data, 16384).count(), 10000);
+    }
+}
+
+void tst_QSparqlXmlResults::benchmark_qxmlsimplereader()
+{
+    const QByteArray data = generateResults(10000);
+    QBENCHMARK {
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        QXmlInputSource source(&buffer);
+        BaselineXmlResultsParser parser;
+        QXmlSimpleReader reader;
+        reader.setContentHandler(&parser);
+        QVERIFY(reader.parse(&source));
+        QCOMPARE(parser.results.count(), 10000);
+    }
+}
+
+QTEST_MAIN(tst_QSparqlXmlResults)
+#include "tst_qsparql_xmlresults.moc"
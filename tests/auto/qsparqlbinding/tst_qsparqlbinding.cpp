@@ -69,6 +69,8 @@ private slots:
     void equality_operator();
     void assignment_operator();
     void clear();
+    void copies_are_independent();
+    void repeated_data_types_and_language_tags();
 
 private:
     void add_toString_data_rows(const char* dataTag,
@@ -518,5 +520,69 @@ void tst_QSparqlBinding::clear()
     QCOMPARE(b4.value(), QVariant());
 }
 
+void tst_QSparqlBinding::copies_are_independent()
+{
+    QSparqlBinding b1("name");
+    b1.setValue("text", QUrl("http://example.com/myType"));
+    QSparqlBinding b2(b1);
+    QSparqlBinding b3 = b1;
+
+    b2.setLanguageTag("fi");
+    b3.clear();
+    QCOMPARE(b1.dataTypeUri(), QUrl("http://example.com/myType"));
+    QCOMPARE(b1.languageTag(), QString());
+    QCOMPARE(b1.isLiteral(), true);
+    QCOMPARE(b2.languageTag(), QString("fi"));
+    QCOMPARE(b2.dataTypeUri(), QUrl("http://example.com/myType"));
+    QCOMPARE(b3.isLiteral(), false);
+    QCOMPARE(b3.name(), QString("name"));
+
+    b2.setName("other");
+    QCOMPARE(b1.name(), QString("name"));
+    QCOMPARE(b2.name(), QString("other"));
+    QCOMPARE(b2.languageTag(), QString("fi"));
+
+    // The bindings made separately with the same data type and language
+    // tag are equal, whatever their names
+    QSparqlBinding b4("another");
+    b4.setValue("text", QUrl("http://example.com/myType"));
+    b4.setLanguageTag("fi");
+    QCOMPARE(b4 == b2, true);
+    b4.setLanguageTag(QString());
+    QCOMPARE(b4 == b1, true);
+    b4.setDataTypeUri(QUrl("http://www.w3.org/2001/XMLSchema#string"));
+    QCOMPARE(b4 == b1, false);
+    QCOMPARE(b4.dataTypeUri(), QUrl("http://www.w3.org/2001/XMLSchema#string"));
+    QCOMPARE(b4.toString(), QString("\"text\"^^<http://www.w3.org/2001/XMLSchema#string>"));
+}
+
+void tst_QSparqlBinding::repeated_data_types_and_language_tags()
+{
+    // More data types and tags than the transitions remembered by a thread,
+    // set on the cells of two columns in turn
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 20; ++i) {
+            const QUrl type(QString("http://example.com/type%1").arg(i));
+            const QString tag = QString("x-tag%1").arg(i);
+            QSparqlBinding b1("first");
+            QSparqlBinding b2("second");
+            b1.setValue("text", type);
+            b2.setValue("text", type);
+            QCOMPARE(b1.dataTypeUri(), type);
+            QCOMPARE(b1 == b2, true);
+            b1.setLanguageTag(tag);
+            QCOMPARE(b1.languageTag(), tag);
+            QCOMPARE(b1 == b2, false);
+            b2.setLanguageTag(tag);
+            QCOMPARE(b1 == b2, true);
+            b1.setDataTypeUri(QUrl("http://www.w3.org/2001/XMLSchema#int"));
+            QCOMPARE(b1.dataTypeUri(), QUrl("http://www.w3.org/2001/XMLSchema#int"));
+            QCOMPARE(b1.languageTag(), tag);
+            b1.setLanguageTag(QString());
+            QCOMPARE(b1.languageTag(), QString());
+        }
+    }
+}
+
 QTEST_MAIN( tst_QSparqlBinding )
 #include "tst_qsparqlbinding.moc"
@@ -39,6 +39,7 @@
 
 #include <QtTest/QtTest>
 #include <QtSparql>
+#include <private/qsparqlquery_p.h>
 
 #include <QUrl>
 
@@ -63,9 +64,21 @@ private slots:
     void unbind_and_replace();
     void different_datatypes_data();
     void different_datatypes();
+    void parametrized_query_text();
     void copy();
 };
 
+namespace {
+
+QString stringMarker(const QSparqlBinding& value)
+{
+    if (value.value().type() == QVariant::String)
+        return QLatin1String("??");
+    return QString();
+}
+
+} // end unnamed namespace
+
 tst_QSparqlQuery::tst_QSparqlQuery()
 {
 }
@@ -247,6 +260,35 @@ void tst_QSparqlQuery::different_datatypes()
     QCOMPARE(q.preparedQueryText(), replacedString);
 }
 
+void tst_QSparqlQuery::parametrized_query_text()
+{
+    QSparqlQuery q("insert { ?:subject nco:fullname ?:name ; "
+                   "nco:nickname ?:name ; nco:age ?:age ; "
+                   "nco:note '?:name' ; nco:other ?:unbound . }");
+    q.bindValue("subject", QUrl("http://www.example.com/contact"));
+    q.bindValue("name", "NAME");
+    q.bindValue("age", 40);
+
+    QList<QSparqlBinding> parameters;
+    QString text = QSparqlParametrizedQuery::queryText(q, stringMarker, &parameters);
+
+    // Values without a marker are inserted, and unbound placeholders and
+    // quoted ones are left as they are
+    QCOMPARE(text, QString("insert { <http://www.example.com/contact> nco:fullname ?? ; "
+                           "nco:nickname ?? ; nco:age 40 ; "
+                           "nco:note '?:name' ; nco:other ?:unbound . }"));
+    QCOMPARE(parameters.count(), 2);
+    QCOMPARE(parameters[0].value(), QVariant("NAME"));
+    QCOMPARE(parameters[1].value(), QVariant("NAME"));
+
+    // The inserted values are the same as in preparedQueryText()
+    q.unbindValues();
+    q.bindValue("age", 40);
+    text = QSparqlParametrizedQuery::queryText(q, stringMarker, &parameters);
+    QCOMPARE(text, q.preparedQueryText());
+    QVERIFY(parameters.isEmpty());
+}
+
 void tst_QSparqlQuery::copy()
 {
     const QString query1("insert { _:c a nco:Contact ; "
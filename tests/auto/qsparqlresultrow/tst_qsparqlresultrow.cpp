@@ -72,6 +72,8 @@ private slots:
     void variableName();
     void binding();
     void value();
+    void schema();
+    void rows_sharing_schema();
 
 private:
 };
@@ -274,5 +276,82 @@ void tst_QSparqlResultRow::value()
     QCOMPARE(r1.value("testBinding2"), v2);
 }
 
+void tst_QSparqlResultRow::schema()
+{
+    QSparqlResultRow r1;
+    QCOMPARE(r1.schema().isEmpty(), true);
+    QCOMPARE(r1.schema().indexOf("testBinding1"), -1);
+
+    QSparqlBinding b1("testBinding1", QVariant(-67));
+    QSparqlBinding b2("testBinding2", QString("string_literal"));
+    QSparqlBinding b3("testBinding1", QString("duplicate"));
+    r1.append(b1);
+    r1.append(b2);
+    r1.append(b3);
+
+    QSparqlResultRowSchema schema = r1.schema();
+    QCOMPARE(schema.count(), 3);
+    QCOMPARE(schema.indexOf("testBinding1"), 0);
+    QCOMPARE(schema.indexOf("testBinding2"), 1);
+    QCOMPARE(schema.indexOf("foo"), -1);
+    QCOMPARE(schema.variableName(1), QLatin1String("testBinding2"));
+    QCOMPARE(schema.variableName(3), QString());
+
+    // The schema doesn't change with the row it was taken from
+    r1.clear();
+    r1.append(b2);
+    QCOMPARE(schema.count(), 3);
+    QCOMPARE(schema.indexOf("testBinding1"), 0);
+    QCOMPARE(r1.schema().count(), 1);
+    QCOMPARE(r1.indexOf("testBinding1"), -1);
+    QCOMPARE(r1.indexOf("testBinding2"), 0);
+}
+
+void tst_QSparqlResultRow::rows_sharing_schema()
+{
+    QSparqlBinding b1("testBinding1", QVariant(-67));
+    QSparqlBinding b2("testBinding2", QString("string_literal"));
+    QSparqlBinding b3("testBinding3", QString("string_literal"));
+    QSparqlResultRow r1;
+    r1.append(b1);
+    r1.append(b2);
+    const QSparqlResultRowSchema schema = r1.schema();
+
+    QSparqlResultRow r2(schema);
+    QCOMPARE(r2.isEmpty(), true);
+    QCOMPARE(r2.indexOf("testBinding1"), -1);
+    r2.append(QSparqlBinding("testBinding1", QVariant(1)));
+    QCOMPARE(r2.indexOf("testBinding1"), 0);
+    QCOMPARE(r2.indexOf("testBinding2"), -1);
+    r2.append(QSparqlBinding("testBinding2", QVariant(2)));
+    QCOMPARE(r2.value("testBinding2"), QVariant(2));
+    QCOMPARE(r2.schema().count(), 2);
+
+    // A row with other bindings gets a schema of its own
+    QSparqlResultRow r3(schema);
+    r3.append(b1);
+    r3.append(b3);
+    QCOMPARE(r3.indexOf("testBinding2"), -1);
+    QCOMPARE(r3.indexOf("testBinding3"), 1);
+    QCOMPARE(r3.binding("testBinding3"), b3);
+    QCOMPARE(schema.indexOf("testBinding3"), -1);
+    QCOMPARE(r2.indexOf("testBinding3"), -1);
+
+    // A row using only the first columns of the schema
+    QSparqlResultRow r4(schema);
+    r4.append(b1);
+    QCOMPARE(r4.schema().count(), 1);
+    QCOMPARE(r4 == r2, false);
+    QCOMPARE(r4.variableName(0), QLatin1String("testBinding1"));
+
+    // Copies of a row keep their bindings when the row changes
+    QSparqlResultRow r5 = r2;
+    r2.clear();
+    r2.append(b3);
+    QCOMPARE(r5.indexOf("testBinding2"), 1);
+    QCOMPARE(r5.indexOf("testBinding3"), -1);
+    QCOMPARE(r2.indexOf("testBinding3"), 0);
+}
+
 QTEST_MAIN( tst_QSparqlResultRow )
 #include "tst_qsparqlresultrow.moc"